@@ -156,6 +156,10 @@ Eigen::MatrixXf gray2mat(const Eigen::MatrixXi &input) {
     return output;
 }
 
+Eigen::MatrixXf gray2mat(const GrayImageView &input) {
+    return input.cast<float>() / 255.0f;
+}
+
 Eigen::MatrixXi mat2gray(const Eigen::MatrixXf &input) {
     // Detect maximum
     float maximum = 0;
@@ -189,10 +193,10 @@ float interpolate(const Eigen::MatrixXf &source, const Point<float>::type &p) {
     float y_fract = std::modf(p.y(), &y_int);
 
     // Bilinear interpolation
-    return source(y_int,     x_int)     * (1 - x_fract) * (1 - y_fract) +
-           source(y_int,     x_int + 1) * x_fract       * (1 - y_fract) +
-           source(y_int + 1, x_int)     * (1 - x_fract) * y_fract +
-           source(y_int + 1, x_int + 1) * x_fract       * y_fract;
+    return source((int)y_int,     (int)x_int)     * (1 - x_fract) * (1 - y_fract) +
+           source((int)y_int,     (int)x_int + 1) * x_fract       * (1 - y_fract) +
+           source((int)y_int + 1, (int)x_int)     * (1 - x_fract) * y_fract +
+           source((int)y_int + 1, (int)x_int + 1) * x_fract       * y_fract;
 }
 
 Eigen::MatrixXf resize(const Eigen::MatrixXf &input, const size_t rows,
@@ -247,26 +251,118 @@ Eigen::MatrixXf rotate(const Eigen::MatrixXf &input,
     return output;
 }
 
-Eigen::MatrixXf pad(const Eigen::MatrixXf &image) {
+InterleavedImage
+interleave(const std::vector<const Eigen::MatrixXf *> &inputs) {
+    assert(!inputs.empty() && inputs.size() <= 4);
+    InterleavedImage output;
+    output.rows = inputs[0]->rows();
+    output.cols = inputs[0]->cols();
+    output.channels = inputs.size();
+
+    // Unused channels are left zero, for every pixel to be a full vector
+    output.pixels =
+        Eigen::Matrix<float, 4, Eigen::Dynamic>::Zero(4, inputs[0]->size());
+    for (size_t i = 0; i < inputs.size(); i++) {
+        assert(inputs[i]->rows() == output.rows &&
+               inputs[i]->cols() == output.cols);
+        output.pixels.row(i) = Eigen::Map<const Eigen::RowVectorXf>(
+            inputs[i]->data(), inputs[i]->size());
+    }
+    return output;
+}
+
+std::vector<Eigen::MatrixXf> rotate(const InterleavedImage &input,
+                                    const Point<float>::type &origin,
+                                    const float angle) {
+    const int rows = input.rows, cols = input.cols;
+
+    // Calculate transform matrix
+    Eigen::Matrix2f transform;
+    transform << std::cos(-angle), -std::sin(-angle), std::sin(-angle),
+        std::cos(-angle);
+
+    // Allocate output matrices
+    std::vector<Eigen::MatrixXf> outputs(input.channels);
+    for (int i = 0; i < input.channels; i++)
+        outputs[i] = Eigen::MatrixXf::Zero(rows, cols);
+
+    // Process all points
+    // NOTE: the interpolation is evaluated in the same order as in
+    //       interpolate(), for every channel to be rotated exactly as it
+    //       would be on its own
+    const Eigen::Matrix<float, 4, Eigen::Dynamic> &pixels = input.pixels;
+    for (int col = 0; col < cols; col++) {
+        for (int row = 0; row < rows; row++) {
+            Point<float>::type p(col, row);
+            p -= origin;
+            p *= transform;
+            p += origin;
+            if (!(p.x() >= 0 && p.x() < cols - 1 && p.y() >= 0 &&
+                  p.y() < rows - 1))
+                continue;
+
+            // NOTE: the coordinates are positive, so truncating them yields
+            //       the same parts as modf() does, without a library call
+            int x = (int)p.x(), y = (int)p.y();
+            float x_fract = p.x() - x;
+            float y_fract = p.y() - y;
+            int index = x * rows + y;
+            Eigen::Vector4f value =
+                pixels.col(index) * (1 - x_fract) * (1 - y_fract) +
+                pixels.col(index + rows) * x_fract * (1 - y_fract) +
+                pixels.col(index + 1) * (1 - x_fract) * y_fract +
+                pixels.col(index + rows + 1) * x_fract * y_fract;
+            for (int i = 0; i < input.channels; i++)
+                outputs[i](row, col) = value[i];
+        }
+    }
+    return outputs;
+}
+
+int padded_size(int rows, int cols) {
+    Point<float>::type origin(std::floor((cols + 1) / 2.0) - 1,
+                              std::floor((rows + 1) / 2.0) - 1);
+    int rLast = (int)std::ceil(std::hypot(cols - 1 - origin.x() - 1,
+                                          rows - 1 - origin.y() - 1)) +
+                1;
+    int rFirst = -rLast;
+    return rLast - rFirst + 1;
+}
+
+template <typename Image>
+static Eigen::MatrixXf pad_image(const Image &image, float divisor) {
     // Pad the images so we can freely rotate without losing information
     Point<float>::type origin(std::floor((image.cols() + 1) / 2.0) - 1,
                               std::floor((image.rows() + 1) / 2.0) - 1);
-    int rLast = (int)std::ceil(std::hypot(image.cols() - 1 - origin.x() - 1,
-                                          image.rows() - 1 - origin.y() - 1)) +
-                1;
-    int rFirst = -rLast;
-    int nBins = (rLast - rFirst + 1);
+    int nBins = padded_size(image.rows(), image.cols());
     Eigen::MatrixXf image_padded = Eigen::MatrixXf::Zero(nBins, nBins);
     Point<float>::type origin_padded(
         std::floor((image_padded.cols() + 1) / 2.0) - 1,
         std::floor((image_padded.rows() + 1) / 2.0) - 1);
     Point<float>::type df = origin_padded - origin;
-    image_padded.block((int)df.y(), (int)df.x(), image.rows(), image.cols()) =
-        image;
+    if (divisor == 1)
+        image_padded.block((int)df.y(), (int)df.x(), image.rows(),
+                           image.cols()) = image.template cast<float>();
+    else
+        image_padded.block((int)df.y(), (int)df.x(), image.rows(),
+                           image.cols()) =
+            image.template cast<float>() / divisor;
 
     return image_padded;
 }
 
+Eigen::MatrixXf pad(const Eigen::MatrixXf &image) {
+    return pad_image(image, 1);
+}
+
+Eigen::MatrixXf pad(const FloatImageView &image) {
+    return pad_image(image, 1);
+}
+
+Eigen::MatrixXf pad(const GrayImageView &image) {
+    return pad_image(image, 255);
+}
+
 float arithmetic_mean(const Eigen::VectorXf &input) {
     if (input.size() == 0)
         return NAN;
@@ -309,3 +405,12 @@ Eigen::VectorXf zscore(const Eigen::VectorXf &input) {
 
     return transformed;
 }
+
+float relative_error(const Eigen::VectorXf &approximation,
+                     const Eigen::VectorXf &exact) {
+    assert(approximation.size() == exact.size());
+    float scale = exact.cwiseAbs().maxCoeff();
+    if (!(scale > 0))
+        return 0;
+    return (approximation - exact).cwiseAbs().maxCoeff() / scale;
+}
@@ -9,7 +9,7 @@
 // Standard library
 #include <stddef.h> // for size_t
 #include <string>   // for string
-#include <vector>
+#include <vector>   // for vector
 
 // Eigen
 #include <Eigen/Dense> // for MatrixXf, MatrixXi, etc
@@ -18,6 +18,28 @@
 #include "global.hpp"
 
 
+//
+// Structs
+//
+
+// Images in memory owned by someone else (e.g. a decoder), stored row by row
+// with an arbitrary distance (in elements) between the starts of the rows
+typedef Eigen::Map<const Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic,
+                                       Eigen::RowMajor>,
+                   0, Eigen::OuterStride<>> FloatImageView;
+typedef Eigen::Map<const Eigen::Matrix<unsigned char, Eigen::Dynamic,
+                                       Eigen::Dynamic, Eigen::RowMajor>,
+                   0, Eigen::OuterStride<>> GrayImageView;
+
+// Up to four images of the same size (e.g. the channels of a colour image)
+// stored together, as a column of four values per pixel, with the pixels in
+// column-major order; a single load then fetches a pixel of every channel
+struct InterleavedImage {
+    int rows, cols, channels;
+    Eigen::Matrix<float, 4, Eigen::Dynamic> pixels;
+};
+
+
 //
 // Routines
 //
@@ -33,6 +55,7 @@ void writecsv(std::string filename, const Eigen::MatrixXf &data);
 
 // Convert a grayscale image (range [0, 255]) to a matrix (range [0, 1]).
 Eigen::MatrixXf gray2mat(const Eigen::MatrixXi &input);
+Eigen::MatrixXf gray2mat(const GrayImageView &input);
 
 // Convert a matrix (arbitrary values) to a grayscale image (range [0, 255]).
 // This
@@ -49,14 +72,36 @@ Eigen::MatrixXf resize(const Eigen::MatrixXf &input, const size_t rows,
 Eigen::MatrixXf rotate(const Eigen::MatrixXf &input,
                        const Point<float>::type &origin, const float angle);
 
+// Interleave up to four images of the same size
+InterleavedImage interleave(const std::vector<const Eigen::MatrixXf *> &inputs);
+
+// Rotate all channels of an interleaved image at once, calculating the sample
+// coordinates and weights only once, into a separate image per channel
+std::vector<Eigen::MatrixXf> rotate(const InterleavedImage &input,
+                                    const Point<float>::type &origin,
+                                    const float angle);
+
+// Size of the square an image gets padded to, so it can be rotated freely
+int padded_size(int rows, int cols);
+
 Eigen::MatrixXf pad(const Eigen::MatrixXf &image);
 
+// Pad an image straight out of external memory, without copying it first
+// (converting grayscale values like gray2mat does)
+Eigen::MatrixXf pad(const FloatImageView &image);
+Eigen::MatrixXf pad(const GrayImageView &image);
+
 float arithmetic_mean(const Eigen::VectorXf &input);
 
 float standard_deviation(const Eigen::VectorXf &input);
 
 Eigen::VectorXf zscore(const Eigen::VectorXf &input);
 
+// Largest deviation of an approximation, relative to the largest magnitude of
+// the exact values.
+float relative_error(const Eigen::VectorXf &approximation,
+                     const Eigen::VectorXf &exact);
+
 template <typename T> int sgn(T val) { return (T(0) < val) - (val < T(0)); }
 
 #endif
@@ -0,0 +1,292 @@
+//
+// Configuration
+//
+
+// Header include
+#include "batch.hpp"
+
+// Standard library
+#include <cassert> // for assert
+#include <cmath>   // for floor, cos, sin
+#include <sstream> // for stringstream
+
+// Local
+#include "global.hpp"
+#include "logger.hpp"
+#include "auxiliary.hpp"
+#include "pipeline.hpp"
+#include "profiler.hpp"
+
+
+//
+// Auxiliary
+//
+
+namespace {
+
+typedef Eigen::Array<float, batch_lanes, 1> Lane;
+typedef Eigen::Array<int, batch_lanes, 1> LaneIndex;
+
+// Rotate every image of a batch, calculating the sample coordinates and
+// weights once for all of them
+// NOTE: the interpolation is evaluated in the same order as in interpolate(),
+//       for every image to be rotated exactly as it would be on its own
+void rotateBatch(const BatchImage &input, int size,
+                 const Point<float>::type &origin, const float angle,
+                 BatchImage &output) {
+    Eigen::Matrix2f transform;
+    transform << std::cos(-angle), -std::sin(-angle), std::sin(-angle),
+        std::cos(-angle);
+
+    output.setZero(batch_lanes, size * size);
+    for (int col = 0; col < size; col++) {
+        for (int row = 0; row < size; row++) {
+            Point<float>::type p(col, row);
+            p -= origin;
+            p *= transform;
+            p += origin;
+            if (!(p.x() >= 0 && p.x() < size - 1 && p.y() >= 0 &&
+                  p.y() < size - 1))
+                continue;
+
+            // NOTE: the coordinates are positive, so truncation yields the
+            //       same integral and fractional parts as modf()
+            int x = (int)p.x(), y = (int)p.y();
+            float x_fract = p.x() - x;
+            float y_fract = p.y() - y;
+            int index = x * size + y;
+            output.col(col * size + row) =
+                input.col(index) * (1 - x_fract) * (1 - y_fract) +
+                input.col(index + size) * x_fract * (1 - y_fract) +
+                input.col(index + 1) * (1 - x_fract) * y_fract +
+                input.col(index + size + 1) * x_fract * y_fract;
+        }
+    }
+}
+
+}
+
+
+//
+// Module definitions
+//
+
+BatchTransformer::BatchTransformer(const std::vector<Eigen::MatrixXf> &images,
+                                   const std::vector<std::string> &basenames,
+                                   unsigned int angle_stepsize)
+    : _basenames(basenames), _angle_stepsize(angle_stepsize) {
+    assert(!images.empty() && images.size() <= (size_t)batch_lanes);
+    assert(images.size() == basenames.size());
+    _size = padded_size(images[0].rows(), images[0].cols());
+
+    // Pad the images, and interleave them
+    // NOTE: the lanes of missing images stay zero
+    PhaseTimer timer(profiler.phase("pad"), images.size() * _size * _size);
+    _images = BatchImage::Zero(batch_lanes, _size * _size);
+    for (size_t i = 0; i < images.size(); i++) {
+        assert(images[i].rows() == images[0].rows() &&
+               images[i].cols() == images[0].cols());
+        Eigen::MatrixXf padded = pad(images[i]);
+        _images.row(i) =
+            Eigen::Map<const Eigen::RowVectorXf>(padded.data(), padded.size());
+    }
+    clog(debug) << "Padded a batch of " << images.size() << " images to "
+                << _size << "x" << _size << std::endl;
+}
+
+bool BatchTransformer::supports(
+    size_t rows, size_t cols, bool orthonormal,
+    const std::vector<TFunctionalWrapper> &tfunctionals,
+    const std::vector<PFunctionalWrapper> &pfunctionals) {
+    if (orthonormal || padded_size(rows, cols) > batch_max_size)
+        return false;
+    for (size_t t = 0; t < tfunctionals.size(); t++) {
+        TFunctional tfunctional = tfunctionals[t].functional;
+        if (tfunctional != TFunctional::Radon &&
+            tfunctional != TFunctional::T1 && tfunctional != TFunctional::T2)
+            return false;
+    }
+    for (size_t p = 0; p < pfunctionals.size(); p++) {
+        if (pfunctionals[p].functional != PFunctional::P1)
+            return false;
+    }
+    return true;
+}
+
+std::vector<Eigen::MatrixXf> BatchTransformer::getTransform(
+    const std::vector<TFunctionalWrapper> &tfunctionals,
+    const std::vector<PFunctionalWrapper> &pfunctionals,
+    bool write_data) const {
+    const int n = _size;
+    const int a_steps = (int)std::floor(360 / _angle_stepsize);
+    const size_t count = _basenames.size();
+    Point<float>::type origin((n - 1) / 2.0, (n - 1) / 2.0);
+
+    // Sinograms of every T-functional, as a column of lanes per element
+    std::vector<BatchImage> sinograms(tfunctionals.size(),
+                                      BatchImage(batch_lanes, n * a_steps));
+    bool median = false;
+    std::vector<TFunctional> functionals;
+    for (size_t t = 0; t < tfunctionals.size(); t++) {
+        median |= (tfunctionals[t].functional != TFunctional::Radon);
+        functionals.push_back(tfunctionals[t].functional);
+    }
+
+    // The weighted median of a column is sensitive to how its total gets
+    // rounded, so for the medians every column is also summed exactly like
+    // the single-image code would: contiguously, and with the same alignment
+    // as within a rotated image if there's a pipeline for the functionals (a
+    // copy otherwise)
+    const int alignment = EIGEN_DEFAULT_ALIGN_BYTES / sizeof(float);
+    const int stride = (n / alignment + 2) * alignment;
+    const bool pipelined = (findTPipeline(functionals) != NULL);
+
+    int phase_angles = profiler.phase("angles");
+    int phase_rotate = profiler.phase("rotate");
+    std::string stage_names;
+    for (size_t t = 0; t < tfunctionals.size(); t++)
+        stage_names += (t ? "+" : "") + tfunctionals[t].name;
+    int phase_columns =
+        profiler.phase(stage_names.empty() ? "columns" : stage_names);
+
+    // Process all angles
+    #pragma omp parallel
+    {
+        TraceSpan chunk(phase_angles);
+        BatchImage rotated;
+        Eigen::VectorXf columns(median ? batch_lanes * stride : 0);
+        #pragma omp for schedule(static) nowait
+        for (int a_step = 0; a_step < a_steps; a_step++) {
+            {
+                PhaseTimer timer(phase_rotate, count * n * n);
+                rotateBatch(_images, n, origin,
+                            deg2rad(a_step * _angle_stepsize), rotated);
+            }
+
+            // Process all projection bands of every image at once
+            PhaseTimer timer(phase_columns, count * n * n);
+            for (int column = 0; column < n; column++) {
+                const int first = column * n;
+
+                // Sum the rows in order, a lane per image
+                // NOTE: this rounds differently from the vectorized sum of a
+                //       single column
+                Lane sum = Lane::Zero();
+                for (int r = 0; r < n; r++)
+                    sum += rotated.col(first + r).array();
+
+                // Transform the domain from t to r
+                // NOTE: the data isn't negative, so the cumulative sum only
+                //       grows and the median is the amount of rows before
+                //       it reaches half of the total
+                Lane t1 = Lane::Zero(), t2 = Lane::Zero();
+                if (median) {
+                    const int offset = pipelined ? first % alignment : 0;
+                    for (int r = 0; r < n; r++) {
+                        float *column_data = columns.data() + offset + r;
+                        for (size_t i = 0; i < count; i++)
+                            column_data[i * stride] = rotated(i, first + r);
+                    }
+                    Lane total = Lane::Zero();
+                    for (size_t i = 0; i < count; i++)
+                        total[i] = Eigen::Map<const Eigen::VectorXf>(
+                                       columns.data() + i * stride + offset, n)
+                                       .sum();
+
+                    LaneIndex medians = LaneIndex::Zero();
+                    Lane integral = Lane::Zero();
+                    for (int r = 0; r < n; r++) {
+                        integral += rotated.col(first + r).array();
+                        medians += (2 * integral < total).cast<int>();
+                    }
+                    medians = medians.min(n - 1);
+
+                    // Integrate, with zero weight before the median
+                    for (int r = 0; r < n; r++) {
+                        Lane weight = (r - medians).max(0).cast<float>();
+                        Lane data = rotated.col(first + r).array();
+                        t1 += data * weight;
+                        t2 += (data * weight) * weight;
+                    }
+                }
+
+                for (size_t t = 0; t < tfunctionals.size(); t++) {
+                    Lane result;
+                    switch (tfunctionals[t].functional) {
+                    case TFunctional::T1:
+                        result = t1;
+                        break;
+                    case TFunctional::T2:
+                        result = t2;
+                        break;
+                    case TFunctional::Radon:
+                    default:
+                        result = sum;
+                        break;
+                    }
+                    sinograms[t].col(a_step * n + column) = result.matrix();
+                }
+            }
+        }
+    }
+
+    // Calculate the circus functions of every image at once
+    std::vector<BatchImage> circusfunctions(tfunctionals.size());
+    if (!pfunctionals.empty()) {
+        PhaseTimer timer(profiler.phase("P1"),
+                         count * n * a_steps * tfunctionals.size());
+        for (size_t t = 0; t < tfunctionals.size(); t++) {
+            circusfunctions[t].resize(batch_lanes, a_steps);
+            for (int a_step = 0; a_step < a_steps; a_step++) {
+                const int first = a_step * n;
+                Lane sum = Lane::Zero();
+                for (int p = 1; p < n; p++)
+                    sum += (sinograms[t].col(first + p).array() -
+                            sinograms[t].col(first + p - 1).array())
+                               .abs();
+                circusfunctions[t].col(a_step) = sum.matrix();
+            }
+        }
+    }
+
+    // Normalize, and lay out the signatures of every image
+    std::vector<Eigen::MatrixXf> signatures(
+        count,
+        Eigen::MatrixXf(a_steps, tfunctionals.size() * pfunctionals.size()));
+    for (size_t i = 0; i < count; i++) {
+        for (size_t t = 0; t < tfunctionals.size(); t++) {
+            if (write_data && clog(debug)) {
+                PhaseTimer timer(profiler.phase("output"), n * a_steps);
+                Eigen::RowVectorXf values = sinograms[t].row(i);
+                Eigen::MatrixXf sinogram =
+                    Eigen::Map<const Eigen::MatrixXf>(values.data(), n,
+                                                      a_steps);
+
+                // Save the sinogram trace and image
+                std::stringstream fn_trace_data, fn_trace_image;
+                fn_trace_data << _basenames[i] << "-" << tfunctionals[t].name
+                              << ".csv";
+                writecsv(fn_trace_data.str(), sinogram);
+                fn_trace_image << _basenames[i] << "-"
+                               << tfunctionals[t].name << ".pgm";
+                writepgm(fn_trace_image.str(), mat2gray(sinogram));
+            }
+
+            for (size_t p = 0; p < pfunctionals.size(); p++) {
+                PhaseTimer timer(profiler.phase("zscore"), a_steps);
+                Eigen::VectorXf circusfunction =
+                    circusfunctions[t].row(i).transpose();
+                signatures[i].col(t * pfunctionals.size() + p) =
+                    zscore(circusfunction);
+            }
+        }
+
+        // Save the signatures
+        if (write_data && pfunctionals.size() > 0) {
+            PhaseTimer timer(profiler.phase("output"), signatures[i].size());
+            writecsv(_basenames[i] + ".csv", signatures[i]);
+        }
+    }
+
+    return signatures;
+}
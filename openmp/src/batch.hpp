@@ -0,0 +1,77 @@
+//
+// Configuration
+//
+
+// Include guard
+#ifndef _TRACETRANSFORM_BATCH_
+#define _TRACETRANSFORM_BATCH_
+
+// Standard library
+#include <cstddef> // for size_t
+#include <string>  // for string
+#include <vector>  // for vector
+
+// Eigen
+#include <Eigen/Dense>
+
+// Local
+#include "sinogram.hpp"
+#include "circus.hpp"
+
+
+//
+// Module definitions
+//
+
+// Amount of images transformed together, one per SIMD lane
+#ifdef __AVX512F__
+const int batch_lanes = 16;
+#else
+const int batch_lanes = 8;
+#endif
+
+// Largest padded image size worth transforming in batches: beyond it the
+// columns are long enough to vectorize along, and the rotated images of a
+// batch no longer fit in the cache
+const int batch_max_size = 160;
+
+// Pixels of a batch of images of the same size, as a column of lanes per
+// pixel (with the pixels in column-major order), so a single operation
+// processes the same pixel of every image
+typedef Eigen::Matrix<float, batch_lanes, Eigen::Dynamic> BatchImage;
+
+// Transform of up to batch_lanes small images at once, rotating and tracing
+// them together rather than one by one, for the per-image overhead and the
+// short columns of thumbnails not to dominate
+// NOTE: only the column-wise Radon, T1, T2 and P1 functionals are supported
+// NOTE: the columns of all images are summed at once, in a different order
+//       than those of a single image, so the signatures differ in rounding
+//       from those of Transformer (only the medians of T1 and T2 get found
+//       on totals summed like it does, as they'd shift otherwise)
+class BatchTransformer {
+  public:
+    BatchTransformer(const std::vector<Eigen::MatrixXf> &images,
+                     const std::vector<std::string> &basenames,
+                     unsigned int angle_stepsize);
+
+    // Whether images of the given size are best transformed in batches, with
+    // functionals the batched engine supports
+    static bool supports(size_t rows, size_t cols, bool orthonormal,
+                         const std::vector<TFunctionalWrapper> &tfunctionals,
+                         const std::vector<PFunctionalWrapper> &pfunctionals);
+
+    // Calculate the signatures of every image, laid out like those of
+    // Transformer::getTransform, and write them to disk if requested
+    std::vector<Eigen::MatrixXf>
+    getTransform(const std::vector<TFunctionalWrapper> &tfunctionals,
+                 const std::vector<PFunctionalWrapper> &pfunctionals,
+                 bool write_data = true) const;
+
+  private:
+    BatchImage _images;
+    int _size;
+    std::vector<std::string> _basenames;
+    unsigned int _angle_stepsize;
+};
+
+#endif
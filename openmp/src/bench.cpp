@@ -0,0 +1,399 @@
+//
+// Configuration
+//
+
+// Standard library
+#include <algorithm>  // for find
+#include <chrono>     // for steady_clock, duration
+#include <cstddef>    // for size_t
+#include <exception>  // for exception
+#include <functional> // for function
+#include <iomanip>    // for setw, setprecision
+#include <iostream>   // for operator<<, ostream, etc
+#include <string>     // for string
+#include <vector>     // for vector
+
+// Boost
+#include <boost/program_options.hpp>
+
+// Local
+#include "logger.hpp"
+#include "auxiliary.hpp"
+#include "functionals.hpp"
+#include "circus.hpp"
+#include "synthetic.hpp"
+
+
+//
+// Structures
+//
+
+// Single invocation of a kernel on inputs of a given size
+struct Workload {
+    // Amount of elements processed, and bytes read and written
+    size_t elements, bytes;
+
+    std::function<void()> run;
+    std::function<void()> cleanup;
+};
+
+// Kernel under test, producing a workload for a given size
+struct Kernel {
+    std::string name;
+    std::function<Workload(int size)> prepare;
+
+    // Largest size to benchmark (0 if unlimited)
+    int max_size;
+};
+
+
+//
+// Auxiliary
+//
+
+// Results are accumulated in here, so the kernels cannot be optimized away
+volatile float sink;
+
+// Seed of the generated inputs, the same for every kernel and size
+unsigned int seed = 0;
+
+Eigen::MatrixXf synthetic(int size) {
+    return gray2mat(generateImage(SyntheticPattern::Noise, size, seed));
+}
+
+// Apply a column-wise functional to every column of a square matrix
+Workload columnwise(int size, std::function<float(const Eigen::VectorXf &)> f,
+                    std::function<void()> cleanup = std::function<void()>()) {
+    Eigen::MatrixXf data = synthetic(size);
+    Workload workload;
+    workload.elements = data.size();
+    workload.bytes = data.size() * sizeof(float);
+    workload.run = [=]() {
+        float sum = 0;
+        for (int col = 0; col < data.cols(); col++) {
+            Eigen::VectorXf column = data.col(col);
+            sum += f(column);
+        }
+        sink = sum;
+    };
+    workload.cleanup = cleanup;
+    return workload;
+}
+
+// Apply a batched functional to a square matrix
+Workload batched(int size,
+                 std::function<void(const Eigen::MatrixXf &, float *)> f,
+                 std::function<void()> cleanup = std::function<void()>()) {
+    Eigen::MatrixXf data = synthetic(size);
+    Workload workload;
+    workload.elements = data.size();
+    workload.bytes = data.size() * sizeof(float);
+    workload.run = [=]() {
+        Eigen::VectorXf output(data.cols());
+        f(data, output.data());
+        sink = output.sum();
+    };
+    workload.cleanup = cleanup;
+    return workload;
+}
+
+std::vector<Kernel> suite(int nos_max_size) {
+    std::vector<Kernel> kernels;
+
+    //
+    // Image operations
+    //
+
+    kernels.push_back({"rotate", [](int size) {
+        Eigen::MatrixXf data = synthetic(size);
+        Point<float>::type origin((size - 1) / 2.0, (size - 1) / 2.0);
+        Workload workload;
+        workload.elements = data.size();
+        workload.bytes = 2 * data.size() * sizeof(float);
+        workload.run = [=]() {
+            sink = rotate(data, origin, deg2rad(30)).sum();
+        };
+        return workload;
+    }, 0});
+
+    kernels.push_back({"interpolate", [](int size) {
+        Eigen::MatrixXf data = synthetic(size);
+        Workload workload;
+        workload.elements = data.size();
+        workload.bytes = 4 * data.size() * sizeof(float);
+        workload.run = [=]() {
+            float sum = 0;
+            for (int col = 0; col < size - 1; col++)
+                for (int row = 0; row < size - 1; row++)
+                    sum += interpolate(
+                        data, Point<float>::type(col + 0.25, row + 0.75));
+            sink = sum;
+        };
+        return workload;
+    }, 0});
+
+    kernels.push_back({"pad", [](int size) {
+        Eigen::MatrixXf data = synthetic(size);
+        Workload workload;
+        workload.elements = data.size();
+        workload.bytes = 3 * data.size() * sizeof(float);
+        workload.run = [=]() { sink = pad(data)(0, 0); };
+        return workload;
+    }, 0});
+
+    kernels.push_back({"resize", [](int size) {
+        Eigen::MatrixXf data = synthetic(size);
+        Workload workload;
+        workload.elements = data.size();
+        workload.bytes = 2 * data.size() * sizeof(float);
+        workload.run = [=]() {
+            sink = resize(data, size * 3 / 4, size * 3 / 4)(0, 0);
+        };
+        return workload;
+    }, 0});
+
+    kernels.push_back({"zscore", [](int size) {
+        Eigen::MatrixXf image = synthetic(size);
+        Eigen::VectorXf data =
+            Eigen::Map<Eigen::VectorXf>(image.data(), image.size());
+        Workload workload;
+        workload.elements = data.size();
+        workload.bytes = 2 * data.size() * sizeof(float);
+        workload.run = [=]() { sink = zscore(data)(0); };
+        return workload;
+    }, 0});
+
+    kernels.push_back({"nos", [](int size) {
+        Eigen::MatrixXf data = synthetic(size);
+        Workload workload;
+        workload.elements = data.size();
+        workload.bytes = 2 * data.size() * sizeof(float);
+        workload.run = [=]() {
+            size_t center;
+            sink = nearest_orthonormal_sinogram(data, center)(0, 0);
+        };
+        return workload;
+    }, nos_max_size});
+
+    //
+    // Functionals
+    //
+
+    kernels.push_back({"findWeightedMedian", [](int size) {
+        return columnwise(size, [](const Eigen::VectorXf &data) {
+            return (float)findWeightedMedian(data);
+        });
+    }, 0});
+
+    kernels.push_back({"Radon", [](int size) {
+        return columnwise(size, TFunctionalRadon);
+    }, 0});
+    kernels.push_back({"T1", [](int size) {
+        return columnwise(size, TFunctional1);
+    }, 0});
+    kernels.push_back({"T2", [](int size) {
+        return columnwise(size, TFunctional2);
+    }, 0});
+
+    typedef TFunctional345_precalc_t *(*TFunctional345_prepare_t)(int, int);
+    const char *names345[] = {"T3", "T4", "T5"};
+    TFunctional345_prepare_t prepares345[] = {
+        TFunctional3_prepare, TFunctional4_prepare, TFunctional5_prepare};
+    for (int i = 0; i < 3; i++) {
+        TFunctional345_prepare_t prepare = prepares345[i];
+        kernels.push_back({names345[i], [prepare](int size) {
+            TFunctional345_precalc_t *precalc = prepare(size, size);
+            return columnwise(size,
+                              [precalc](const Eigen::VectorXf &data) {
+                                  return TFunctional345(data, precalc);
+                              },
+                              [precalc]() { TFunctional345_destroy(precalc); });
+        }, 0});
+        kernels.push_back({std::string(names345[i]) + " (fft)",
+                           [prepare](int size) {
+            TFunctional345_precalc_t *precalc = prepare(size, size);
+            TFunctional345_prepare_fft(precalc, size);
+            return batched(size,
+                           [precalc](const Eigen::MatrixXf &data,
+                                     float *output) {
+                               TFunctional345_batch(data, precalc, output);
+                           },
+                           [precalc]() { TFunctional345_destroy(precalc); });
+        }, 0});
+    }
+
+    kernels.push_back({"T6", [](int size) {
+        return columnwise(size, TFunctional6);
+    }, 0});
+    kernels.push_back({"T6 (batch)", [](int size) {
+        return batched(size, [](const Eigen::MatrixXf &data, float *output) {
+            TFunctional6_batch(data, output);
+        });
+    }, 0});
+    kernels.push_back({"T7", [](int size) {
+        return columnwise(size, TFunctional7);
+    }, 0});
+    kernels.push_back({"T7 (batch)", [](int size) {
+        return batched(size, [](const Eigen::MatrixXf &data, float *output) {
+            TFunctional7_batch(data, output);
+        });
+    }, 0});
+
+    kernels.push_back({"P1", [](int size) {
+        return columnwise(size, PFunctional1);
+    }, 0});
+    kernels.push_back({"P2", [](int size) {
+        return columnwise(size, PFunctional2);
+    }, 0});
+    kernels.push_back({"P2 (batch)", [](int size) {
+        return batched(size, [](const Eigen::MatrixXf &data, float *output) {
+            PFunctional2_batch(data, output);
+        });
+    }, 0});
+    kernels.push_back({"P3", [](int size) {
+        PFunctional3_precalc_t *precalc = PFunctional3_prepare(size);
+        return columnwise(size,
+                          [precalc](const Eigen::VectorXf &data) {
+                              return PFunctional3(data, precalc);
+                          },
+                          [precalc]() { PFunctional3_destroy(precalc); });
+    }, 0});
+    kernels.push_back({"H1", [](int size) {
+        return columnwise(size, [size](const Eigen::VectorXf &data) {
+            return PFunctionalHermite(data, 1, size / 2);
+        });
+    }, 0});
+
+    return kernels;
+}
+
+
+//
+// Main application
+//
+
+int main(int argc, char **argv) {
+    //
+    // Initialization
+    //
+
+    // Program input
+    int min_size, max_size, nos_max_size;
+    double min_time;
+    std::vector<std::string> filters;
+
+    // Declare named options
+    boost::program_options::options_description desc("Allowed options");
+    desc.add_options()
+        ("help,h",
+            "produce help message")
+        ("quiet,q",
+            "only display errors and warnings")
+        ("min-size",
+            boost::program_options::value<int>(&min_size)
+                ->default_value(64),
+            "smallest input size")
+        ("max-size",
+            boost::program_options::value<int>(&max_size)
+                ->default_value(4096),
+            "largest input size")
+        ("nos-max-size",
+            boost::program_options::value<int>(&nos_max_size)
+                ->default_value(512),
+            "largest input size for the (cubic) nearest orthonormal "
+            "sinogram")
+        ("min-time",
+            boost::program_options::value<double>(&min_time)
+                ->default_value(0.1),
+            "minimal time (in seconds) to repeat every measurement for")
+        ("kernels,k",
+            boost::program_options::value<std::vector<std::string>>(&filters),
+            "only benchmark the given kernels")
+        ("seed",
+            boost::program_options::value<unsigned int>(&seed)
+                ->default_value(0),
+            "seed of the generated inputs")
+    ;
+
+    // Parse the options
+    boost::program_options::variables_map vm;
+    try {
+        store(boost::program_options::command_line_parser(argc, argv)
+                  .options(desc)
+                  .run(),
+              vm);
+        notify(vm);
+        if (min_size < 1 || max_size < min_size)
+            throw boost::program_options::validation_error(
+                boost::program_options::validation_error::
+                    invalid_option_value,
+                "max-size");
+    }
+    catch (const std::exception &e) {
+        std::cerr << "Invalid usage: " << e.what() << std::endl;
+
+        std::cout << desc << std::endl;
+        return 1;
+    }
+
+    // Display help
+    if (vm.count("help")) {
+        std::cout << desc << std::endl;
+        return 0;
+    }
+
+    // Configure logging
+    if (vm.count("quiet"))
+        logger.settings.threshold = warning;
+
+
+    //
+    // Execution
+    //
+
+    clog(info) << std::left << std::setw(20) << "kernel" << std::right
+               << std::setw(8) << "size" << std::setw(10) << "reps"
+               << std::setw(14) << "ns/element" << std::setw(10) << "GB/s"
+               << std::endl;
+    std::vector<Kernel> kernels = suite(nos_max_size);
+    for (size_t k = 0; k < kernels.size(); k++) {
+        const Kernel &kernel = kernels[k];
+        if (!filters.empty() &&
+            std::find(filters.begin(), filters.end(), kernel.name) ==
+                filters.end())
+            continue;
+
+        for (int size = min_size; size <= max_size; size *= 2) {
+            if (kernel.max_size > 0 && size > kernel.max_size)
+                break;
+            Workload workload = kernel.prepare(size);
+
+            // Warm-up
+            workload.run();
+
+            // Repeat until the measurement is long enough
+            size_t repetitions = 0;
+            std::chrono::duration<double> elapsed(0);
+            std::chrono::steady_clock::time_point start =
+                std::chrono::steady_clock::now();
+            do {
+                workload.run();
+                repetitions++;
+                elapsed = std::chrono::steady_clock::now() - start;
+            } while (elapsed.count() < min_time);
+            double seconds = elapsed.count() / repetitions;
+
+            clog(info) << std::left << std::setw(20) << kernel.name
+                       << std::right << std::setw(8) << size << std::setw(10)
+                       << repetitions << std::fixed << std::setprecision(3)
+                       << std::setw(14) << 1e9 * seconds / workload.elements
+                       << std::setprecision(2) << std::setw(10)
+                       << workload.bytes / seconds / 1e9 << std::endl;
+
+            if (workload.cleanup)
+                workload.cleanup();
+        }
+    }
+
+    return 0;
+}
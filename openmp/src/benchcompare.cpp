@@ -0,0 +1,241 @@
+//
+// Configuration
+//
+
+// Standard library
+#include <algorithm> // for sort
+#include <cstddef>   // for size_t
+#include <exception> // for exception
+#include <iomanip>   // for setw, setprecision
+#include <iostream>  // for operator<<, ostream, etc
+#include <map>       // for map
+#include <string>    // for string
+#include <vector>    // for vector
+
+// Boost
+#include <boost/program_options.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/foreach.hpp>
+
+// Local
+#include "logger.hpp"
+
+
+//
+// Auxiliary
+//
+
+typedef boost::property_tree::ptree ptree;
+
+// Per-phase values of a single benchmark
+typedef std::map<std::string, double> Phases;
+
+double median(std::vector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+    size_t n = samples.size();
+    if (n == 0)
+        return 0;
+    return (n % 2) ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) / 2;
+}
+
+// Extract the requested statistic of every phase, and the median iteration
+// time as an additional "total" phase
+std::map<std::string, Phases> readReport(const std::string &filename,
+                                         const std::string &statistic,
+                                         ptree &tree) {
+    boost::property_tree::read_json(filename, tree);
+
+    std::map<std::string, Phases> benchmarks;
+    BOOST_FOREACH(const ptree::value_type & benchmark,
+                  tree.get_child("benchmarks")) {
+        Phases &phases =
+            benchmarks[benchmark.second.get<std::string>("input")];
+
+        std::vector<double> iterations;
+        BOOST_FOREACH(const ptree::value_type & iteration,
+                      benchmark.second.get_child("iterations"))
+            iterations.push_back(iteration.second.get_value<double>());
+        phases["total"] = median(iterations);
+
+        BOOST_FOREACH(const ptree::value_type & phase,
+                      benchmark.second.get_child("phases"))
+            phases[phase.second.get<std::string>("name")] =
+                phase.second.get<double>(statistic);
+    }
+    return benchmarks;
+}
+
+void compareEnvironment(const ptree &baseline, const ptree &candidate,
+                        const std::string &key) {
+    std::string expected = baseline.get<std::string>(key, "");
+    std::string actual = candidate.get<std::string>(key, "");
+    if (expected != actual)
+        clog(warning) << "Reports differ in " << key << " ('" << expected
+                      << "' vs '" << actual << "')" << std::endl;
+}
+
+
+//
+// Main
+//
+
+int main(int argc, char **argv) {
+    //
+    // Initialization
+    //
+
+    // Program input
+    std::string baseline_file, candidate_file, statistic;
+    double threshold, min_time;
+
+    // Declare named options
+    boost::program_options::options_description desc("Allowed options");
+    desc.add_options()
+        ("help,h",
+            "produce help message")
+        ("quiet,q",
+            "only display errors and warnings")
+        ("verbose,v",
+            "display some more details")
+        ("threshold,t",
+            boost::program_options::value<double>(&threshold)
+                ->default_value(0.1),
+            "relative slowdown from which on a phase counts as a regression")
+        ("statistic,s",
+            boost::program_options::value<std::string>(&statistic)
+                ->default_value("median"),
+            "phase statistic to compare ('mean', 'median', 'min' or 'p95')")
+        ("min-time",
+            boost::program_options::value<double>(&min_time)
+                ->default_value(1e-4),
+            "baseline time (in seconds) below which phases are not checked")
+        ("baseline",
+            boost::program_options::value<std::string>(&baseline_file)
+                ->required(),
+            "report of the reference run")
+        ("candidate",
+            boost::program_options::value<std::string>(&candidate_file)
+                ->required(),
+            "report of the run to check")
+    ;
+
+    // Declare positional options
+    boost::program_options::positional_options_description pod;
+    pod.add("baseline", 1);
+    pod.add("candidate", 1);
+
+    // Parse the options
+    boost::program_options::variables_map vm;
+    try {
+        store(boost::program_options::command_line_parser(argc, argv)
+                  .options(desc)
+                  .positional(pod)
+                  .run(),
+              vm);
+    }
+    catch (const std::exception &e) {
+        std::cerr << "Error " << e.what() << std::endl;
+
+        std::cout << desc << std::endl;
+        return 1;
+    }
+
+    // Display help
+    if (vm.count("help")) {
+        std::cout << desc << std::endl;
+        return 0;
+    }
+
+    // Notify the user of errors
+    try {
+        notify(vm);
+        if (statistic != "mean" && statistic != "median" &&
+            statistic != "min" && statistic != "p95")
+            throw boost::program_options::validation_error(
+                boost::program_options::validation_error::
+                    invalid_option_value,
+                "statistic", statistic);
+    }
+    catch (const std::exception &e) {
+        std::cerr << "Invalid usage: " << e.what() << std::endl;
+
+        std::cout << desc << std::endl;
+        return 1;
+    }
+
+    // Configure logging
+    if (vm.count("verbose"))
+        logger.settings.threshold = debug;
+    else if (vm.count("quiet"))
+        logger.settings.threshold = warning;
+
+
+    //
+    // Execution
+    //
+
+    // Load the reports
+    ptree baseline_tree, candidate_tree;
+    std::map<std::string, Phases> baseline, candidate;
+    try {
+        baseline = readReport(baseline_file, statistic, baseline_tree);
+        candidate = readReport(candidate_file, statistic, candidate_tree);
+    }
+    catch (const std::exception &e) {
+        clog(error) << "Could not read report: " << e.what() << std::endl;
+        return 1;
+    }
+    compareEnvironment(baseline_tree, candidate_tree, "build.type");
+    compareEnvironment(baseline_tree, candidate_tree, "build.flags");
+    compareEnvironment(baseline_tree, candidate_tree, "machine.cpu");
+    compareEnvironment(baseline_tree, candidate_tree, "machine.threads");
+
+    // Compare all phases
+    unsigned int regressions = 0;
+    clog(info) << std::left << std::setw(32) << "phase" << std::right
+               << std::setw(12) << "baseline" << std::setw(12) << "candidate"
+               << std::setw(10) << "change" << std::endl;
+    for (std::map<std::string, Phases>::const_iterator benchmark =
+             baseline.begin();
+         benchmark != baseline.end(); ++benchmark) {
+        if (candidate.count(benchmark->first) == 0) {
+            clog(warning) << "Benchmark of " << benchmark->first
+                          << " missing from candidate report" << std::endl;
+            continue;
+        }
+        const Phases &phases = candidate[benchmark->first];
+
+        for (Phases::const_iterator phase = benchmark->second.begin();
+             phase != benchmark->second.end(); ++phase) {
+            std::string name = benchmark->first + "/" + phase->first;
+            if (phases.count(phase->first) == 0) {
+                clog(warning) << "Phase " << name
+                              << " missing from candidate report" << std::endl;
+                continue;
+            }
+            double expected = phase->second;
+            double actual = phases.find(phase->first)->second;
+            double change = (expected > 0) ? actual / expected - 1 : 0;
+
+            bool checked = expected >= min_time;
+            bool regressed = checked && change > threshold;
+            if (regressed)
+                regressions++;
+            clog(regressed ? warning : info)
+                << std::left << std::setw(32) << name << std::right
+                << std::fixed << std::setprecision(6) << std::setw(12)
+                << expected << std::setw(12) << actual << std::setprecision(1)
+                << std::setw(9) << 100 * change << "%"
+                << (regressed ? "  REGRESSION" : (checked ? "" : "  (ignored)"))
+                << std::endl;
+        }
+    }
+
+    if (regressions > 0) {
+        clog(error) << regressions << " phase(s) slowed down more than "
+                    << 100 * threshold << "%" << std::endl;
+        return 1;
+    }
+    return 0;
+}
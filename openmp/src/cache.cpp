@@ -0,0 +1,348 @@
+//
+// Configuration
+//
+
+// Header include
+#include "cache.hpp"
+
+// Standard library
+#include <string.h>  // for memcpy
+#include <unistd.h>  // for getpid
+#include <algorithm> // for sort
+#include <cstdio>    // for rename, remove
+#include <ctime>     // for time
+#include <fstream>   // for ifstream, ofstream
+#include <iomanip>   // for setw, setfill
+#include <new>       // for bad_alloc
+#include <sstream>   // for stringstream
+#include <thread>    // for this_thread
+#include <utility>   // for pair
+
+// Boost
+#include <boost/filesystem.hpp>
+
+// Local
+#include "logger.hpp"
+
+
+//
+// Auxiliary
+//
+
+namespace {
+
+const uint32_t cache_magic = 0x434d5454; // "TTMC"
+const uint32_t cache_version = 1;
+const char *cache_extension = ".cache";
+const uint32_t max_matrices = 1024;
+
+// MurmurHash64A, by Austin Appleby
+uint64_t murmur(const void *key, size_t length, uint64_t seed) {
+    const uint64_t m = 0xc6a4a7935bd1e995ULL;
+    const int r = 47;
+    uint64_t h = seed ^ (length * m);
+
+    const unsigned char *data = static_cast<const unsigned char *>(key);
+    const unsigned char *end = data + length / 8 * 8;
+    for (; data != end; data += 8) {
+        uint64_t k;
+        memcpy(&k, data, sizeof(k));
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+    }
+
+    switch (length & 7) {
+    case 7:
+        h ^= uint64_t(data[6]) << 48;
+        // fall through
+    case 6:
+        h ^= uint64_t(data[5]) << 40;
+        // fall through
+    case 5:
+        h ^= uint64_t(data[4]) << 32;
+        // fall through
+    case 4:
+        h ^= uint64_t(data[3]) << 24;
+        // fall through
+    case 3:
+        h ^= uint64_t(data[2]) << 16;
+        // fall through
+    case 2:
+        h ^= uint64_t(data[1]) << 8;
+        // fall through
+    case 1:
+        h ^= uint64_t(data[0]);
+        h *= m;
+    }
+
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
+}
+
+void hashShape(Hasher &hasher, const char *type, size_t rows, size_t cols) {
+    uint64_t shape[2] = {rows, cols};
+    hasher.update(type);
+    hasher.update(shape, sizeof(shape));
+}
+
+}
+
+
+//
+// Content hashing
+//
+
+Hasher::Hasher() {
+    _lanes[0] = 0x9e3779b97f4a7c15ULL;
+    _lanes[1] = 0xd1b54a32d192ed03ULL;
+}
+
+void Hasher::update(const void *data, size_t length) {
+    // NOTE: both lanes chain on their previous value, so the result depends
+    //       on the order of the updates
+    _lanes[0] = murmur(data, length, _lanes[0]);
+    _lanes[1] = murmur(data, length, _lanes[1] ^ 0x5bd1e9955bd1e995ULL);
+}
+
+void Hasher::update(const std::string &text) {
+    update(text.data(), text.size());
+}
+
+std::string Hasher::hex() const {
+    std::stringstream ss;
+    ss << std::hex << std::setfill('0') << std::setw(16) << _lanes[0]
+       << std::setw(16) << _lanes[1];
+    return ss.str();
+}
+
+void hashImage(Hasher &hasher, const Eigen::MatrixXi &image) {
+    hashShape(hasher, "gray", image.rows(), image.cols());
+    std::vector<unsigned char> row(image.cols());
+    for (int r = 0; r < image.rows(); r++) {
+        for (int c = 0; c < image.cols(); c++)
+            row[c] = image(r, c);
+        hasher.update(row.data(), row.size());
+    }
+}
+
+void hashImage(Hasher &hasher, const GrayImageView &image) {
+    hashShape(hasher, "gray", image.rows(), image.cols());
+    for (int r = 0; r < image.rows(); r++)
+        hasher.update(image.data() + r * image.outerStride(), image.cols());
+}
+
+void hashImage(Hasher &hasher, const FloatImageView &image) {
+    hashShape(hasher, "float", image.rows(), image.cols());
+    for (int r = 0; r < image.rows(); r++)
+        hasher.update(image.data() + r * image.outerStride(),
+                      image.cols() * sizeof(float));
+}
+
+std::string
+describeFunctionals(const std::vector<TFunctionalWrapper> &tfunctionals) {
+    std::stringstream ss;
+    for (size_t t = 0; t < tfunctionals.size(); t++) {
+        const TFunctionalArguments &arguments = tfunctionals[t].arguments;
+        ss << tfunctionals[t].name << "(" << arguments.fft_threshold << ","
+           << arguments.approx_bins << ") ";
+    }
+    return ss.str();
+}
+
+std::string
+describeFunctionals(const std::vector<PFunctionalWrapper> &pfunctionals) {
+    std::stringstream ss;
+    for (size_t p = 0; p < pfunctionals.size(); p++) {
+        const PFunctionalArguments &arguments = pfunctionals[p].arguments;
+        ss << pfunctionals[p].name << "(" << arguments.approx_bins << ") ";
+    }
+    return ss.str();
+}
+
+std::string signatureKey(Hasher hasher, unsigned int angle_stepsize,
+                         const std::vector<TFunctionalWrapper> &tfunctionals,
+                         const std::vector<PFunctionalWrapper> &pfunctionals) {
+    std::stringstream parameters;
+    parameters << "signatures " << angle_stepsize << " "
+               << describeFunctionals(tfunctionals) << "| "
+               << describeFunctionals(pfunctionals);
+    hasher.update(parameters.str());
+    return hasher.hex();
+}
+
+std::string sinogramKey(Hasher hasher, unsigned int angle_stepsize,
+                        bool orthonormal,
+                        const std::vector<TFunctionalWrapper> &tfunctionals) {
+    std::stringstream parameters;
+    parameters << "sinograms " << angle_stepsize << " "
+               << (orthonormal ? "stretched " : "")
+               << describeFunctionals(tfunctionals);
+    hasher.update(parameters.str());
+    return hasher.hex();
+}
+
+
+//
+// Module definitions
+//
+
+MatrixCache::MatrixCache(const std::string &directory, size_t capacity)
+    : _directory(directory), _capacity(capacity), _size(0), _hits(0),
+      _misses(0) {
+    // NOTE: without a directory every lookup misses and every store fails,
+    //       which only costs the benefit of the cache
+    boost::system::error_code ec;
+    boost::filesystem::create_directories(_directory, ec);
+    if (ec)
+        clog(warning) << "Could not create cache directory " << _directory
+                      << ": " << ec.message() << std::endl;
+
+    // Account what previous runs left behind
+    std::lock_guard<std::mutex> lock(_mutex);
+    evict();
+}
+
+std::string MatrixCache::path(const std::string &key) const {
+    return (boost::filesystem::path(_directory) / (key + cache_extension))
+        .string();
+}
+
+bool MatrixCache::load(const std::string &key,
+                       std::vector<Eigen::MatrixXf> &matrices) {
+    std::string filename = path(key);
+    std::ifstream file(filename.c_str(), std::ios::binary);
+    if (!file) {
+        _misses++;
+        return false;
+    }
+
+    // NOTE: the shapes get checked against what's left of the file, so a
+    //       corrupt entry can't make us allocate more than it holds
+    file.seekg(0, std::ios::end);
+    uint64_t remaining = file.tellg();
+    file.seekg(0, std::ios::beg);
+
+    uint32_t header[3];
+    bool valid = file.read((char *)header, sizeof(header)) &&
+                 header[0] == cache_magic && header[1] == cache_version &&
+                 header[2] <= max_matrices;
+    remaining -= valid ? sizeof(header) : 0;
+    std::vector<Eigen::MatrixXf> entry(valid ? header[2] : 0);
+    for (size_t i = 0; valid && i < entry.size(); i++) {
+        uint32_t shape[2];
+        valid = file.read((char *)shape, sizeof(shape)) &&
+                (uint64_t)shape[0] * shape[1] * sizeof(float) <=
+                    remaining - sizeof(shape);
+        if (valid) {
+            remaining -= sizeof(shape) +
+                         (uint64_t)shape[0] * shape[1] * sizeof(float);
+            try {
+                entry[i].resize(shape[0], shape[1]);
+            } catch (const std::bad_alloc &) {
+                clog(warning) << "Could not allocate cache entry "
+                              << filename << std::endl;
+                _misses++;
+                return false;
+            }
+            valid = (bool)file.read((char *)entry[i].data(),
+                                    entry[i].size() * sizeof(float));
+        }
+    }
+    if (!valid) {
+        clog(warning) << "Removing corrupt cache entry " << filename
+                      << std::endl;
+        file.close();
+        std::remove(filename.c_str());
+        _misses++;
+        return false;
+    }
+
+    // Mark the entry as recently used
+    boost::system::error_code ec;
+    boost::filesystem::last_write_time(filename, std::time(NULL), ec);
+
+    matrices.swap(entry);
+    _hits++;
+    return true;
+}
+
+void MatrixCache::store(const std::string &key,
+                        const std::vector<Eigen::MatrixXf> &matrices) {
+    // Write to a file private to this thread, and rename it into place
+    std::stringstream temporary;
+    temporary << path(key) << ".tmp." << getpid() << "."
+              << std::this_thread::get_id();
+    size_t size = 3 * sizeof(uint32_t);
+    {
+        std::ofstream file(temporary.str().c_str(), std::ios::binary);
+        uint32_t header[3] = {cache_magic, cache_version,
+                              (uint32_t)matrices.size()};
+        file.write((const char *)header, sizeof(header));
+        for (size_t i = 0; i < matrices.size(); i++) {
+            uint32_t shape[2] = {(uint32_t)matrices[i].rows(),
+                                 (uint32_t)matrices[i].cols()};
+            file.write((const char *)shape, sizeof(shape));
+            file.write((const char *)matrices[i].data(),
+                       matrices[i].size() * sizeof(float));
+            size += sizeof(shape) + matrices[i].size() * sizeof(float);
+        }
+        if (!file) {
+            clog(warning) << "Could not write cache entry " << path(key)
+                          << std::endl;
+            file.close();
+            std::remove(temporary.str().c_str());
+            return;
+        }
+    }
+    if (std::rename(temporary.str().c_str(), path(key).c_str()) != 0) {
+        std::remove(temporary.str().c_str());
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _size += size;
+    if (_size > _capacity)
+        evict();
+}
+
+void MatrixCache::evict() {
+    // NOTE: other processes might share the directory, so rather than
+    //       keeping track of the entries, the directory gets scanned
+    std::vector<std::pair<std::time_t, boost::filesystem::path>> entries;
+    size_t total = 0;
+    boost::system::error_code ec;
+    for (boost::filesystem::directory_iterator it(_directory, ec), end;
+         !ec && it != end; it.increment(ec)) {
+        const boost::filesystem::path &entry = it->path();
+        if (entry.extension() != cache_extension)
+            continue;
+        boost::system::error_code size_ec, time_ec;
+        size_t size = boost::filesystem::file_size(entry, size_ec);
+        std::time_t time = boost::filesystem::last_write_time(entry, time_ec);
+        if (size_ec || time_ec)
+            continue;
+        entries.push_back(std::make_pair(time, entry));
+        total += size;
+    }
+
+    // Leave some headroom, so not every store has to evict
+    if (total > _capacity) {
+        std::sort(entries.begin(), entries.end());
+        size_t target = _capacity / 10 * 9;
+        for (size_t i = 0; i < entries.size() && total > target; i++) {
+            boost::system::error_code size_ec;
+            size_t size = boost::filesystem::file_size(entries[i].second,
+                                                       size_ec);
+            if (!size_ec && boost::filesystem::remove(entries[i].second, ec))
+                total -= size;
+        }
+        clog(debug) << "Evicted cache entries down to " << total
+                    << " bytes" << std::endl;
+    }
+    _size = total;
+}
@@ -0,0 +1,107 @@
+//
+// Configuration
+//
+
+// Include guard
+#ifndef _TRACETRANSFORM_CACHE_
+#define _TRACETRANSFORM_CACHE_
+
+// Standard library
+#include <stdint.h> // for uint64_t
+#include <atomic>   // for atomic
+#include <cstddef>  // for size_t
+#include <mutex>    // for mutex
+#include <string>   // for string
+#include <vector>   // for vector
+
+// Eigen
+#include <Eigen/Dense>
+
+// Local
+#include "auxiliary.hpp"
+#include "sinogram.hpp"
+#include "circus.hpp"
+
+
+//
+// Content hashing
+//
+
+// 128-bit non-cryptographic hash, fed incrementally
+class Hasher {
+  public:
+    Hasher();
+
+    void update(const void *data, size_t length);
+    void update(const std::string &text);
+
+    std::string hex() const;
+
+  private:
+    uint64_t _lanes[2];
+};
+
+// Hash the pixels of an image, independently of how it is laid out in memory
+// NOTE: grayscale images hash the same whether they come as a matrix of
+//       integers or as bytes, but differently from their float conversion
+void hashImage(Hasher &hasher, const Eigen::MatrixXi &image);
+void hashImage(Hasher &hasher, const GrayImageView &image);
+void hashImage(Hasher &hasher, const FloatImageView &image);
+
+// Describe the functionals, including every argument which affects their
+// results, for them to be part of a cache key
+std::string describeFunctionals(
+    const std::vector<TFunctionalWrapper> &tfunctionals);
+std::string describeFunctionals(
+    const std::vector<PFunctionalWrapper> &pfunctionals);
+
+// Key of the signatures of an image, given the hash of its pixels
+std::string signatureKey(Hasher hasher, unsigned int angle_stepsize,
+                         const std::vector<TFunctionalWrapper> &tfunctionals,
+                         const std::vector<PFunctionalWrapper> &pfunctionals);
+
+// Key of the sinograms of an image (which orthonormal P-functionals get
+// calculated from a stretched image)
+std::string sinogramKey(Hasher hasher, unsigned int angle_stepsize,
+                        bool orthonormal,
+                        const std::vector<TFunctionalWrapper> &tfunctionals);
+
+
+//
+// Module definitions
+//
+
+// On-disk cache of matrices, keyed by a hash of whatever they were computed
+// from, and bounded in size by evicting the least recently used entries
+// NOTE: entries are written to a temporary file and renamed into place, so
+//       several processes can share a cache directory
+class MatrixCache {
+  public:
+    MatrixCache(const std::string &directory, size_t capacity);
+
+    // Look up an entry, returning false on a miss
+    bool load(const std::string &key, std::vector<Eigen::MatrixXf> &matrices);
+
+    void store(const std::string &key,
+               const std::vector<Eigen::MatrixXf> &matrices);
+
+    size_t hits() const { return _hits; }
+    size_t misses() const { return _misses; }
+
+  private:
+    std::string path(const std::string &key) const;
+
+    // Remove the oldest entries until the cache fits its capacity
+    void evict();
+
+    std::string _directory;
+    size_t _capacity;
+
+    // Bytes taken by the entries, as of the last scan plus what got stored
+    std::mutex _mutex;
+    size_t _size;
+
+    std::atomic<size_t> _hits, _misses;
+};
+
+#endif
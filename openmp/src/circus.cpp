@@ -13,6 +13,10 @@
 #include <cassert>   // for assert
 #include <vector>    // for vector
 #include <iostream>  // for cerr, endl
+#include <memory>    // for unique_ptr
+
+// OpenMP
+#include <omp.h> // for omp_get_num_threads, omp_get_thread_num
 
 // Eigen
 #include <Eigen/SVD> // for JacobiSVD, etc
@@ -22,8 +26,11 @@
 #include <boost/program_options.hpp> // for validation_error, etc
 
 // Local
+#include "logger.hpp"
 #include "auxiliary.hpp"
 #include "functionals.hpp"
+#include "pipeline.hpp"
+#include "profiler.hpp"
 
 
 //
@@ -101,33 +108,65 @@ Eigen::MatrixXf nearest_orthonormal_sinogram(const Eigen::MatrixXf &input,
     return nos;
 }
 
-std::vector<Eigen::VectorXf>
-getCircusFunctions(const Eigen::MatrixXf &input,
-                   const std::vector<PFunctionalWrapper> &pfunctionals) {
-    // Allocate the output matrices
-    std::vector<Eigen::VectorXf> outputs(pfunctionals.size());
-    for (size_t p = 0; p < pfunctionals.size(); p++)
-        outputs[p] = Eigen::VectorXf(input.cols());
-
-    // Pre-calculate
-    std::map<size_t, void *> precalculations;
+PPrecalculations::PPrecalculations(
+    int rows, const std::vector<PFunctionalWrapper> &pfunctionals)
+    : _rows(rows) {
     for (size_t p = 0; p < pfunctionals.size(); p++) {
         PFunctional pfunctional = pfunctionals[p].functional;
+        _functionals.push_back(pfunctional);
         switch (pfunctional) {
         case PFunctional::P3:
-            precalculations[p] = PFunctional3_prepare(input.rows());
+            _precalculations[p] = PFunctional3_prepare(rows);
+            break;
+        case PFunctional::Hermite:
+        case PFunctional::P1:
+        case PFunctional::P2:
+        default:
+            break;
+        }
+    }
+}
+
+PPrecalculations::~PPrecalculations() {
+    std::map<size_t, void *>::iterator it = _precalculations.begin();
+    while (it != _precalculations.end()) {
+        PFunctional pfunctional = _functionals[it->first];
+        switch (pfunctional) {
+        case PFunctional::P3: {
+            PFunctional3_precalc_t *precalc =
+                (PFunctional3_precalc_t *)it->second;
+            PFunctional3_destroy(precalc);
             break;
+        }
         case PFunctional::Hermite:
         case PFunctional::P1:
         case PFunctional::P2:
         default:
             break;
         }
+        ++it;
     }
+}
+
+bool PPrecalculations::matches(
+    int rows, const std::vector<PFunctionalWrapper> &pfunctionals) const {
+    if (rows != _rows || pfunctionals.size() != _functionals.size())
+        return false;
+    for (size_t p = 0; p < pfunctionals.size(); p++) {
+        if (pfunctionals[p].functional != _functionals[p])
+            return false;
+    }
+    return true;
+}
 
-    // Trace all columns
-    #pragma omp parallel for
-    for (int column = 0; column < input.cols(); column++) {
+// Process the P-functionals without a specialized pipeline, for the columns
+// [first, last) of a sinogram
+static void traceColumns(const Eigen::MatrixXf &input,
+                         const std::vector<PFunctionalWrapper> &pfunctionals,
+                         const std::map<size_t, void *> &precalculations,
+                         std::vector<Eigen::VectorXf> &outputs, int first,
+                         int last) {
+    for (int column = first; column < last; column++) {
         Eigen::VectorXf data = input.col(column);
 
         // Process all P-functionals
@@ -139,10 +178,11 @@ getCircusFunctions(const Eigen::MatrixXf &input,
                 result = PFunctional1(data);
                 break;
             case PFunctional::P2:
-                result = PFunctional2(data);
-                break;
+                continue; // already processed in batch
             case PFunctional::P3:
-                result = PFunctional3(data);
+                result = PFunctional3(
+                    data, (PFunctional3_precalc_t *)precalculations.find(p)
+                              ->second);
                 break;
             case PFunctional::Hermite:
                 result = PFunctionalHermite(data,
@@ -153,25 +193,103 @@ getCircusFunctions(const Eigen::MatrixXf &input,
             outputs[p](column) = result;
         }
     }
+}
 
-    // Destroy pre-calculations
-    std::map<size_t, void *>::iterator it = precalculations.begin();
-    while (it != precalculations.end()) {
-        PFunctional pfunctional = pfunctionals[it->first].functional;
-        switch (pfunctional) {
-        case PFunctional::P3: {
-            PFunctional3_precalc_t *precalc =
-                (PFunctional3_precalc_t *)it->second;
-            PFunctional3_destroy(precalc);
-            break;
+std::vector<Eigen::VectorXf>
+getCircusFunctions(const Eigen::MatrixXf &input,
+                   const std::vector<PFunctionalWrapper> &pfunctionals,
+                   PPrecalculations *plan) {
+    // Allocate the output matrices
+    std::vector<Eigen::VectorXf> outputs(pfunctionals.size());
+    std::unique_ptr<PPrecalculations> local;
+    {
+        PhaseTimer timer(profiler.phase("circus"));
+        for (size_t p = 0; p < pfunctionals.size(); p++)
+            outputs[p] = Eigen::VectorXf(input.cols());
+
+        // Pre-calculate, unless the caller provided usable pre-calculations
+        if (plan == NULL || !plan->matches(input.rows(), pfunctionals)) {
+            local.reset(new PPrecalculations(input.rows(), pfunctionals));
+            plan = local.get();
         }
-        case PFunctional::Hermite:
-        case PFunctional::P1:
-        case PFunctional::P2:
-        default:
-            break;
+    }
+
+    // Register the profiling phases
+    std::vector<int> phases(pfunctionals.size());
+    for (size_t p = 0; p < pfunctionals.size(); p++)
+        phases[p] = profiler.phase(pfunctionals[p].name);
+
+    // Process the P-functionals which handle batches of columns
+    const int batch = 64;
+    for (size_t p = 0; p < pfunctionals.size(); p++) {
+        if (pfunctionals[p].functional == PFunctional::P2) {
+            unsigned int approx_bins = pfunctionals[p].arguments.approx_bins;
+            #pragma omp parallel for
+            for (int first = 0; first < input.cols(); first += batch) {
+                int count = std::min(batch, (int)input.cols() - first);
+                PhaseTimer timer(phases[p], input.rows() * count);
+                PFunctional2_batch(input.middleCols(first, count),
+                                   outputs[p].data() + first, approx_bins);
+            }
+
+            // Compare approximations against the exact result
+            if (approx_bins > 0 && logger.settings.threshold >= debug) {
+                Eigen::VectorXf exact(input.cols());
+                PFunctional2_batch(input, exact.data(), 0);
+                clog(debug) << "Approximate " << pfunctionals[p].name
+                            << " deviates at most "
+                            << relative_error(outputs[p], exact)
+                            << " (relative) from the exact result" << std::endl;
+            }
         }
-        ++it;
+    }
+
+    // Look for a pipeline specialized in the column-wise P-functionals
+    std::vector<size_t> stages;
+    std::vector<PFunctional> stage_functionals;
+    std::vector<PFunctionalWrapper> stage_wrappers;
+    for (size_t p = 0; p < pfunctionals.size(); p++) {
+        if (pfunctionals[p].functional != PFunctional::P2) {
+            stages.push_back(p);
+            stage_functionals.push_back(pfunctionals[p].functional);
+            stage_wrappers.push_back(pfunctionals[p]);
+        }
+    }
+    PPipeline pipeline = findPPipeline(stage_functionals);
+    std::string stage_names;
+    for (size_t i = 0; i < stages.size(); i++)
+        stage_names += (i ? "+" : "") + pfunctionals[stages[i]].name;
+    int phase_columns =
+        profiler.phase(stage_names.empty() ? "columns" : stage_names);
+
+    // Trace all columns, every thread timing its own share of them
+    // NOTE: phases are accounted for per thread, so the elements and hardware
+    //       events of a phase are those of the threads running it
+    std::unique_ptr<PPipelineContext> context;
+    std::vector<float *> stage_outputs(stages.size());
+    if (pipeline != NULL) {
+        PhaseTimer timer(phase_columns);
+        context.reset(new PPipelineContext(input.rows(), stage_wrappers));
+        for (size_t i = 0; i < stages.size(); i++) {
+            stage_outputs[i] = outputs[stages[i]].data();
+            std::map<size_t, void *>::const_iterator it =
+                plan->precalculations().find(stages[i]);
+            if (it != plan->precalculations().end())
+                context->precalcs[i] = (PFunctional3_precalc_t *)it->second;
+        }
+    }
+    #pragma omp parallel
+    {
+        const int threads = omp_get_num_threads();
+        const int thread = omp_get_thread_num();
+        const int first = input.cols() * thread / threads;
+        const int last = input.cols() * (thread + 1) / threads;
+        PhaseTimer timer(phase_columns, input.rows() * (last - first));
+        if (pipeline != NULL)
+            pipeline(input, *context, stage_outputs.data(), first, last);
+        else
+            traceColumns(input, pfunctionals, plan->precalculations(),
+                         outputs, first, last);
     }
 
     return outputs;
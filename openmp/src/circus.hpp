@@ -9,6 +9,7 @@
 // Standard library
 #include <cstddef> // for size_t
 #include <iosfwd>  // for istream
+#include <map>     // for map
 #include <string>  // for string
 #include <vector>
 
@@ -33,12 +34,17 @@ enum class PFunctional {
 
 struct PFunctionalArguments {
     PFunctionalArguments(boost::optional<unsigned int> _order = boost::none,
-                         boost::optional<size_t> _center = boost::none)
-        : order(_order), center(_center) {}
+                         boost::optional<size_t> _center = boost::none,
+                         unsigned int _approx_bins = 0)
+        : order(_order), center(_center), approx_bins(_approx_bins) {}
 
     // Arguments for Hermite P-functional
     boost::optional<unsigned int> order;
     boost::optional<size_t> center;
+
+    // Arguments for P2: amount of histogram bins to approximate the weighted
+    // median with (0 to sort exactly)
+    unsigned int approx_bins;
 };
 
 struct PFunctionalWrapper {
@@ -66,8 +72,34 @@ std::istream &operator>>(std::istream &in, PFunctionalWrapper &wrapper);
 Eigen::MatrixXf nearest_orthonormal_sinogram(const Eigen::MatrixXf &input,
                                              size_t &new_center);
 
+// Pre-calculations of the P-functionals for sinograms of a single height,
+// which can be kept around to transform several images
+class PPrecalculations {
+  public:
+    PPrecalculations(int rows,
+                     const std::vector<PFunctionalWrapper> &pfunctionals);
+    ~PPrecalculations();
+
+    bool matches(int rows,
+                 const std::vector<PFunctionalWrapper> &pfunctionals) const;
+
+    // Pre-calculation of every P-functional which needs one
+    const std::map<size_t, void *> &precalculations() const {
+        return _precalculations;
+    }
+
+  private:
+    PPrecalculations(const PPrecalculations &);
+    PPrecalculations &operator=(const PPrecalculations &);
+
+    int _rows;
+    std::vector<PFunctional> _functionals;
+    std::map<size_t, void *> _precalculations;
+};
+
 std::vector<Eigen::VectorXf>
 getCircusFunctions(const Eigen::MatrixXf &input,
-                   const std::vector<PFunctionalWrapper> &pfunctionals);
+                   const std::vector<PFunctionalWrapper> &pfunctionals,
+                   PPrecalculations *plan = NULL);
 
 #endif
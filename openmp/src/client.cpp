@@ -0,0 +1,141 @@
+//
+// Configuration
+//
+
+// Standard library
+#include <unistd.h>  // for close
+#include <exception> // for exception
+#include <iostream>  // for operator<<, ostream, etc
+#include <string>    // for string
+#include <vector>    // for vector
+
+// Boost
+#include <boost/program_options.hpp>
+#include <boost/filesystem.hpp>
+
+// Local
+#include "logger.hpp"
+#include "auxiliary.hpp"
+#include "protocol.hpp"
+
+
+//
+// Main application
+//
+
+// Transform an image by a running service (see the 'serve' mode of the demo)
+int main(int argc, char **argv) {
+    //
+    // Initialization
+    //
+
+    std::vector<std::string> tfunctionals, pfunctionals;
+    std::string input;
+
+    // Declare named options
+    boost::program_options::options_description desc("Allowed options");
+    desc.add_options()
+        ("help,h",
+            "produce help message")
+        ("socket,s",
+            boost::program_options::value<std::string>()
+                ->default_value("tracetransform.sock"),
+            "socket the service listens on")
+        ("t-functional,T",
+            boost::program_options::value<std::vector<std::string>>(
+                &tfunctionals)->required(),
+            "T-functionals")
+        ("p-functional,P",
+            boost::program_options::value<std::vector<std::string>>(
+                &pfunctionals),
+            "P-functionals")
+        ("angle,a",
+            boost::program_options::value<unsigned int>()
+                ->default_value(1),
+            "angle stepsize")
+        ("output,o",
+            boost::program_options::value<std::string>(),
+            "CSV file to write the signatures to (defaults to the standard "
+            "output)")
+        ("input,i",
+            boost::program_options::value<std::string>(&input)->required(),
+            "image to transform")
+    ;
+
+    // Declare positional options
+    boost::program_options::positional_options_description pod;
+    pod.add("input", 1);
+
+    // Parse the options
+    boost::program_options::variables_map vm;
+    try {
+        store(boost::program_options::command_line_parser(argc, argv)
+                  .options(desc)
+                  .positional(pod)
+                  .run(),
+              vm);
+        if (vm.count("help")) {
+            std::cout << desc << std::endl;
+            return 0;
+        }
+        notify(vm);
+    }
+    catch (const std::exception &e) {
+        std::cerr << "Invalid usage: " << e.what() << std::endl;
+
+        std::cout << desc << std::endl;
+        return 1;
+    }
+
+    if (!boost::filesystem::exists(input)) {
+        clog(error) << "Input file does not exist" << std::endl;
+        return 1;
+    }
+    std::vector<Eigen::MatrixXi> components = readnetpbm(input);
+    if (components.size() != 1) {
+        clog(error) << "Only grayscale images are supported" << std::endl;
+        return 1;
+    }
+
+
+    //
+    // Execution
+    //
+
+    int fd = connectSocket(vm["socket"].as<std::string>());
+    if (fd < 0) {
+        clog(error) << "Could not connect to "
+                    << vm["socket"].as<std::string>() << std::endl;
+        return 1;
+    }
+
+    Eigen::MatrixXf signatures;
+    std::string message;
+    ResponseStatus status = ResponseStatus::Failure;
+    if (sendRequest(fd, components[0], vm["angle"].as<unsigned int>(),
+                    formatSpec(tfunctionals, pfunctionals)))
+        status = receiveResponse(fd, signatures, message);
+    else
+        message = "connection lost";
+    close(fd);
+    if (status != ResponseStatus::OK) {
+        clog(error) << "Request failed: " << message << std::endl;
+        return 1;
+    }
+
+    if (vm.count("output")) {
+        writecsv(vm["output"].as<std::string>(), signatures);
+    } else {
+        for (int row = 0; row < signatures.rows(); row++) {
+            for (int col = 0; col < signatures.cols(); col++) {
+                std::cout << signatures(row, col);
+                if (col < signatures.cols() - 1)
+                    std::cout << ", ";
+            }
+            std::cout << "\n";
+        }
+        std::cout << std::flush;
+    }
+
+    return 0;
+}
@@ -0,0 +1,232 @@
+//
+// Configuration
+//
+
+// Header include
+#include "costmodel.hpp"
+
+// Standard library
+#include <algorithm> // for max, sort
+#include <chrono>    // for steady_clock, duration
+#include <cmath>     // for floor, log2
+#include <sstream>   // for stringstream
+
+// Local
+#include "logger.hpp"
+#include "auxiliary.hpp"
+#include "profiler.hpp"
+#include "synthetic.hpp"
+#include "transform.hpp"
+
+
+//
+// Auxiliary
+//
+
+static double median(std::vector<double> values) {
+    if (values.empty())
+        return 0;
+    std::sort(values.begin(), values.end());
+    size_t n = values.size();
+    return (n % 2) ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+}
+
+// Cost class of a single functional, processed as part of a phase
+static Complexity functionalComplexity(const std::string &name) {
+    if (name == "T6" || name == "T7")
+        return Complexity::ImageSorting;
+    else if (name == "P2" || name == "P3")
+        return Complexity::SinogramSorting;
+    else if (name == "P1" || name[0] == 'H')
+        return Complexity::Sinogram;
+    else
+        return Complexity::Rotation;
+}
+
+
+//
+// Complexity classes
+//
+
+Complexity phaseComplexity(const std::string &phase) {
+    if (phase == "resize" || phase == "pad")
+        return Complexity::Image;
+    else if (phase == "rotate")
+        return Complexity::Rotation;
+    else if (phase == "nos")
+        return Complexity::Decomposition;
+    else if (phase == "circus" || phase == "zscore")
+        return Complexity::Angles;
+    else if (phase == "sinograms" || phase == "output" || phase == "columns")
+        return Complexity::Sinogram;
+
+    // Column-wise phases process several functionals at once, and are
+    // dominated by the most expensive one
+    Complexity complexity = Complexity::Angles;
+    std::stringstream names(phase);
+    std::string name;
+    while (std::getline(names, name, '+')) {
+        if (!name.empty())
+            complexity = std::max(complexity, functionalComplexity(name));
+    }
+    return complexity;
+}
+
+const char *complexityName(Complexity complexity) {
+    switch (complexity) {
+    case Complexity::Angles:
+        return "A";
+    case Complexity::Image:
+        return "N^2";
+    case Complexity::Sinogram:
+        return "N*A";
+    case Complexity::SinogramSorting:
+        return "N*log(N)*A";
+    case Complexity::Rotation:
+        return "N^2*A";
+    case Complexity::ImageSorting:
+        return "N^2*log(N)*A";
+    case Complexity::Decomposition:
+        return "N*A^2";
+    }
+    return "unknown";
+}
+
+double complexityCost(Complexity complexity, double n, double a) {
+    switch (complexity) {
+    case Complexity::Angles:
+        return a;
+    case Complexity::Image:
+        return n * n;
+    case Complexity::Sinogram:
+        return n * a;
+    case Complexity::SinogramSorting:
+        return n * std::log2(n) * a;
+    case Complexity::Rotation:
+        return n * n * a;
+    case Complexity::ImageSorting:
+        return n * n * std::log2(n) * a;
+    case Complexity::Decomposition:
+        return n * a * a;
+    }
+    return 0;
+}
+
+
+//
+// Cost model
+//
+
+CostModel::CostModel() : _elapsed(0), _phases(0) {}
+
+void CostModel::sample(const std::string &phase, int n, int a,
+                       double seconds) {
+    if (_fits.count(phase) == 0) {
+        Fit fit;
+        fit.complexity = phaseComplexity(phase);
+        fit.products = fit.squares = 0;
+        _fits[phase] = fit;
+        _order.push_back(phase);
+    }
+
+    Fit &fit = _fits[phase];
+    double cost = complexityCost(fit.complexity, n, a);
+    fit.products += seconds * cost;
+    fit.squares += cost * cost;
+}
+
+void CostModel::sampleTotal(double phases, double elapsed) {
+    _phases += phases;
+    _elapsed += elapsed;
+}
+
+std::vector<PhasePrediction> CostModel::predict(int n, int a) const {
+    std::vector<PhasePrediction> predictions;
+    for (size_t i = 0; i < _order.size(); i++) {
+        const Fit &fit = _fits.find(_order[i])->second;
+        PhasePrediction prediction;
+        prediction.name = _order[i];
+        prediction.complexity = fit.complexity;
+        prediction.time = (fit.squares > 0)
+                              ? fit.products / fit.squares *
+                                    complexityCost(fit.complexity, n, a)
+                              : 0;
+        predictions.push_back(prediction);
+    }
+    return predictions;
+}
+
+double CostModel::predictTotal(int n, int a) const {
+    std::vector<PhasePrediction> predictions = predict(n, a);
+    double total = 0;
+    for (size_t i = 0; i < predictions.size(); i++)
+        total += predictions[i].time;
+    return (_phases > 0) ? total * _elapsed / _phases : total;
+}
+
+
+//
+// Calibration
+//
+
+CostModel
+calibrateCostModel(unsigned int angle_stepsize, bool orthonormal,
+                   const std::vector<TFunctionalWrapper> &tfunctionals,
+                   std::vector<PFunctionalWrapper> &pfunctionals,
+                   unsigned int iterations) {
+    // Images doubling in size, for the fit to be dominated by the largest
+    // ones (which resemble real inputs best), up to where a single transform
+    // takes long enough for the calibration to be a noticeable part of a job
+    const int min_size = 64, max_size = 512;
+    const double max_time = 0.5;
+    int a_steps = (int)std::floor(360 / angle_stepsize);
+
+    CostModel model;
+    bool enabled = profiler.settings.enabled;
+    profiler.settings.enabled = true;
+    for (int size = min_size; size <= max_size; size *= 2) {
+        Eigen::MatrixXf image =
+            gray2mat(generateImage(SyntheticPattern::Noise, size, size));
+        int n = Transformer::paddedSize(size, size, angle_stepsize,
+                                        orthonormal);
+
+        // Warm-up
+        {
+            Transformer transformer(image, "calibration", angle_stepsize,
+                                    orthonormal);
+            transformer.getTransform(tfunctionals, pfunctionals, false);
+        }
+        profiler.reset();
+
+        std::vector<double> times;
+        for (unsigned int i = 0; i < iterations; i++) {
+            std::chrono::steady_clock::time_point start =
+                std::chrono::steady_clock::now();
+            Transformer transformer(image, "calibration", angle_stepsize,
+                                    orthonormal);
+            transformer.getTransform(tfunctionals, pfunctionals, false);
+            times.push_back(std::chrono::duration<double>(
+                                std::chrono::steady_clock::now() - start)
+                                .count());
+            profiler.collect();
+        }
+
+        double phases = 0;
+        std::vector<PhaseStatistics> statistics = profiler.statistics();
+        for (size_t i = 0; i < statistics.size(); i++) {
+            model.sample(statistics[i].name, n, a_steps,
+                         statistics[i].median);
+            phases += statistics[i].median;
+        }
+        model.sampleTotal(phases, median(times));
+        clog(debug) << "Calibrated on a " << size << "x" << size
+                    << " image (padded to " << n << "): " << median(times)
+                    << " s" << std::endl;
+        if (median(times) > max_time)
+            break;
+    }
+    profiler.reset();
+    profiler.settings.enabled = enabled;
+
+    return model;
+}
@@ -0,0 +1,86 @@
+//
+// Configuration
+//
+
+// Include guard
+#ifndef _TRACETRANSFORM_COSTMODEL_
+#define _TRACETRANSFORM_COSTMODEL_
+
+// Standard library
+#include <map>    // for map
+#include <string> // for string
+#include <vector> // for vector
+
+// Local
+#include "sinogram.hpp"
+#include "circus.hpp"
+
+
+//
+// Module definitions
+//
+
+// Asymptotic cost of a phase, in terms of the size of the padded image (N)
+// and the amount of angles (A)
+enum class Complexity {
+    Angles,          // A
+    Image,           // N^2
+    Sinogram,        // N*A
+    SinogramSorting, // N*log(N)*A
+    Rotation,        // N^2*A
+    ImageSorting,    // N^2*log(N)*A
+    Decomposition    // N*A^2
+};
+
+// Cost class of a profiling phase, based on its name
+Complexity phaseComplexity(const std::string &phase);
+
+const char *complexityName(Complexity complexity);
+
+double complexityCost(Complexity complexity, double n, double a);
+
+// Predicted duration of a phase (in seconds)
+struct PhasePrediction {
+    std::string name;
+    Complexity complexity;
+    double time;
+};
+
+// Cost model of a transform, with a coefficient per phase fitted to the
+// measurements of a calibration
+class CostModel {
+  public:
+    CostModel();
+
+    // Account the (median) time of a phase measured at a given problem size
+    void sample(const std::string &phase, int n, int a, double seconds);
+
+    // Account the elapsed time of a transform, which differs from the sum of
+    // its phases because of parallelism and untimed work
+    void sampleTotal(double phases, double elapsed);
+
+    // Predict the duration of every phase, and of the transform as a whole
+    std::vector<PhasePrediction> predict(int n, int a) const;
+    double predictTotal(int n, int a) const;
+
+  private:
+    // Least-squares fit through the origin: coefficient = sum(t*f) / sum(f^2)
+    struct Fit {
+        Complexity complexity;
+        double products, squares;
+    };
+    std::map<std::string, Fit> _fits;
+    std::vector<std::string> _order;
+
+    // Ratio of the elapsed time to the sum of the phases
+    double _elapsed, _phases;
+};
+
+// Calibrate a cost model by transforming synthetic images of growing size
+CostModel
+calibrateCostModel(unsigned int angle_stepsize, bool orthonormal,
+                   const std::vector<TFunctionalWrapper> &tfunctionals,
+                   std::vector<PFunctionalWrapper> &pfunctionals,
+                   unsigned int iterations);
+
+#endif
@@ -3,10 +3,19 @@
 //
 
 // Standard library
+#include <sched.h>   // for sched_setaffinity, cpu_set_t, etc
+#include <omp.h>     // for omp_set_num_threads, omp_get_max_threads, etc
+#include <algorithm> // for sort
+#include <cctype>    // for toupper
 #include <chrono>    // for microseconds, time_point, etc
+#include <cmath>     // for sqrt, pow
 #include <cstddef>   // for size_t
+#include <iomanip>   // for setw, setprecision
 #include <exception> // for exception
+#include <fstream>   // for ifstream, ofstream
 #include <iostream>  // for operator<<, ostream, etc
+#include <memory>    // for unique_ptr
+#include <sstream>   // for stringstream
 #include <string>    // for operator+, string, etc
 #include <vector>    // for vector
 
@@ -20,7 +29,17 @@
 #include "logger.hpp"
 #include "auxiliary.hpp"
 #include "transform.hpp"
+#include "batch.hpp"
+#include "dense.hpp"
+#include "tiles.hpp"
 #include "progress.hpp"
+#include "profiler.hpp"
+#include "memory.hpp"
+#include "report.hpp"
+#include "synthetic.hpp"
+#include "costmodel.hpp"
+#include "cache.hpp"
+#include "service.hpp"
 
 
 //
@@ -30,7 +49,10 @@
 enum class ProgramMode {
     CALCULATE,
     PROFILE,
-    BENCHMARK
+    BENCHMARK,
+    SCALING,
+    ESTIMATE,
+    SERVE
 };
 
 std::istream &operator>>(std::istream &in, ProgramMode &mode) {
@@ -42,6 +64,12 @@ std::istream &operator>>(std::istream &in, ProgramMode &mode) {
         mode = ProgramMode::PROFILE;
     } else if (name == "benchmark") {
         mode = ProgramMode::BENCHMARK;
+    } else if (name == "scaling") {
+        mode = ProgramMode::SCALING;
+    } else if (name == "estimate") {
+        mode = ProgramMode::ESTIMATE;
+    } else if (name == "serve") {
+        mode = ProgramMode::SERVE;
     } else {
         throw boost::program_options::validation_error(
             boost::program_options::validation_error::invalid_option_value);
@@ -49,6 +77,241 @@ std::istream &operator>>(std::istream &in, ProgramMode &mode) {
     return in;
 }
 
+// Amount of bytes, optionally suffixed with a binary unit (K, M, G or T)
+struct ByteSize {
+    size_t bytes;
+};
+
+std::istream &operator>>(std::istream &in, ByteSize &size) {
+    double value;
+    std::string unit;
+    in >> value >> unit;
+    if (in.fail() && !in.eof())
+        throw boost::program_options::validation_error(
+            boost::program_options::validation_error::invalid_option_value);
+    in.clear(std::ios::eofbit);
+
+    const std::string units = "KMGT";
+    double factor = 1;
+    if (!unit.empty()) {
+        size_t index = units.find(toupper(unit[0]));
+        if (index == std::string::npos ||
+            (unit.size() > 1 && unit.substr(1) != "B" &&
+             unit.substr(1) != "iB"))
+            throw boost::program_options::validation_error(
+                boost::program_options::validation_error::
+                    invalid_option_value);
+        factor = std::pow(1024.0, index + 1);
+    }
+    size.bytes = (value > 0) ? value * factor : 0;
+    if (size.bytes == 0)
+        throw boost::program_options::validation_error(
+            boost::program_options::validation_error::invalid_option_value);
+    return in;
+}
+
+// Amounts of threads to scale over: powers of two, up to and including the
+// maximal amount
+std::vector<int> threadCounts(int max_threads) {
+    std::vector<int> counts;
+    for (int threads = 1; threads < max_threads; threads *= 2)
+        counts.push_back(threads);
+    counts.push_back(max_threads);
+    return counts;
+}
+
+// CPUs the process is allowed to run on
+std::vector<int> availableCpus() {
+    std::vector<int> cpus;
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &set))
+                cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+// Bind every thread of the OpenMP team to a separate CPU
+void pinThreads(const std::vector<int> &cpus) {
+    if (cpus.empty())
+        return;
+    #pragma omp parallel
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpus[omp_get_thread_num() % cpus.size()], &set);
+        if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+            #pragma omp critical (pinning)
+            clog(warning) << "Could not pin thread " << omp_get_thread_num()
+                          << std::endl;
+        }
+    }
+}
+
+// Allow every thread of the OpenMP team to run on the given CPUs again
+void unpinThreads(const cpu_set_t &affinity) {
+    #pragma omp parallel
+    sched_setaffinity(0, sizeof(affinity), &affinity);
+}
+
+// Index of the first component every component is identical to (which is the
+// component itself if it differs from all preceding ones)
+std::vector<size_t>
+findIdenticalComponents(const std::vector<Eigen::MatrixXi> &components) {
+    std::vector<size_t> sources(components.size());
+    for (size_t i = 0; i < components.size(); i++) {
+        sources[i] = i;
+        for (size_t j = 0; j < i; j++) {
+            if (sources[j] == j &&
+                components[j].rows() == components[i].rows() &&
+                components[j].cols() == components[i].cols() &&
+                components[j] == components[i]) {
+                sources[i] = j;
+                break;
+            }
+        }
+    }
+    return sources;
+}
+
+// Small images waiting to be transformed together, with the basenames each of
+// them gets written to (several ones for identical channels)
+struct PendingBatch {
+    std::vector<Eigen::MatrixXf> images;
+    std::vector<std::vector<std::string>> names;
+};
+
+void flushBatch(PendingBatch &batch, unsigned int angle_stepsize,
+                const std::vector<TFunctionalWrapper> &tfunctionals,
+                const std::vector<PFunctionalWrapper> &pfunctionals) {
+    if (batch.images.empty())
+        return;
+    std::vector<std::string> basenames;
+    for (size_t i = 0; i < batch.names.size(); i++)
+        basenames.push_back(batch.names[i][0]);
+    BatchTransformer transformer(batch.images, basenames, angle_stepsize);
+    std::vector<Eigen::MatrixXf> signatures =
+        transformer.getTransform(tfunctionals, pfunctionals, true);
+    for (size_t i = 0; i < batch.names.size(); i++) {
+        for (size_t j = 1; j < batch.names[i].size(); j++) {
+            if (!pfunctionals.empty())
+                writecsv(batch.names[i][j] + ".csv", signatures[i]);
+        }
+    }
+    batch.images.clear();
+    batch.names.clear();
+}
+
+// Transform an image which doesn't fit in memory, streaming every channel
+// from a tiled store in a scratch directory
+void streamImage(const std::string &filename, const std::string &basename,
+                 const std::string &scratch, unsigned int angle_stepsize,
+                 bool orthonormal, size_t budget,
+                 const std::vector<TFunctionalWrapper> &tfunctionals,
+                 std::vector<PFunctionalWrapper> &pfunctionals) {
+    std::vector<std::unique_ptr<TiledImage>> channels;
+    {
+        PhaseTimer timer(profiler.phase("input"));
+        channels = readTiledNetpbm(filename, scratch);
+    }
+
+    std::vector<std::string> names(channels.size(), basename);
+    for (size_t i = 0; i < channels.size(); i++) {
+        const std::string &name = names[i];
+        if (channels.size() > 1)
+            names[i] += "_c" + boost::lexical_cast<std::string>(i + 1);
+        TraceSpan span(profiler.phase("image"),
+                       tracer.settings.enabled ? tracer.label(name) : -1);
+
+        // Channels identical to an earlier one share its signatures
+        size_t source = i;
+        {
+            PhaseTimer timer(profiler.phase("input"));
+            for (size_t j = 0; j < i && source == i; j++) {
+                if (channels[j]->identical(*channels[i]))
+                    source = j;
+            }
+        }
+        if (source != i) {
+            clog(debug) << name << " is identical to channel " << source + 1
+                        << std::endl;
+            if (!pfunctionals.empty()) {
+                std::ifstream in(names[source] + ".csv");
+                std::ofstream out(name + ".csv");
+                out << in.rdbuf();
+            }
+            continue;
+        }
+
+        // NOTE: the budget includes what has been allocated already, and
+        //       being exceeded leaves a single angle per batch
+        size_t remaining = 0;
+        if (budget > 0)
+            remaining = std::max<size_t>(budget - std::min(budget, heapUsage()),
+                                         1);
+        Transformer transformer(*channels[i], name, angle_stepsize,
+                                orthonormal, remaining);
+        transformer.getTransform(tfunctionals, pfunctionals);
+    }
+}
+
+// Print the predicted duration of every phase of a transform, and of the
+// transform as a whole
+void printEstimate(const CostModel &model, const std::string &name,
+                   size_t rows, size_t cols, unsigned int angle_stepsize,
+                   bool orthonormal, size_t estimate, bool over_budget) {
+    int n = Transformer::paddedSize(rows, cols, angle_stepsize, orthonormal);
+    int a_steps = (int)std::floor(360 / angle_stepsize);
+    std::vector<PhasePrediction> predictions = model.predict(n, a_steps);
+    std::stringstream table;
+    table << std::left << std::setw(16) << "phase" << std::setw(16)
+          << "complexity" << std::right << std::setw(12) << "time" << "\n"
+          << std::fixed << std::setprecision(6);
+    for (size_t p = 0; p < predictions.size(); p++)
+        table << std::left << std::setw(16) << predictions[p].name
+              << std::setw(16) << complexityName(predictions[p].complexity)
+              << std::right << std::setw(12) << predictions[p].time << "\n";
+    clog(debug) << table.str() << std::flush;
+
+    clog(info) << name << " (" << rows << "x" << cols << ", padded to " << n
+               << "): " << model.predictTotal(n, a_steps) << " s, "
+               << formatBytes(estimate)
+               << (over_budget ? " (exceeds the memory budget)" : "")
+               << std::endl;
+}
+
+// Median time (in seconds) to transform an image, after a warm-up run
+double timeTransform(const Transformer &transformer,
+                     const std::vector<TFunctionalWrapper> &tfunctionals,
+                     std::vector<PFunctionalWrapper> &pfunctionals,
+                     unsigned int iterations) {
+    transformer.getTransform(tfunctionals, pfunctionals, false);
+    profiler.reset();
+
+    std::vector<double> times;
+    for (unsigned int n = 0; n < iterations; n++) {
+        std::chrono::time_point<std::chrono::high_resolution_clock> last =
+            std::chrono::high_resolution_clock::now();
+        transformer.getTransform(tfunctionals, pfunctionals, false);
+        std::chrono::time_point<std::chrono::high_resolution_clock> current =
+            std::chrono::high_resolution_clock::now();
+        profiler.collect();
+
+        times.push_back(
+            std::chrono::duration_cast<std::chrono::microseconds>(current -
+                                                                  last)
+                .count() /
+            1000000.0);
+    }
+
+    std::sort(times.begin(), times.end());
+    return (iterations % 2) ? times[iterations / 2]
+                            : (times[iterations / 2 - 1] +
+                               times[iterations / 2]) / 2;
+}
+
 int main(int argc, char **argv) {
     //
     // Initialization
@@ -77,8 +340,7 @@ int main(int argc, char **argv) {
             "display even more details")
         ("t-functional,T",
             boost::program_options::value<
-                    std::vector<TFunctionalWrapper>>(&tfunctionals)
-                ->required(),
+                    std::vector<TFunctionalWrapper>>(&tfunctionals),
             "T-functionals")
         ("p-functional,P",
             boost::program_options::value<
@@ -88,17 +350,102 @@ int main(int argc, char **argv) {
             boost::program_options::value<unsigned int>()
                 ->default_value(1),
             "angle stepsize")
+        ("fft-threshold",
+            boost::program_options::value<unsigned int>(),
+            "padded image size from which on T3-T5 use FFT correlations "
+            "(0 to disable)")
+        ("approx-quantiles",
+            boost::program_options::value<unsigned int>(),
+            "approximate the weighted medians of T6, T7 and P2 using "
+            "histograms with the given amount of bins")
+        ("incremental-t6",
+            "repair the T6 permutations of the previous angle instead of "
+            "sorting from scratch")
+        ("batch",
+            "transform small images in batches of images of the same size, "
+            "rather than one by one (which rounds the signatures "
+            "differently)")
+        ("out-of-core",
+            "stream the input images from tiles on disk rather than loading "
+            "them (the default for images exceeding the memory budget)")
+        ("dense",
+            boost::program_options::value<WindowSpec>(),
+            "calculate the signatures of every window sliding over the "
+            "images, given as <size>[:<stride>] (e.g. 128:16), rather than "
+            "those of the images as a whole")
+        ("approx-dense",
+            "trace the dense windows in the rotations of the image as a whole "
+            "rather than one by one, which is much faster but only supports "
+            "the Radon, T1 and T2 functionals and changes the signatures "
+            "(reporting by how much for the first window)")
+        ("scratch",
+            boost::program_options::value<std::string>(),
+            "directory to store the tiles of streamed images in (defaults to "
+            "the temporary directory)")
         ("mode,m",
             boost::program_options::value<ProgramMode>(&mode)
                 ->required(),
-            "execution mode ('calculate', 'profile' or 'benchmark')")
+            "execution mode ('calculate', 'profile', 'benchmark', 'scaling', "
+            "'estimate' or 'serve')")
         ("iterations,n",
             boost::program_options::value<unsigned int>(),
             "amount of iterations to run")
+        ("threads",
+            boost::program_options::value<int>(),
+            "maximal amount of threads to scale to (defaults to the OpenMP "
+            "maximum)")
+        ("pin",
+            "pin every thread to a separate CPU while scaling")
+        ("counters",
+            "measure hardware events per phase and thread while profiling")
+        ("trace",
+            boost::program_options::value<std::string>(),
+            "write a timeline of the execution to the given file (in the "
+            "Chrome trace event format)")
+        ("report",
+            boost::program_options::value<std::string>(),
+            "write a JSON report of the benchmark to the given file")
+        ("memory-budget",
+            boost::program_options::value<ByteSize>(),
+            "stream images which are estimated to need more memory than the "
+            "given amount (e.g. 512M or 4G) from tiles on disk when "
+            "calculating, and refuse to process them otherwise")
+        ("socket",
+            boost::program_options::value<std::string>()
+                ->default_value("tracetransform.sock"),
+            "socket to serve transforms on")
+        ("shm",
+            boost::program_options::value<std::string>(),
+            "serve transforms on a shared memory ring of the given name "
+            "(e.g. /tracetransform) instead of a socket")
+        ("slots",
+            boost::program_options::value<size_t>()->default_value(8),
+            "amount of images the shared memory ring can hold")
+        ("slot-size",
+            boost::program_options::value<ByteSize>(),
+            "capacity of every slot of the shared memory ring (defaults to "
+            "16M)")
+        ("workers",
+            boost::program_options::value<unsigned int>()
+                ->default_value(1),
+            "amount of requests to serve concurrently, each with a share of "
+            "the threads")
+        ("queue",
+            boost::program_options::value<size_t>()->default_value(16),
+            "amount of connections which can wait for a worker before "
+            "turning new ones away")
+        ("cache",
+            boost::program_options::value<std::string>(),
+            "directory to cache signatures and sinograms in, so repeated "
+            "inputs needn't be transformed again, and only the P-functionals "
+            "need to be calculated when changing those")
+        ("cache-size",
+            boost::program_options::value<ByteSize>(),
+            "amount of disk space the cache may take (defaults to 1G)")
         ("inputs,i",
-            boost::program_options::value<std::vector<std::string>>(&inputs)
-                ->required(),
-            "images to process")
+            boost::program_options::value<std::vector<std::string>>(&inputs),
+            "images to process, or synthetic inputs specified as "
+            "gen:<noise|disc|gradient|blobs>:<size>[-<max size>][:<seed>]")
     ;
 
     // Declare positional options
@@ -130,6 +477,18 @@ int main(int argc, char **argv) {
     // Notify the user of errors
     try {
         notify(vm);
+
+        // Services receive their images and functionals from the clients
+        if (mode != ProgramMode::SERVE) {
+            if (!vm.count("t-functional"))
+                throw boost::program_options::required_option("t-functional");
+            if (!vm.count("inputs"))
+                throw boost::program_options::required_option("inputs");
+        }
+        if (vm.count("iterations") && vm["iterations"].as<unsigned int>() == 0)
+            throw boost::program_options::validation_error(
+                boost::program_options::validation_error::invalid_option_value,
+                "iterations");
     }
     catch (const std::exception &e) {
         std::cerr << "Invalid usage: " << e.what() << std::endl;
@@ -147,9 +506,38 @@ int main(int argc, char **argv) {
         logger.settings.threshold = debug;
     else if (vm.count("quiet"))
         logger.settings.threshold = warning;
+    logger.start();
     bool showProgress =
         (mode == ProgramMode::CALCULATE && logger.settings.threshold == info);
 
+    // Account the heap usage when something is going to report or limit it
+    if (vm.count("memory-budget") || mode == ProgramMode::PROFILE ||
+        mode == ProgramMode::BENCHMARK || mode == ProgramMode::SCALING ||
+        mode == ProgramMode::ESTIMATE)
+        trackMemory();
+
+    // Configure the functionals
+    if (vm.count("fft-threshold")) {
+        for (size_t t = 0; t < tfunctionals.size(); t++)
+            tfunctionals[t].arguments.fft_threshold =
+                vm["fft-threshold"].as<unsigned int>();
+    }
+    if (vm.count("incremental-t6")) {
+        for (size_t t = 0; t < tfunctionals.size(); t++)
+            tfunctionals[t].arguments.incremental = true;
+    }
+    if (vm.count("approx-quantiles")) {
+        unsigned int bins = vm["approx-quantiles"].as<unsigned int>();
+        for (size_t t = 0; t < tfunctionals.size(); t++)
+            tfunctionals[t].arguments.approx_bins = bins;
+        for (size_t p = 0; p < pfunctionals.size(); p++)
+            pfunctionals[p].arguments.approx_bins = bins;
+    }
+
+    // Configure tracing
+    if (vm.count("trace"))
+        tracer.settings.enabled = true;
+
     // Check for orthonormal P-functionals
     unsigned int orthonormal_count = 0;
     bool orthonormal;
@@ -168,57 +556,440 @@ int main(int argc, char **argv) {
             "pfunctionals");
     }
 
+    // Check whether the dense transform supports the functionals
+    bool dense = (vm.count("dense") > 0);
+    bool approximate_dense = (vm.count("approx-dense") > 0);
+    if ((dense && mode != ProgramMode::CALCULATE) ||
+        (approximate_dense && !dense)) {
+        clog(error) << "Dense windows can only be calculated" << std::endl;
+        throw boost::program_options::validation_error(
+            boost::program_options::validation_error::invalid_option_value,
+            "dense");
+    }
+    if (approximate_dense &&
+        !DenseTransformer::supports(tfunctionals, pfunctionals)) {
+        clog(error) << "Approximate dense windows can only be calculated with "
+                       "the Radon, T1 and T2 functionals, and regular "
+                       "P-functionals"
+                    << std::endl;
+        throw boost::program_options::validation_error(
+            boost::program_options::validation_error::invalid_option_value,
+            "approx-dense");
+    }
+
 
     //
     // Execution
     //
 
+    std::vector<BenchmarkRecord> records;
+    int max_threads = omp_get_max_threads();
+    if (vm.count("threads"))
+        max_threads = std::max(vm["threads"].as<int>(), 1);
+    std::vector<int> cpus = availableCpus();
+
+    std::unique_ptr<MatrixCache> cache;
+    if (vm.count("cache"))
+        cache.reset(new MatrixCache(
+            vm["cache"].as<std::string>(),
+            vm.count("cache-size") ? vm["cache-size"].as<ByteSize>().bytes
+                                   : (size_t)1 << 30));
+
+    // Transform the images sent over a socket, rather than the inputs
+    if (mode == ProgramMode::SERVE) {
+        ServiceSettings settings;
+        settings.socket = vm["socket"].as<std::string>();
+        settings.workers = std::max(vm["workers"].as<unsigned int>(), 1u);
+        settings.queue = std::max<size_t>(vm["queue"].as<size_t>(), 1);
+        settings.threads = std::max(max_threads / (int)settings.workers, 1);
+        if (vm.count("fft-threshold"))
+            settings.targuments.fft_threshold =
+                vm["fft-threshold"].as<unsigned int>();
+        if (vm.count("approx-quantiles"))
+            settings.targuments.approx_bins = settings.parguments.approx_bins =
+                vm["approx-quantiles"].as<unsigned int>();
+        settings.targuments.incremental = (vm.count("incremental-t6") > 0);
+
+        if (vm.count("shm")) {
+            settings.ring = vm["shm"].as<std::string>();
+            settings.slots = std::max<size_t>(vm["slots"].as<size_t>(), 1);
+            if (vm.count("slot-size"))
+                settings.slot_size = vm["slot-size"].as<ByteSize>().bytes;
+        }
+
+        settings.cache = cache.get();
+
+        TransformService service(settings);
+        if (vm.count("shm"))
+            return service.runRing() ? 0 : 1;
+        return service.run() ? 0 : 1;
+    }
+
+    // Fit the cost model to small synthetic images, rather than transforming
+    // the actual inputs
+    CostModel model;
+    if (mode == ProgramMode::ESTIMATE) {
+        clog(debug) << "Calibrating the cost model" << std::endl;
+        model = calibrateCostModel(
+            vm["angle"].as<unsigned int>(), orthonormal, tfunctionals,
+            pfunctionals,
+            vm.count("iterations") ? vm["iterations"].as<unsigned int>() : 3);
+    }
+
+    // Small images get transformed in batches if requested, when calculating
+    // signatures with functionals the batched engine supports
+    bool batching = (mode == ProgramMode::CALCULATE && !cache && !dense &&
+                     vm.count("batch"));
+    PendingBatch batch;
+
     Progress indicator(inputs.size());
     if (showProgress)
         indicator.start();
     BOOST_FOREACH(const std::string & input, inputs) {
-        // Get the image basename
-        boost::filesystem::path path(input);
-        if (!exists(path)) {
-            clog(error) << "Input file does not exist" << std::endl;
-            throw boost::program_options::validation_error(
-                boost::program_options::validation_error::invalid_option_value,
-                "inputs", input);
-        }
-        std::string basename = path.stem().string();
-
-        // Load image components according to their type
         std::vector<Eigen::MatrixXi> components;
-        if (boost::iequals(path.extension().string(), ".pgm") ||
-            boost::iequals(path.extension().string(), ".ppm")) {
-            components = readnetpbm(input);
+        std::vector<std::string> component_names;
+        if (isSyntheticInput(input)) {
+            // Generate the synthetic images, one per size
+            SyntheticInput synthetic = parseSyntheticInput(input);
+            BOOST_FOREACH(int size, synthetic.sizes) {
+                components.push_back(
+                    generateImage(synthetic.pattern, size, synthetic.seed));
+                component_names.push_back(
+                    synthetic.name + "_" +
+                    boost::lexical_cast<std::string>(size));
+            }
         } else {
-            clog(error) << "Unrecognized input file format" << std::endl;
-            throw boost::program_options::validation_error(
-                boost::program_options::validation_error::invalid_option_value,
-                "inputs", input);
+            // Get the image basename
+            boost::filesystem::path path(input);
+            if (!exists(path)) {
+                clog(error) << "Input file does not exist" << std::endl;
+                throw boost::program_options::validation_error(
+                    boost::program_options::validation_error::
+                        invalid_option_value,
+                    "inputs", input);
+            }
+            std::string basename = path.stem().string();
+
+            // Load image components according to their type
+            if (boost::iequals(path.extension().string(), ".pgm") ||
+                boost::iequals(path.extension().string(), ".ppm")) {
+                // Predictions only need the size of the image
+                if (mode == ProgramMode::ESTIMATE) {
+                    size_t rows, cols, channels;
+                    readNetpbmHeader(input, rows, cols, channels);
+                    size_t estimate =
+                        heapUsage() +
+                        Transformer::estimateMemory(
+                            rows, cols, vm["angle"].as<unsigned int>(),
+                            orthonormal, tfunctionals, pfunctionals,
+                            max_threads);
+                    bool over_budget =
+                        vm.count("memory-budget") &&
+                        estimate > vm["memory-budget"].as<ByteSize>().bytes;
+                    for (size_t i = 0; i < channels; i++) {
+                        std::string name = basename;
+                        if (channels > 1)
+                            name += "_c" +
+                                    boost::lexical_cast<std::string>(i + 1);
+                        printEstimate(model, name, rows, cols,
+                                      vm["angle"].as<unsigned int>(),
+                                      orthonormal, estimate, over_budget);
+                    }
+                    continue;
+                }
+
+                // Stream images which would exceed the memory budget,
+                // including the text of the file and the pixels read from it
+                if (mode == ProgramMode::CALCULATE && !dense &&
+                    (vm.count("memory-budget") || vm.count("out-of-core"))) {
+                    size_t rows, cols, channels;
+                    readNetpbmHeader(input, rows, cols, channels);
+                    size_t estimate =
+                        heapUsage() + file_size(path) +
+                        channels * (rows * cols * sizeof(int) +
+                                    Transformer::estimateMemory(
+                                        rows, cols,
+                                        vm["angle"].as<unsigned int>(),
+                                        orthonormal, tfunctionals,
+                                        pfunctionals, max_threads));
+                    size_t budget =
+                        vm.count("memory-budget")
+                            ? vm["memory-budget"].as<ByteSize>().bytes
+                            : 0;
+                    if (vm.count("out-of-core") ||
+                        (budget > 0 && estimate > budget)) {
+                        clog(debug) << "Streaming " << basename << " ("
+                                    << rows << "x" << cols << ", estimated "
+                                    << formatBytes(estimate)
+                                    << " in memory)" << std::endl;
+                        std::string scratch =
+                            vm.count("scratch")
+                                ? vm["scratch"].as<std::string>()
+                                : boost::filesystem::temp_directory_path()
+                                      .string();
+                        streamImage(input, basename, scratch,
+                                    vm["angle"].as<unsigned int>(),
+                                    orthonormal, budget, tfunctionals,
+                                    pfunctionals);
+                        if (showProgress)
+                            ++indicator;
+                        continue;
+                    }
+                }
+
+                PhaseTimer timer(profiler.phase("input"));
+                components = readnetpbm(input);
+            } else {
+                clog(error) << "Unrecognized input file format" << std::endl;
+                throw boost::program_options::validation_error(
+                    boost::program_options::validation_error::
+                        invalid_option_value,
+                    "inputs", input);
+            }
+
+            // Generate local basenames
+            for (size_t i = 0; i < components.size(); i++) {
+                if (components.size() == 1)
+                    component_names.push_back(basename);
+                else
+                    component_names.push_back(
+                        basename + "_c" +
+                        boost::lexical_cast<std::string>(i + 1));
+            }
         }
 
-        int i = 0;
-        BOOST_FOREACH(const auto & component, components) {
-            // Generate a local basename
-            i++;
-            std::string component_name;
-            if (components.size() == 1)
-                component_name = basename;
-            else
-                component_name =
-                    basename + "_c" + boost::lexical_cast<std::string>(i);
+        // Many colour images are grayscale in disguise, with every channel
+        // identical, in which case only the first one needs transforming
+        std::vector<size_t> sources;
+        {
+            PhaseTimer timer(profiler.phase("input"));
+            sources = findIdenticalComponents(components);
+        }
+        std::vector<Eigen::MatrixXf> signatures(components.size());
+        std::vector<bool> batched(components.size(), false);
+
+        // Sinograms of channels which got calculated along with an earlier
+        // one of the same image
+        std::vector<std::vector<Eigen::MatrixXf>> pending(components.size());
+        std::vector<bool> precalculated(components.size(), false);
+
+        for (size_t i = 0; i < components.size(); i++) {
+            const Eigen::MatrixXi &component = components[i];
+            const std::string &component_name = component_names[i];
+            TraceSpan span(profiler.phase("image"),
+                           tracer.settings.enabled
+                               ? tracer.label(component_name)
+                               : -1);
+
+            if (mode == ProgramMode::CALCULATE && sources[i] != i) {
+                clog(debug) << component_name << " is identical to "
+                            << component_names[sources[i]] << std::endl;
+                if (!pfunctionals.empty() && !batched[sources[i]])
+                    writecsv(component_name + ".csv", signatures[sources[i]]);
+                continue;
+            }
+
+            // Transform the windows sliding over the image
+            if (dense) {
+                WindowSpec windows = vm["dense"].as<WindowSpec>();
+                if (component.rows() < windows.size ||
+                    component.cols() < windows.size) {
+                    clog(error) << component_name << " ("
+                                << component.rows() << "x" << component.cols()
+                                << ") is smaller than the windows"
+                                << std::endl;
+                    return 1;
+                }
+                DenseTransformer transformer(gray2mat(component),
+                                             component_name,
+                                             vm["angle"].as<unsigned int>(),
+                                             orthonormal, windows,
+                                             approximate_dense);
+                signatures[i] =
+                    transformer.getTransform(tfunctionals, pfunctionals);
+                continue;
+            }
+
+            // Rotate the remaining distinct channels along with this one,
+            // which shares the calculation of the sample coordinates
+            std::vector<size_t> joint(1, i);
+            if (mode == ProgramMode::CALCULATE && !precalculated[i]) {
+                for (size_t j = i + 1; j < components.size(); j++) {
+                    if (sources[j] == j &&
+                        components[j].rows() == component.rows() &&
+                        components[j].cols() == component.cols())
+                        joint.push_back(j);
+                }
+            }
+
+            // Look up the signatures of images seen before, which needn't fit
+            // in memory anymore
+            // NOTE: hashing the image is cheap compared to transforming it
+            bool cached_run = (cache && mode == ProgramMode::CALCULATE);
+            Hasher hasher;
+            if (cached_run)
+                hashImage(hasher, component);
+            std::string cache_key;
+            if (cached_run && !pfunctionals.empty()) {
+                cache_key = signatureKey(hasher,
+                                         vm["angle"].as<unsigned int>(),
+                                         tfunctionals, pfunctionals);
+                std::vector<Eigen::MatrixXf> cached;
+                if (cache->load(cache_key, cached) && cached.size() == 1) {
+                    clog(debug) << "Found the signatures of "
+                                << component_name << " in the cache"
+                                << std::endl;
+                    writecsv(component_name + ".csv", cached[0]);
+                    signatures[i] = cached[0];
+                    continue;
+                }
+            }
+
+            // Check whether the image fits in memory, on top of what has been
+            // allocated already
+            // NOTE: weak scaling grows the image with the amount of threads
+            float growth = (mode == ProgramMode::SCALING)
+                               ? std::sqrt((float)max_threads)
+                               : 1;
+            size_t estimate =
+                heapUsage() +
+                joint.size() * Transformer::estimateMemory(
+                    component.rows() * growth + 0.5,
+                    component.cols() * growth + 0.5,
+                    vm["angle"].as<unsigned int>(), orthonormal,
+                    tfunctionals, pfunctionals, max_threads);
+            if (joint.size() > 1) {
+                // The interleaved copy of the channels, in groups of four
+                size_t n = Transformer::paddedSize(
+                    component.rows(), component.cols(),
+                    vm["angle"].as<unsigned int>(), orthonormal);
+                estimate += (joint.size() + 3) / 4 * 4 * n * n * sizeof(float);
+            }
+            clog(debug) << "Estimated peak memory usage of " << component_name
+                        << ": " << formatBytes(estimate) << std::endl;
+            bool over_budget =
+                vm.count("memory-budget") &&
+                estimate > vm["memory-budget"].as<ByteSize>().bytes;
+
+            // Predict the transform instead of performing it
+            if (mode == ProgramMode::ESTIMATE) {
+                printEstimate(model, component_name, component.rows(),
+                              component.cols(),
+                              vm["angle"].as<unsigned int>(), orthonormal,
+                              estimate, over_budget);
+                continue;
+            }
+
+            if (over_budget) {
+                clog(error) << "Processing " << component_name << " ("
+                            << component.rows() << "x" << component.cols()
+                            << ") needs an estimated " << formatBytes(estimate)
+                            << ", which exceeds the memory budget of "
+                            << formatBytes(
+                                   vm["memory-budget"].as<ByteSize>().bytes)
+                            << std::endl;
+                return 1;
+            }
+
+            if (batching &&
+                BatchTransformer::supports(component.rows(), component.cols(),
+                                           orthonormal, tfunctionals,
+                                           pfunctionals)) {
+                // Batches consist of images of the same size
+                if (!batch.images.empty() &&
+                    (batch.images[0].rows() != component.rows() ||
+                     batch.images[0].cols() != component.cols()))
+                    flushBatch(batch, vm["angle"].as<unsigned int>(),
+                               tfunctionals, pfunctionals);
+
+                // Identical channels get their output along with the first
+                batch.images.push_back(gray2mat(component));
+                batch.names.push_back(
+                    std::vector<std::string>(1, component_name));
+                for (size_t j = i + 1; j < components.size(); j++) {
+                    if (sources[j] == i)
+                        batch.names.back().push_back(component_names[j]);
+                }
+                batched[i] = true;
+
+                if (batch.images.size() == (size_t)batch_lanes)
+                    flushBatch(batch, vm["angle"].as<unsigned int>(),
+                               tfunctionals, pfunctionals);
+                continue;
+            }
 
             // Preprocess the image
-            Transformer transformer(gray2mat(component), component_name,
+            Eigen::MatrixXf image = gray2mat(component);
+            Transformer transformer(image, component_name,
                                     vm["angle"].as<unsigned int>(),
                                     orthonormal);
 
             if (mode == ProgramMode::CALCULATE) {
-                transformer.getTransform(tfunctionals, pfunctionals, true);
+                // Reuse the sinograms of earlier runs with other P-functionals,
+                // which leaves only the cheaper stages to be calculated
+                std::string sinogram_key;
+                std::vector<Eigen::MatrixXf> sinograms;
+                bool found = false;
+                if (cached_run)
+                    sinogram_key =
+                        sinogramKey(hasher, vm["angle"].as<unsigned int>(),
+                                    orthonormal, tfunctionals);
+                if (precalculated[i]) {
+                    sinograms.swap(pending[i]);
+                } else if (cached_run) {
+                    found = cache->load(sinogram_key, sinograms) &&
+                            sinograms.size() == tfunctionals.size();
+                    if (found)
+                        clog(debug) << "Found the sinograms of "
+                                    << component_name << " in the cache"
+                                    << std::endl;
+                }
+
+                if (!found && !precalculated[i] && joint.size() > 1) {
+                    std::vector<std::unique_ptr<Transformer>> channels;
+                    std::vector<const Transformer *> transformers(
+                        1, &transformer);
+                    for (size_t j = 1; j < joint.size(); j++) {
+                        channels.emplace_back(new Transformer(
+                            gray2mat(components[joint[j]]),
+                            component_names[joint[j]],
+                            vm["angle"].as<unsigned int>(), orthonormal));
+                        transformers.push_back(channels.back().get());
+                    }
+                    std::vector<std::vector<Eigen::MatrixXf>> calculated =
+                        Transformer::calculateSinograms(transformers,
+                                                        tfunctionals);
+                    sinograms.swap(calculated[0]);
+                    for (size_t j = 1; j < joint.size(); j++) {
+                        pending[joint[j]].swap(calculated[j]);
+                        precalculated[joint[j]] = true;
+                    }
+                } else if (!found && !precalculated[i]) {
+                    sinograms = transformer.calculateSinograms(tfunctionals);
+                }
+                if (cached_run && !found)
+                    cache->store(sinogram_key, sinograms);
+
+                signatures[i] = transformer.calculateSignatures(
+                    sinograms, tfunctionals, pfunctionals, true);
+                if (!cache_key.empty())
+                    cache->store(cache_key, std::vector<Eigen::MatrixXf>(
+                                                1, signatures[i]));
             } else if (mode == ProgramMode::PROFILE) {
+                profiler.settings.enabled = profiler.settings.counters =
+                    (vm.count("counters") > 0);
                 transformer.getTransform(tfunctionals, pfunctionals, false);
+
+                if (profiler.settings.counters) {
+                    if (perfCounterAvailable(Cycles))
+                        profiler.reportCounters(clog(info));
+                    else
+                        clog(warning) << "Hardware performance counters are "
+                                         "not available" << std::endl;
+                    profiler.reset();
+                    profiler.settings.enabled = profiler.settings.counters =
+                        false;
+                }
             } else if (mode == ProgramMode::BENCHMARK) {
                 if (!vm.count("iterations"))
                     throw boost::program_options::required_option("iterations");
@@ -227,7 +998,10 @@ int main(int argc, char **argv) {
                 unsigned int iterations = vm["iterations"].as<unsigned int>();
 
                 // Warm-up
+                profiler.settings.enabled = true;
                 transformer.getTransform(tfunctionals, pfunctionals, false);
+                profiler.reset();
+                resetHeapPeak();
 
                 // Transform the image
                 // NOTE: although the use of elapsed real time rather than CPU
@@ -235,17 +1009,136 @@ int main(int argc, char **argv) {
                 //       some of the ports execute code on non-CPU hardware
                 std::chrono::time_point<std::chrono::high_resolution_clock>
                 last, current;
+                BenchmarkRecord record;
                 for (unsigned int n = 0; n < iterations; n++) {
+                    // Preprocess again, for the profiler to sample it
+                    Transformer iteration(image, component_name,
+                                          vm["angle"].as<unsigned int>(),
+                                          orthonormal);
+
                     last = std::chrono::high_resolution_clock::now();
-                    transformer.getTransform(tfunctionals, pfunctionals, false);
+                    iteration.getTransform(tfunctionals, pfunctionals, false);
                     current = std::chrono::high_resolution_clock::now();
+                    profiler.collect();
 
-                    clog(info) << "t_" << n + 1 << "="
-                               << std::chrono::duration_cast<
-                                      std::chrono::microseconds>(current - last)
-                                          .count() /
-                                      1000000.0 << std::endl;
+                    double elapsed = std::chrono::duration_cast<
+                                         std::chrono::microseconds>(
+                                         current - last).count() /
+                                     1000000.0;
+                    record.iterations.push_back(elapsed);
+                    clog(info) << "t_" << n + 1 << "=" << elapsed << std::endl;
                 }
+
+                // Break the time down into phases
+                profiler.report(clog(info));
+                size_t heap_peak = heapPeak(), rss_peak = peakResidentSize();
+                if (memoryTracked()) {
+                    profiler.reportMemory(clog(info));
+                    clog(info) << "Peak heap usage: " << formatBytes(heap_peak)
+                               << " (estimated " << formatBytes(estimate)
+                               << ")" << std::endl;
+                }
+                clog(info) << "Peak resident set size: "
+                           << formatBytes(rss_peak) << std::endl;
+                if (vm.count("report")) {
+                    record.input = component_name;
+                    record.rows = image.rows();
+                    record.cols = image.cols();
+                    record.angle = vm["angle"].as<unsigned int>();
+                    for (size_t t = 0; t < tfunctionals.size(); t++)
+                        record.tfunctionals.push_back(tfunctionals[t].name);
+                    for (size_t p = 0; p < pfunctionals.size(); p++)
+                        record.pfunctionals.push_back(pfunctionals[p].name);
+                    record.phases = profiler.statistics();
+                    record.heap_peak = heap_peak;
+                    record.rss_peak = rss_peak;
+                    records.push_back(record);
+                }
+                profiler.reset();
+                profiler.settings.enabled = false;
+            } else if (mode == ProgramMode::SCALING) {
+                if (!vm.count("iterations"))
+                    throw boost::program_options::required_option("iterations");
+                unsigned int iterations = vm["iterations"].as<unsigned int>();
+                std::vector<int> counts = threadCounts(max_threads);
+
+                // Remember where the threads may run, for pinning them to be
+                // undone afterwards
+                cpu_set_t affinity;
+                bool pinning =
+                    vm.count("pin") &&
+                    sched_getaffinity(0, sizeof(affinity), &affinity) == 0;
+
+                // Break the time down into phases when being verbose, which
+                // reveals the serial sections
+                profiler.settings.enabled =
+                    (logger.settings.threshold >= debug);
+
+                // Strong scaling: fixed image, growing amount of threads
+                clog(info) << "Strong scaling of " << component_name << " ("
+                           << image.rows() << "x" << image.cols() << ")"
+                           << std::endl;
+                clog(info) << std::setw(8) << "threads" << std::setw(12)
+                           << "time" << std::setw(10) << "speedup"
+                           << std::setw(12) << "efficiency" << std::endl;
+                double serial_time = 0;
+                for (size_t c = 0; c < counts.size(); c++) {
+                    omp_set_num_threads(counts[c]);
+                    if (pinning)
+                        pinThreads(cpus);
+                    double time = timeTransform(transformer, tfunctionals,
+                                                pfunctionals, iterations);
+                    if (c == 0)
+                        serial_time = time;
+                    double speedup = serial_time / time;
+                    std::stringstream row;
+                    row << std::setw(8) << counts[c] << std::fixed
+                        << std::setprecision(6) << std::setw(12) << time
+                        << std::setprecision(2) << std::setw(10) << speedup
+                        << std::setw(12) << speedup / counts[c];
+                    clog(info) << row.str() << std::endl;
+                    profiler.report(clog(debug));
+                    profiler.reset();
+                }
+
+                // Weak scaling: the image area grows with the amount of
+                // threads
+                clog(info) << "Weak scaling of " << component_name
+                           << std::endl;
+                clog(info) << std::setw(8) << "threads" << std::setw(12)
+                           << "size" << std::setw(12) << "time"
+                           << std::setw(12) << "efficiency" << std::endl;
+                for (size_t c = 0; c < counts.size(); c++) {
+                    omp_set_num_threads(counts[c]);
+                    if (pinning)
+                        pinThreads(cpus);
+                    float factor = std::sqrt((float)counts[c]);
+                    Eigen::MatrixXf scaled =
+                        resize(image, image.rows() * factor + 0.5,
+                               image.cols() * factor + 0.5);
+                    Transformer scaled_transformer(
+                        scaled, component_name,
+                        vm["angle"].as<unsigned int>(), orthonormal);
+                    double time = timeTransform(scaled_transformer,
+                                                tfunctionals, pfunctionals,
+                                                iterations);
+                    if (c == 0)
+                        serial_time = time;
+                    std::stringstream size, row;
+                    size << scaled.rows() << "x" << scaled.cols();
+                    row << std::setw(8) << counts[c] << std::setw(12)
+                        << size.str() << std::fixed << std::setprecision(6)
+                        << std::setw(12) << time << std::setprecision(2)
+                        << std::setw(12) << serial_time / time;
+                    clog(info) << row.str() << std::endl;
+                    profiler.report(clog(debug));
+                    profiler.reset();
+                }
+
+                omp_set_num_threads(max_threads);
+                if (pinning)
+                    unpinThreads(affinity);
+                profiler.settings.enabled = false;
             }
         }
 
@@ -253,5 +1146,26 @@ int main(int argc, char **argv) {
             ++indicator;
     }
 
+    flushBatch(batch, vm["angle"].as<unsigned int>(), tfunctionals,
+               pfunctionals);
+
+    if (cache)
+        clog(debug) << "Signature cache: " << cache->hits() << " hit(s), "
+                    << cache->misses() << " miss(es)" << std::endl;
+
+    // Save the timeline
+    if (vm.count("trace"))
+        tracer.write(vm["trace"].as<std::string>(), profiler.names());
+
+    // Save the benchmark report
+    if (vm.count("report") && mode == ProgramMode::BENCHMARK) {
+        std::string filename = vm["report"].as<std::string>();
+        if (!writeReport(filename, records)) {
+            clog(error) << "Could not write the benchmark report to "
+                        << filename << std::endl;
+            return 1;
+        }
+    }
+
     return 0;
 }
@@ -0,0 +1,447 @@
+//
+// Configuration
+//
+
+// Header include
+#include "dense.hpp"
+
+// Standard library
+#include <algorithm> // for sort, min, max, swap
+#include <cassert>   // for assert
+#include <cmath>     // for floor, ceil, cos, sin, fabs
+#include <limits>    // for numeric_limits
+#include <sstream>   // for stringstream
+#include <omp.h>     // for omp_get_max_threads
+
+// Boost
+#include <boost/program_options.hpp>
+
+// Local
+#include "global.hpp"
+#include "logger.hpp"
+#include "auxiliary.hpp"
+#include "profiler.hpp"
+#include "transform.hpp"
+
+
+//
+// Auxiliary
+//
+
+namespace {
+
+// Restrict the range of t to where a + b*t lies within [lower, upper]
+void clip(double a, double b, double lower, double upper, double &first,
+          double &last) {
+    if (std::fabs(b) < 1e-9) {
+        if (a < lower || a > upper)
+            last = -std::numeric_limits<double>::infinity();
+        return;
+    }
+    double from = (lower - a) / b, to = (upper - a) / b;
+    if (from > to)
+        std::swap(from, to);
+    first = std::max(first, from);
+    last = std::min(last, to);
+}
+
+// Prefix sums of a column of the rotated image, of its values weighted with
+// powers of the row index, for the moments of any range of rows to be the
+// difference of two entries
+struct ColumnSums {
+    ColumnSums(int _rows)
+        : rows(_rows), mass(rows + 1), moment(rows + 1), inertia(rows + 1) {
+        mass[0] = moment[0] = inertia[0] = 0;
+    }
+
+    void update(const float *column) {
+        for (int r = 0; r < rows; r++) {
+            mass[r + 1] = mass[r] + column[r];
+            moment[r + 1] = moment[r] + (double)r * column[r];
+            inertia[r + 1] = inertia[r] + (double)r * r * column[r];
+        }
+    }
+
+    int rows;
+    Eigen::VectorXd mass, moment, inertia;
+};
+
+// Moments of a line of samples which lies in between the pixels of the
+// rotated image: a fraction f beyond the column of the left sums, and with
+// every sample a fraction g beyond its row
+// NOTE: the samples are interpolated bilinearly, which is linear in the
+//       pixels, so their moments follow from those of the two columns
+class LineSums {
+  public:
+    LineSums(const ColumnSums &left, const ColumnSums &right, double f,
+             double g)
+        : _left(left), _right(right) {
+        _weights[0] = (1 - f) * (1 - g);
+        _weights[1] = (1 - f) * g;
+        _weights[2] = f * (1 - g);
+        _weights[3] = f * g;
+    }
+
+    // Sum of the samples of the rows [a, b)
+    double mass(int a, int b) const {
+        return _weights[0] * (_left.mass[b] - _left.mass[a]) +
+               _weights[1] * (_left.mass[b + 1] - _left.mass[a + 1]) +
+               _weights[2] * (_right.mass[b] - _right.mass[a]) +
+               _weights[3] * (_right.mass[b + 1] - _right.mass[a + 1]);
+    }
+
+    // Sums of the samples of the rows [a, b), weighted with their row index
+    // and its square
+    void moments(int a, int b, double &m0, double &m1, double &m2) const {
+        m0 = m1 = m2 = 0;
+        add(_left, _weights[0], 0, a, b, m0, m1, m2);
+        add(_left, _weights[1], 1, a, b, m0, m1, m2);
+        add(_right, _weights[2], 0, a, b, m0, m1, m2);
+        add(_right, _weights[3], 1, a, b, m0, m1, m2);
+    }
+
+  private:
+    // Add the moments of the pixels a row beyond the samples (if shifted),
+    // relative to the row of the samples
+    static void add(const ColumnSums &sums, double weight, int shift, int a,
+                    int b, double &m0, double &m1, double &m2) {
+        double mass = sums.mass[b + shift] - sums.mass[a + shift];
+        double moment = sums.moment[b + shift] - sums.moment[a + shift];
+        double inertia = sums.inertia[b + shift] - sums.inertia[a + shift];
+        m0 += weight * mass;
+        m1 += weight * (moment - shift * mass);
+        m2 += weight * (inertia - 2 * shift * moment + shift * shift * mass);
+    }
+
+    const ColumnSums &_left, &_right;
+    double _weights[4];
+};
+
+}
+
+
+//
+// Module definitions
+//
+
+std::istream &operator>>(std::istream &in, WindowSpec &spec) {
+    std::string value;
+    in >> value;
+    std::stringstream stream(value);
+    char separator = ':';
+    stream >> spec.size;
+    if (!stream.eof())
+        stream >> separator >> spec.stride;
+    else
+        spec.stride = spec.size;
+    if (stream.fail() || !stream.eof() || separator != ':' ||
+        spec.size == 0 || spec.stride == 0)
+        throw boost::program_options::validation_error(
+            boost::program_options::validation_error::invalid_option_value);
+    return in;
+}
+
+DenseTransformer::DenseTransformer(const Eigen::MatrixXf &image,
+                                   const std::string &basename,
+                                   unsigned int angle_stepsize,
+                                   bool orthonormal, const WindowSpec &windows,
+                                   bool approximate)
+    : _image(image), _rows(image.rows()), _cols(image.cols()),
+      _basename(basename), _orthonormal(orthonormal),
+      _angle_stepsize(angle_stepsize), _windows(windows),
+      _approximate(approximate) {
+    assert(image.rows() >= windows.size && image.cols() >= windows.size);
+    _window_rows = (_rows - windows.size) / windows.stride + 1;
+    _window_cols = (_cols - windows.size) / windows.stride + 1;
+}
+
+bool DenseTransformer::supports(
+    const std::vector<TFunctionalWrapper> &tfunctionals,
+    const std::vector<PFunctionalWrapper> &pfunctionals) {
+    for (size_t t = 0; t < tfunctionals.size(); t++) {
+        TFunctional tfunctional = tfunctionals[t].functional;
+        if (tfunctional != TFunctional::Radon &&
+            tfunctional != TFunctional::T1 && tfunctional != TFunctional::T2)
+            return false;
+    }
+    for (size_t p = 0; p < pfunctionals.size(); p++) {
+        if (pfunctionals[p].functional == PFunctional::Hermite)
+            return false;
+    }
+    return true;
+}
+
+Eigen::MatrixXf DenseTransformer::getTransform(
+    const std::vector<TFunctionalWrapper> &tfunctionals,
+    const std::vector<PFunctionalWrapper> &pfunctionals,
+    bool write_data) const {
+    const int count = _window_rows * _window_cols;
+    const size_t combinations = tfunctionals.size() * pfunctionals.size();
+
+    Eigen::MatrixXf signatures;
+    if (_approximate) {
+        signatures = traceWindows(tfunctionals, pfunctionals);
+
+        // Compare the signatures of the first window against the exact ones
+        if (combinations > 0) {
+            TransformPlan plan;
+            Eigen::VectorXf exact =
+                transformWindow(0, tfunctionals, pfunctionals, plan);
+            float deviation =
+                (signatures.row(0).transpose() - exact).cwiseAbs().maxCoeff();
+            clog(info) << "Approximate signatures of the first window deviate "
+                       << "at most " << deviation << " (standard deviations) "
+                       << "from the exact result" << std::endl;
+        }
+    } else {
+        // Transform every window on its own, with the pre-calculations of
+        // the first one
+        TransformPlan plan;
+        for (int window = 0; window < count; window++) {
+            Eigen::VectorXf signature =
+                transformWindow(window, tfunctionals, pfunctionals, plan);
+            if (window == 0)
+                signatures.resize(count, signature.size());
+            signatures.row(window) = signature.transpose();
+        }
+    }
+
+    // Save the signatures
+    if (write_data && combinations > 0) {
+        PhaseTimer timer(profiler.phase("output"), signatures.size());
+        writecsv(_basename + ".csv", signatures);
+    }
+
+    return signatures;
+}
+
+Eigen::VectorXf DenseTransformer::transformWindow(
+    int window, const std::vector<TFunctionalWrapper> &tfunctionals,
+    std::vector<PFunctionalWrapper> pfunctionals, TransformPlan &plan) const {
+    const int size = _windows.size, stride = _windows.stride;
+    Transformer transformer(
+        _image.block((window / _window_cols) * stride,
+                     (window % _window_cols) * stride, size, size),
+        _basename, _angle_stepsize, _orthonormal);
+    Eigen::MatrixXf signatures =
+        transformer.getTransform(tfunctionals, pfunctionals, false, &plan);
+    return Eigen::Map<Eigen::VectorXf>(signatures.data(), signatures.size());
+}
+
+Eigen::MatrixXf DenseTransformer::traceWindows(
+    const std::vector<TFunctionalWrapper> &tfunctionals,
+    const std::vector<PFunctionalWrapper> &pfunctionals) const {
+    const int size = _windows.size, stride = _windows.stride;
+    const int count = _window_rows * _window_cols;
+    const int a_steps = (int)std::floor(360 / _angle_stepsize);
+    const size_t combinations = tfunctionals.size() * pfunctionals.size();
+
+    // Pad the image as a whole, for every window to be traced in the same
+    // rotated image
+    Eigen::MatrixXf padded;
+    {
+        PhaseTimer timer(profiler.phase("pad"), _image.size());
+        padded = pad(_image);
+    }
+    clog(debug) << "Padded image to " << padded.rows() << "x" << padded.cols()
+                << " for " << _window_rows << "x" << _window_cols
+                << " windows" << std::endl;
+
+    // Every window gets traced like its own padded image would be: along n
+    // lines, the middle one crossing its center
+    // NOTE: the center of a window is where pad() places the origin
+    const int n = padded_size(size, size);
+    const int half = (n - 1) / 2;
+    const int origin = (size + 1) / 2 - 1;
+
+    // Geometry of the padded image, and the offset of the image within it
+    const int m = padded.rows();
+    const double center = (m - 1) / 2.0;
+    const int df_x = (m + 1) / 2 - (_cols + 1) / 2;
+    const int df_y = (m + 1) / 2 - (_rows + 1) / 2;
+
+    // Circus functions of every window, per combination of functionals
+    std::vector<Eigen::MatrixXf> circusfunctions(
+        combinations, Eigen::MatrixXf(count, a_steps));
+
+    int phase_angles = profiler.phase("angles");
+    int phase_rotate = profiler.phase("rotate");
+    std::string stage_names;
+    for (size_t t = 0; t < tfunctionals.size(); t++)
+        stage_names += (t ? "+" : "") + tfunctionals[t].name;
+    int phase_columns =
+        profiler.phase(stage_names.empty() ? "columns" : stage_names);
+
+    // Process the angles in chunks of one per thread, tracing the sinograms
+    // of a chunk in parallel and then deriving their circus functions (which
+    // parallelize over the windows by themselves)
+    const int chunk_size = omp_get_max_threads();
+    std::vector<std::vector<Eigen::MatrixXf>> sinograms(
+        chunk_size, std::vector<Eigen::MatrixXf>(tfunctionals.size(),
+                                                 Eigen::MatrixXf(n, count)));
+    PPrecalculations plan(n, pfunctionals);
+    for (int chunk = 0; chunk < a_steps; chunk += chunk_size) {
+        const int angles = std::min(chunk_size, a_steps - chunk);
+
+        #pragma omp parallel
+        {
+            TraceSpan span(phase_angles);
+            ColumnSums left(m), right(m);
+            const Eigen::VectorXf zeros = Eigen::VectorXf::Zero(m);
+            std::vector<int> starts(count), order(count);
+            std::vector<double> line_fractions(count), row_fractions(count);
+
+            #pragma omp for schedule(static) nowait
+            for (int k = 0; k < angles; k++) {
+                const int a_step = chunk + k;
+                float a = deg2rad(a_step * _angle_stepsize);
+                Eigen::MatrixXf rotated;
+                {
+                    PhaseTimer timer(phase_rotate, padded.size());
+                    rotated = rotate(padded,
+                                     Point<float>::type(center, center), a);
+                }
+                PhaseTimer timer(phase_columns, padded.size());
+
+                // Where the lines of every window lie in the rotated image: the
+                // column before its first line, and the fraction of a pixel
+                // beyond the columns and rows of the rotated image at which it
+                // gets sampled (the same for all of its lines), and the windows
+                // in the order the columns reach them
+                const double c = std::cos(a), s = std::sin(a);
+                for (int i = 0; i < count; i++) {
+                    double x = df_x + (i % _window_cols) * stride + origin;
+                    double y = df_y + (i / _window_cols) * stride + origin;
+                    double line = center + (x - center) * c + (y - center) * s;
+                    double row = center - (x - center) * s + (y - center) * c;
+                    starts[i] = (int)std::floor(line) - half;
+                    line_fractions[i] = line - std::floor(line);
+                    row_fractions[i] = row - std::floor(row);
+                    order[i] = i;
+                }
+                std::sort(order.begin(), order.end(), [&starts](int i, int j) {
+                    return starts[i] < starts[j];
+                });
+
+                // Sweep the columns, with the windows which have a line in
+                // between them and the next one
+                for (size_t t = 0; t < tfunctionals.size(); t++)
+                    sinograms[k][t].setZero();
+                int first = 0, last = 0, summed = -2;
+                for (int col = std::max(starts[order[0]], 0); col < m; col++) {
+                    while (first < count && starts[order[first]] + n <= col)
+                        first++;
+                    while (last < count && starts[order[last]] <= col)
+                        last++;
+                    if (first == count)
+                        break;
+                    if (first == last)
+                        continue;
+                    if (summed == col - 1)
+                        std::swap(left, right);
+                    else
+                        left.update(rotated.col(col).data());
+                    right.update(col + 1 < m ? rotated.col(col + 1).data()
+                                             : zeros.data());
+                    summed = col;
+
+                    for (int w = first; w < last; w++) {
+                        const int i = order[w];
+                        const double x = df_x + (i % _window_cols) * stride;
+                        const double y = df_y + (i / _window_cols) * stride;
+                        const double g = row_fractions[i];
+
+                        // Samples of the line which lie within the window
+                        // (with the same rotation as rotate() applies),
+                        // including the half pixel around its edges which a
+                        // padded window gets interpolated over
+                        double u = col + line_fractions[i] - center;
+                        double from = -std::numeric_limits<double>::infinity();
+                        double to = std::numeric_limits<double>::infinity();
+                        clip(center + u * c, -s, x - 0.5, x + size - 0.5, from,
+                             to);
+                        clip(center + u * s, c, y - 0.5, y + size - 0.5, from,
+                             to);
+                        // NOTE: lines almost parallel to an edge yield bounds
+                        //       far beyond the image, which get clamped
+                        //       before being converted to rows
+                        if (from > to)
+                            continue;
+                        int r1 = (int)std::ceil(
+                            std::max(center + from - g, 0.0));
+                        int r2 = (int)std::floor(
+                            std::min(center + to - g, m - 2.0));
+                        if (r1 > r2)
+                            continue;
+
+                        LineSums sums(left, right, line_fractions[i], g);
+                        double total = sums.mass(r1, r2 + 1);
+
+                        // Weighted median: the first sample at which the
+                        // integral reaches half of the total
+                        int lower = r1, upper = r2;
+                        while (lower < upper) {
+                            int middle = (lower + upper) / 2;
+                            if (2 * sums.mass(r1, middle + 1) >= total)
+                                upper = middle;
+                            else
+                                lower = middle + 1;
+                        }
+                        const double median = lower;
+
+                        // Integrate (r - median) and its square beyond the
+                        // median
+                        double m0, m1, m2;
+                        sums.moments(lower, r2 + 1, m0, m1, m2);
+                        for (size_t t = 0; t < tfunctionals.size(); t++) {
+                            double result;
+                            switch (tfunctionals[t].functional) {
+                            case TFunctional::T1:
+                                result = m1 - median * m0;
+                                break;
+                            case TFunctional::T2:
+                                result =
+                                    m2 - 2 * median * m1 + median * median * m0;
+                                break;
+                            case TFunctional::Radon:
+                            default:
+                                result = total;
+                                break;
+                            }
+                            sinograms[k][t](col - starts[i], i) = result;
+                        }
+                    }
+                }
+            }
+        }
+
+        // Process the P-functionals of every window at once
+        for (int k = 0; k < angles; k++) {
+            for (size_t t = 0; t < tfunctionals.size(); t++) {
+                if (pfunctionals.empty())
+                    break;
+                std::vector<Eigen::VectorXf> circus =
+                    getCircusFunctions(sinograms[k][t], pfunctionals, &plan);
+                for (size_t p = 0; p < pfunctionals.size(); p++)
+                    circusfunctions[t * pfunctionals.size() + p].col(
+                        chunk + k) = circus[p];
+            }
+        }
+    }
+
+    // Normalize, and lay out the signatures of every window
+    Eigen::MatrixXf signatures(count, combinations * a_steps);
+    {
+        PhaseTimer timer(profiler.phase("zscore"), signatures.size());
+        for (size_t i = 0; i < combinations; i++) {
+            for (int window = 0; window < count; window++) {
+                Eigen::VectorXf circusfunction =
+                    circusfunctions[i].row(window).transpose();
+                signatures.block(window, i * a_steps, 1, a_steps) =
+                    zscore(circusfunction).transpose();
+            }
+        }
+    }
+
+    return signatures;
+}
@@ -7,8 +7,10 @@
 
 // Standard library
 #include <cmath>   // for log, sqrt, cos, sin, hypot, etc
-#include <cstdlib> // for calloc, qsort, qsort_r
+#include <cstdlib> // for malloc, free
 #include <cassert>
+#include <algorithm> // for min, fill, copy
+#include <vector>    // for vector
 
 // FFTW
 #include <fftw3.h>
@@ -16,6 +18,9 @@
 // OpenMP
 #include <omp.h>
 
+// Local
+#include "sort.hpp"
+
 
 ////////////////////////////////////////////////////////////////////////////////
 // Auxiliary
@@ -32,25 +37,62 @@ int findWeightedMedian(const Eigen::VectorXf& data) {
     return data.size() - 1;
 }
 
-int compareFloat(const void *a, const void *b) {
-    float *x = (float *)a;
-    float *y = (float *)b;
-
-    if (*x < *y) {
-        return -1;
-    } else if (*x > *y) {
-        return 1;
-    } else {
-        return 0;
+// Approximate the key at which the cumulative weight (in sorted key order)
+// reaches half of the total, without sorting. A fixed-bin histogram of the
+// weights locates the straddling bin, after which a second histogram refines
+// within that bin; the result lies within (max-min)/bins^2 of the exact one.
+float approximateWeightedMedian(const float *keys, const float *weights,
+                                int length, unsigned int bins) {
+    assert(length > 0 && bins > 0);
+
+    // Determine the key range and the total weight
+    float lower = keys[0], upper = keys[0], total = 0;
+    for (int i = 0; i < length; i++) {
+        lower = std::min(lower, keys[i]);
+        upper = std::max(upper, keys[i]);
+        total += weights[i];
+    }
+    if (!(upper > lower) || !(total > 0))
+        return lower;
+    const int last = bins - 1;
+    const float scale = bins / (upper - lower);
+
+    // Histogram the weights, and find the bin straddling the median
+    static thread_local std::vector<float> histogram;
+    histogram.assign(bins, 0);
+    for (int i = 0; i < length; i++) {
+        int bin = std::min((int)((keys[i] - lower) * scale), last);
+        histogram[bin] += weights[i];
+    }
+    float integral = 0;
+    int straddle = last;
+    for (int b = 0; b < last; b++) {
+        if (2 * (integral + histogram[b]) >= total) {
+            straddle = b;
+            break;
+        }
+        integral += histogram[b];
     }
-}
-
-int compareIndexedFloat(const void *a, const void *b, void *arg) {
-    int *x = (int *)a;
-    int *y = (int *)b;
-    float *data_weighted = (float *)arg;
 
-    return compareFloat(data_weighted + *x, data_weighted + *y);
+    // Refine within the straddling bin
+    const float width = (upper - lower) / bins;
+    const float straddle_lower = lower + straddle * width;
+    histogram.assign(bins, 0);
+    for (int i = 0; i < length; i++) {
+        int bin = std::min((int)((keys[i] - lower) * scale), last);
+        int sub = std::min(
+            std::max((int)((keys[i] - straddle_lower) * scale * bins), 0), last);
+        histogram[sub] += (bin == straddle) * weights[i];
+    }
+    int sub = last;
+    for (int b = 0; b < last; b++) {
+        integral += histogram[b];
+        if (2 * integral >= total) {
+            sub = b;
+            break;
+        }
+    }
+    return straddle_lower + (sub + 0.5f) * width / bins;
 }
 
 float trapz(const Eigen::VectorXf &x, const Eigen::VectorXf y) {
@@ -86,6 +128,19 @@ float hermite_function(unsigned int order, float x) {
             exp(x * x / 2));
 }
 
+// Smallest length >= n which FFTW transforms efficiently (only factors 2, 3,
+// 5 and 7)
+int fftGoodSize(int n) {
+    for (;; n++) {
+        int m = n;
+        for (int factor : {2, 3, 5, 7})
+            while (m % factor == 0)
+                m /= factor;
+        if (m == 1)
+            return n;
+    }
+}
+
 
 ////////////////////////////////////////////////////////////////////////////////
 // T-functionals
@@ -143,6 +198,8 @@ TFunctional345_precalc_t *TFunctional3_prepare(int rows,
 
     precalc->real = (float *)malloc(rows * sizeof(float));
     precalc->imag = (float *)malloc(rows * sizeof(float));
+    precalc->rows = rows;
+    precalc->fft = NULL;
 
     for (int r = 1; r < rows; r++) {
 #if defined(__clang__)
@@ -165,6 +222,8 @@ TFunctional345_precalc_t *TFunctional4_prepare(int rows,
 
     precalc->real = (float *)malloc(rows * sizeof(float));
     precalc->imag = (float *)malloc(rows * sizeof(float));
+    precalc->rows = rows;
+    precalc->fft = NULL;
 
     for (int r = 1; r < rows; r++) {
 #if defined(__clang__)
@@ -185,6 +244,8 @@ TFunctional345_precalc_t *TFunctional5_prepare(int rows,
 
     precalc->real = (float *)malloc(rows * sizeof(float));
     precalc->imag = (float *)malloc(rows * sizeof(float));
+    precalc->rows = rows;
+    precalc->fft = NULL;
 
     for (int r = 1; r < rows; r++) {
 #if defined(__clang__)
@@ -215,7 +276,156 @@ float TFunctional345(const Eigen::VectorXf& data,
     return hypot(integral_real, integral_imag);
 }
 
+// For column c, T3-T5 compute the dot product of a fixed complex kernel with
+// the column shifted by its squared median m_c. Over all columns of an image
+// that is a cross-correlation, sampled at a different lag for every column.
+// For large images we compute those correlations for batches of columns with
+// FFTW, and gather the value at each column's lag.
+//
+// NOTE: the direct loop is O(n) per column while the correlation yields all n
+//       lags in O(n log n), so this only pays off when FFTW's SIMD kernels
+//       outrun the scalar loop; the switch-over size is therefore tunable.
+
+struct TFunctional345_fft_t {
+    int length; // zero-padded transform length (avoids circular wrap-around)
+    int batch;  // amount of columns per transform
+
+    // Conjugated spectra of the real and imaginary kernel, scaled by 1/length
+    fftwf_complex *kernel_real;
+    fftwf_complex *kernel_imag;
+
+    // Batched plans, executed through the thread-safe new-array interface
+    fftwf_plan forward;
+    fftwf_plan backward;
+};
+
+void TFunctional345_prepare_fft(TFunctional345_precalc_t *precalc, int cols) {
+    TFunctional345_fft_t *fft = new TFunctional345_fft_t;
+    fft->length = fftGoodSize(2 * precalc->rows - 1);
+    fft->batch = std::min(cols, 64);
+    int bins = fft->length / 2 + 1;
+
+    // Transform the (zero-padded) kernels
+    float *kernel = fftwf_alloc_real(fft->length);
+    fft->kernel_real = fftwf_alloc_complex(bins);
+    fft->kernel_imag = fftwf_alloc_complex(bins);
+    fftwf_plan p;
+#pragma omp critical (make_plan)
+    p = fftwf_plan_dft_r2c_1d(fft->length, kernel, fft->kernel_real,
+                              FFTW_ESTIMATE);
+    assert(p != NULL);
+    std::fill(kernel, kernel + fft->length, 0);
+    std::copy(precalc->real + 1, precalc->real + precalc->rows, kernel + 1);
+    fftwf_execute_dft_r2c(p, kernel, fft->kernel_real);
+    std::copy(precalc->imag + 1, precalc->imag + precalc->rows, kernel + 1);
+    fftwf_execute_dft_r2c(p, kernel, fft->kernel_imag);
+#pragma omp critical (make_plan)
+    fftwf_destroy_plan(p);
+    fftwf_free(kernel);
+    for (int k = 0; k < bins; k++) {
+        fft->kernel_real[k][0] /= fft->length;
+        fft->kernel_real[k][1] /= -fft->length;
+        fft->kernel_imag[k][0] /= fft->length;
+        fft->kernel_imag[k][1] /= -fft->length;
+    }
+
+    // Plan the batched transforms
+    // NOTE: FFTW_ESTIMATE leaves the arrays untouched, and FFTW's allocator
+    //       guarantees the alignment matches that of the per-thread buffers
+    float *signal = fftwf_alloc_real(fft->length * fft->batch);
+    fftwf_complex *spectrum = fftwf_alloc_complex(bins * fft->batch);
+#pragma omp critical (make_plan)
+    {
+        fft->forward = fftwf_plan_many_dft_r2c(
+            1, &fft->length, fft->batch, signal, NULL, 1, fft->length,
+            spectrum, NULL, 1, bins, FFTW_ESTIMATE);
+        fft->backward = fftwf_plan_many_dft_c2r(
+            1, &fft->length, fft->batch, spectrum, NULL, 1, bins, signal,
+            NULL, 1, fft->length, FFTW_ESTIMATE);
+    }
+    assert(fft->forward != NULL && fft->backward != NULL);
+    fftwf_free(spectrum);
+    fftwf_free(signal);
+
+    precalc->fft = fft;
+}
+
+void TFunctional345_batch(const Eigen::MatrixXf &data,
+                          TFunctional345_precalc_t *precalc, float *output) {
+    assert(data.rows() == precalc->rows);
+
+    // Direct loop
+    if (precalc->fft == NULL) {
+        for (int column = 0; column < data.cols(); column++)
+            output[column] = TFunctional345(data.col(column), precalc);
+        return;
+    }
+
+    // Allocate the per-thread buffers
+    TFunctional345_fft_t *fft = precalc->fft;
+    int bins = fft->length / 2 + 1;
+    float *signal = fftwf_alloc_real(fft->length * fft->batch);
+    float *correlation_real = fftwf_alloc_real(fft->length * fft->batch);
+    float *correlation_imag = fftwf_alloc_real(fft->length * fft->batch);
+    fftwf_complex *spectrum = fftwf_alloc_complex(bins * fft->batch);
+    fftwf_complex *product = fftwf_alloc_complex(bins * fft->batch);
+    std::vector<int> squaredmedians(fft->batch);
+
+    for (int first = 0; first < data.cols(); first += fft->batch) {
+        int count = std::min(fft->batch, (int)data.cols() - first);
+
+        // Load the zero-padded columns, and transform the domain from t to r1
+        std::fill(signal, signal + fft->length * fft->batch, 0);
+        for (int b = 0; b < count; b++) {
+            const float *column = data.col(first + b).data();
+            std::copy(column, column + data.rows(), signal + b * fft->length);
+            squaredmedians[b] =
+                findWeightedMedian(data.col(first + b).cwiseSqrt());
+        }
+        fftwf_execute_dft_r2c(fft->forward, signal, spectrum);
+
+        // Correlate with the real and the imaginary kernel
+        for (int part = 0; part < 2; part++) {
+            fftwf_complex *kernel = part ? fft->kernel_imag : fft->kernel_real;
+            for (int b = 0; b < fft->batch; b++) {
+                for (int k = 0; k < bins; k++) {
+                    const float *x = spectrum[b * bins + k];
+                    product[b * bins + k][0] =
+                        x[0] * kernel[k][0] - x[1] * kernel[k][1];
+                    product[b * bins + k][1] =
+                        x[0] * kernel[k][1] + x[1] * kernel[k][0];
+                }
+            }
+            fftwf_execute_dft_c2r(fft->backward, product,
+                                  part ? correlation_imag : correlation_real);
+        }
+
+        // Gather the integral at each column's lag
+        for (int b = 0; b < count; b++) {
+            int lag = b * fft->length + squaredmedians[b];
+            output[first + b] =
+                hypot(correlation_real[lag], correlation_imag[lag]);
+        }
+    }
+
+    fftwf_free(product);
+    fftwf_free(spectrum);
+    fftwf_free(correlation_imag);
+    fftwf_free(correlation_real);
+    fftwf_free(signal);
+}
+
 void TFunctional345_destroy(TFunctional345_precalc_t *precalc) {
+    if (precalc->fft != NULL) {
+#pragma omp critical (make_plan)
+        {
+            fftwf_destroy_plan(precalc->fft->forward);
+            fftwf_destroy_plan(precalc->fft->backward);
+        }
+        fftwf_free(precalc->fft->kernel_real);
+        fftwf_free(precalc->fft->kernel_imag);
+        delete precalc->fft;
+    }
     free(precalc->real);
     free(precalc->imag);
     free(precalc);
@@ -227,55 +437,227 @@ void TFunctional345_destroy(TFunctional345_precalc_t *precalc) {
 //
 
 float TFunctional6(const Eigen::VectorXf& data) {
+    float result;
+    TFunctional6_batch(data, &result);
+    return result;
+}
+
+void TFunctional6_batch(const Eigen::MatrixXf& data, float *output,
+                        unsigned int approx_bins) {
     // Transform the domain from t to r1
-    int squaredmedian = findWeightedMedian(data.cwiseSqrt());
-    int length_r1 = data.size() - squaredmedian;
+    std::vector<int> squaredmedians(data.cols());
+    std::vector<int> offsets(data.cols() + 1);
+    offsets[0] = 0;
+    for (int column = 0; column < data.cols(); column++) {
+        squaredmedians[column] = findWeightedMedian(data.col(column).cwiseSqrt());
+        offsets[column + 1] =
+            offsets[column] + data.rows() - squaredmedians[column];
+    }
 
     // Extract and weight data from the positive domain of r1
-    // and prepare the indexing array
-    Eigen::VectorXi data_weighted_index(length_r1);
-    Eigen::VectorXf data_weighted(length_r1);
-    for (int r1 = 0; r1 < length_r1; r1++) {
-        data_weighted[r1] = (float)r1 * data[r1 + squaredmedian];
-        data_weighted_index[r1] = r1;
+    std::vector<float> data_weighted(offsets.back());
+    for (int column = 0; column < data.cols(); column++) {
+        for (int r1 = 0; r1 < offsets[column + 1] - offsets[column]; r1++) {
+            data_weighted[offsets[column] + r1] =
+                (float)r1 * data(r1 + squaredmedians[column], column);
+        }
     }
 
-    // Sort the weighted data
-    // NOTE: since we need the indexes later on, we don't actually sort the
-    //       array but save the indexes of the sorted elements
-    qsort_r(data_weighted_index.data(), length_r1, sizeof(int),
-            compareIndexedFloat, data_weighted.data());
+    // Approximate the weighted median without sorting
+    if (approx_bins > 0) {
+        std::vector<float> weights(offsets.back());
+        for (int column = 0; column < data.cols(); column++) {
+            int length_r1 = offsets[column + 1] - offsets[column];
+            for (int r1 = 0; r1 < length_r1; r1++)
+                weights[offsets[column] + r1] =
+                    std::sqrt(data(r1 + squaredmedians[column], column));
+            output[column] = approximateWeightedMedian(
+                &data_weighted[offsets[column]], &weights[offsets[column]],
+                length_r1, approx_bins);
+        }
+        return;
+    }
 
-    // Permuting the input data
-    Eigen::VectorXf data_sort(length_r1);
-    for (int r1 = 0; r1 < length_r1; r1++) {
-        data_sort[r1] = data[squaredmedian + data_weighted_index[r1]];
+    // Prepare the indexing array
+    std::vector<int> data_weighted_index(offsets.back());
+    for (int column = 0; column < data.cols(); column++) {
+        for (int r1 = 0; r1 < offsets[column + 1] - offsets[column]; r1++)
+            data_weighted_index[offsets[column] + r1] = r1;
     }
 
-    // Weighted median
-    int index = findWeightedMedian(data_sort.cwiseSqrt());
-    return data_weighted[data_weighted_index[index]];
+    // Sort the weighted data of all columns at once
+    // NOTE: since we need the indexes later on, we sort the indexes along
+    sortSegments(data_weighted.data(), data_weighted_index.data(),
+                 offsets.data(), data.cols());
+
+    for (int column = 0; column < data.cols(); column++) {
+        int length_r1 = offsets[column + 1] - offsets[column];
+        const int *index = &data_weighted_index[offsets[column]];
+
+        // Permuting the input data
+        Eigen::VectorXf data_sort(length_r1);
+        for (int r1 = 0; r1 < length_r1; r1++) {
+            data_sort[r1] = data(squaredmedians[column] + index[r1], column);
+        }
+
+        // Weighted median
+        int median = findWeightedMedian(data_sort.cwiseSqrt());
+        output[column] = data_weighted[offsets[column] + median];
+    }
 }
 
 
+// Consecutive angles yield nearly identical orderings of the weighted data
+// in the same column. The incremental mode therefore keeps every column's
+// permutation of the previous angle (per thread, as each thread processes a
+// contiguous range of angles) and repairs it with an insertion sort, falling
+// back to a full sort if the elements turn out to be displaced too far.
+
+struct TFunctional6_precalc_t {
+    // Sorted rows of every column at the previously processed angle, per
+    // thread
+    std::vector<std::vector<std::vector<int>>> orders;
+};
+
+TFunctional6_precalc_t *TFunctional6_prepare(int, int cols) {
+    TFunctional6_precalc_t *precalc = new TFunctional6_precalc_t;
+    precalc->orders.resize(omp_get_max_threads(),
+                           std::vector<std::vector<int>>(cols));
+    return precalc;
+}
+
+void TFunctional6_incremental(const Eigen::MatrixXf& data,
+                              TFunctional6_precalc_t *precalc, float *output) {
+    std::vector<std::vector<int>> &orders =
+        precalc->orders[omp_get_thread_num()];
+    assert(orders.size() == (size_t)data.cols());
+
+    std::vector<float> data_weighted;
+    std::vector<int> data_weighted_index;
+    for (int column = 0; column < data.cols(); column++) {
+        const float *values = data.col(column).data();
+        std::vector<int> &order = orders[column];
+
+        // Transform the domain from t to r1
+        int squaredmedian = findWeightedMedian(data.col(column).cwiseSqrt());
+        int length_r1 = data.rows() - squaredmedian;
+
+        // Carry over the previous order of the rows still in the domain of
+        // r1, preceded by the rows which entered it
+        int previous_squaredmedian = data.rows() - order.size();
+        data_weighted_index.clear();
+        for (int r1 = 0; r1 < previous_squaredmedian - squaredmedian; r1++)
+            data_weighted_index.push_back(r1);
+        for (size_t i = 0; i < order.size(); i++) {
+            if (order[i] >= squaredmedian)
+                data_weighted_index.push_back(order[i] - squaredmedian);
+        }
+        assert(data_weighted_index.size() == (size_t)length_r1);
+
+        // Weigh the data in that order
+        data_weighted.resize(length_r1);
+        for (int i = 0; i < length_r1; i++) {
+            int r1 = data_weighted_index[i];
+            data_weighted[i] = (float)r1 * values[r1 + squaredmedian];
+        }
+
+        // Repair the order with an insertion sort, bounding the displacement
+        long moves = 0, budget = 8L * length_r1;
+        for (int i = 1; i < length_r1 && moves <= budget; i++) {
+            float key = data_weighted[i];
+            int index = data_weighted_index[i];
+            int j = i - 1;
+            while (j >= 0 && data_weighted[j] > key) {
+                data_weighted[j + 1] = data_weighted[j];
+                data_weighted_index[j + 1] = data_weighted_index[j];
+                j--;
+            }
+            data_weighted[j + 1] = key;
+            data_weighted_index[j + 1] = index;
+            moves += i - 1 - j;
+        }
+
+        // Fall back to a full sort
+        if (moves > budget) {
+            for (int r1 = 0; r1 < length_r1; r1++) {
+                data_weighted[r1] = (float)r1 * values[r1 + squaredmedian];
+                data_weighted_index[r1] = r1;
+            }
+            sortPairs(data_weighted.data(), data_weighted_index.data(),
+                      length_r1);
+        }
+
+        // Remember the order for the next angle
+        order.resize(length_r1);
+        for (int i = 0; i < length_r1; i++)
+            order[i] = data_weighted_index[i] + squaredmedian;
+
+        // Permuting the input data
+        Eigen::VectorXf data_sort(length_r1);
+        for (int r1 = 0; r1 < length_r1; r1++) {
+            data_sort[r1] = values[squaredmedian + data_weighted_index[r1]];
+        }
+
+        // Weighted median
+        int median = findWeightedMedian(data_sort.cwiseSqrt());
+        output[column] = data_weighted[median];
+    }
+}
+
+void TFunctional6_destroy(TFunctional6_precalc_t *precalc) { delete precalc; }
+
+
 //
 // T7
 //
 
 float TFunctional7(const Eigen::VectorXf& data) {
+    float result;
+    TFunctional7_batch(data, &result);
+    return result;
+}
+
+void TFunctional7_batch(const Eigen::MatrixXf& data, float *output,
+                        unsigned int approx_bins) {
     // Transform the domain from t to r
-    int median = findWeightedMedian(data);
-    int length_r = data.size() - median;
+    std::vector<int> medians(data.cols());
+    std::vector<int> offsets(data.cols() + 1);
+    offsets[0] = 0;
+    for (int column = 0; column < data.cols(); column++) {
+        medians[column] = findWeightedMedian(data.col(column));
+        offsets[column + 1] = offsets[column] + data.rows() - medians[column];
+    }
 
     // Extract data from the positive domain of r
-    Eigen::VectorXf data_r(data.tail(length_r));
+    std::vector<float> data_r(offsets.back());
+    for (int column = 0; column < data.cols(); column++) {
+        const float *tail = data.col(column).data() + medians[column];
+        std::copy(tail, tail + offsets[column + 1] - offsets[column],
+                  &data_r[offsets[column]]);
+    }
 
-    // Sorting the transformed data
-    qsort(data_r.data(), length_r, sizeof(float), compareFloat);
+    // Approximate the weighted median without sorting
+    if (approx_bins > 0) {
+        std::vector<float> weights(offsets.back());
+        for (size_t i = 0; i < weights.size(); i++)
+            weights[i] = std::sqrt(data_r[i]);
+        for (int column = 0; column < data.cols(); column++)
+            output[column] = approximateWeightedMedian(
+                &data_r[offsets[column]], &weights[offsets[column]],
+                offsets[column + 1] - offsets[column], approx_bins);
+        return;
+    }
+
+    // Sorting the transformed data of all columns at once
+    sortSegments(data_r.data(), NULL, offsets.data(), data.cols());
 
     // Weighted median
-    int index = findWeightedMedian(data_r.cwiseSqrt());
-    return data_r[index];
+    for (int column = 0; column < data.cols(); column++) {
+        Eigen::Map<Eigen::VectorXf> sorted(&data_r[offsets[column]],
+                                           offsets[column + 1] - offsets[column]);
+        int index = findWeightedMedian(sorted.cwiseSqrt());
+        output[column] = sorted[index];
+    }
 }
 
 
@@ -304,13 +686,35 @@ float PFunctional1(const Eigen::VectorXf& data) {
 //
 
 float PFunctional2(const Eigen::VectorXf& data) {
-    // Sorting the data
-    Eigen::VectorXf sorted(data);
-    qsort(sorted.data(), sorted.size(), sizeof(float), compareFloat);
+    float result;
+    PFunctional2_batch(data, &result);
+    return result;
+}
+
+void PFunctional2_batch(const Eigen::MatrixXf& data, float *output,
+                        unsigned int approx_bins) {
+    // Approximate the weighted median without sorting
+    if (approx_bins > 0) {
+        for (int column = 0; column < data.cols(); column++) {
+            const float *values = data.col(column).data();
+            output[column] = approximateWeightedMedian(values, values,
+                                                       data.rows(), approx_bins);
+        }
+        return;
+    }
+
+    // Sorting the data of all columns at once
+    Eigen::MatrixXf sorted(data);
+    std::vector<int> offsets(data.cols() + 1);
+    for (int column = 0; column <= data.cols(); column++)
+        offsets[column] = column * data.rows();
+    sortSegments(sorted.data(), NULL, offsets.data(), data.cols());
 
     // Find the weighted median
-    int median = findWeightedMedian(sorted);
-    return sorted[median];
+    for (int column = 0; column < data.cols(); column++) {
+        int median = findWeightedMedian(sorted.col(column));
+        output[column] = sorted(median, column);
+    }
 }
 
 
@@ -318,59 +722,69 @@ float PFunctional2(const Eigen::VectorXf& data) {
 // P3
 //
 
+struct PFunctional3_precalc_t {
+    int rows;
+    fftwf_plan plan;
+    Eigen::VectorXf linspace;
+};
+
 PFunctional3_precalc_t *PFunctional3_prepare(int rows) {
-    // Enable FFTW multithreading
-    fftw_init_threads();
-    fftw_plan_with_nthreads(omp_get_max_threads());
-
-    // Plan the DFT we'll need
-    float *data = (float*) malloc(sizeof(float)*rows);
-    fftwf_complex *fourier = (fftwf_complex*) fftwf_malloc(sizeof(fftw_complex) * rows);
-    fftwf_plan p = fftwf_plan_dft_r2c_1d(rows, data, fourier, FFTW_MEASURE);
-    assert(p != NULL);
-    fftwf_execute(p);
-    fftwf_destroy_plan(p);
+    PFunctional3_precalc_t *precalc = new PFunctional3_precalc_t;
+    precalc->rows = rows;
+
+    // Plan the DFT once, for all columns of this size
+    // NOTE: the FFTW planner isn't thread-safe, and transforms might be
+    //       prepared concurrently
+    // NOTE: the columns can start anywhere, so the plan mustn't rely on the
+    //       alignment of the arrays it's planned with
+    float *data = fftwf_alloc_real(rows);
+    fftwf_complex *fourier = fftwf_alloc_complex(rows / 2 + 1);
+#pragma omp critical (make_plan)
+    precalc->plan = fftwf_plan_dft_r2c_1d(rows, data, fourier,
+                                          FFTW_MEASURE | FFTW_UNALIGNED);
+    assert(precalc->plan != NULL);
     fftwf_free(fourier);
-    free(data);
+    fftwf_free(data);
+
+    precalc->linspace = Eigen::VectorXf(rows);
+    for (int p = 0; p < rows; p++)
+        precalc->linspace[p] = -1 + p * 2.0 / (rows - 1);
 
-    // Clean-up FFTW multithreading remnants
-    fftw_cleanup_threads();
+    return precalc;
+}
 
-    return NULL;
+float PFunctional3(const Eigen::VectorXf& data,
+                   const PFunctional3_precalc_t *precalc) {
+    return PFunctional3(data.data(), precalc);
 }
 
-float PFunctional3(const Eigen::VectorXf& data) {
+float PFunctional3(const float *data, const PFunctional3_precalc_t *precalc) {
     // Calculate the discrete Fourier transform
-    // TODO: we should only plan this once, given that we use the same array
-    fftwf_complex *fourier = (fftwf_complex*) fftwf_malloc(sizeof(fftw_complex) * data.size());
-    // NOTE: we can safely cast the const away, because in FFTW_ESTIMATE regime
-    //       the input data will be preserved
-    fftwf_plan p;
-#pragma omp critical (make_plan)
-    p = fftwf_plan_dft_r2c_1d(data.size(), (float*)data.data(), fourier, FFTW_ESTIMATE);
-    assert(p != NULL);
-    fftwf_execute(p);
+    // NOTE: we can safely cast the const away, because out-of-place
+    //       real-to-complex transforms preserve their input
+    int rows = precalc->rows;
+    std::vector<float> buffer(2 * (rows / 2 + 1));
+    fftwf_complex *fourier = reinterpret_cast<fftwf_complex *>(buffer.data());
+    fftwf_execute_dft_r2c(precalc->plan, const_cast<float *>(data), fourier);
 
     // Integrate
-    Eigen::VectorXf linspace(data.size());
-    Eigen::VectorXf modifier(data.size());
-    for (int p = 0; p < data.size()/2+1; p++) {
+    Eigen::VectorXf modifier(rows);
+    for (int p = 0; p < rows/2+1; p++) {
         modifier[p] =
-            pow(hypot(fourier[p][0] / data.size(), fourier[p][1] / data.size()), 4);
-        linspace[p] = -1 + p * 2.0 / (data.size() - 1);
+            pow(hypot(fourier[p][0] / rows, fourier[p][1] / rows), 4);
     }
-    for (int p = data.size()/2+1; p < data.size(); p++) {
+    for (int p = rows/2+1; p < rows; p++) {
         modifier[p] =
-            pow(hypot(fourier[data.size()-p][0] / data.size(), fourier[data.size()-p][1] / data.size()), 4);
-        linspace[p] = -1 + p * 2.0 / (data.size() - 1);
+            pow(hypot(fourier[rows-p][0] / rows, fourier[rows-p][1] / rows), 4);
     }
-    float sum = trapz(linspace, modifier);
-    fftwf_destroy_plan(p);
-    fftwf_free(fourier);
-    return sum;
+    return trapz(precalc->linspace, modifier);
 }
 
-void PFunctional3_destroy(PFunctional3_precalc_t *) { return; }
+void PFunctional3_destroy(PFunctional3_precalc_t *precalc) {
+#pragma omp critical (make_plan)
+    fftwf_destroy_plan(precalc->plan);
+    delete precalc;
+}
 
 
 //
@@ -395,3 +809,22 @@ float PFunctionalHermite(const Eigen::VectorXf& data,
     }
     return integral;
 }
+
+Eigen::VectorXf PFunctionalHermite_weights(int rows, unsigned int order,
+                                           int center) {
+    // Discretize the [-10, 10] domain to fit the column iterator
+    float stepsize_lower = 10.0 / center;
+    float stepsize_upper = 10.0 / (rows - 1 - center);
+
+    // Evaluate the Hermite function at every sample
+    Eigen::VectorXf weights(rows);
+    float z;
+    for (int p = 0; p < rows; p++) {
+        if (p < center)
+            z = p * stepsize_lower - 10;
+        else
+            z = (p - center) * stepsize_upper;
+        weights[p] = hermite_function(order, z);
+    }
+    return weights;
+}
@@ -15,6 +15,8 @@
 
 int findWeightedMedian(const Eigen::VectorXf& data);
 int findWeightedMedianSquared(const Eigen::VectorXf& data);
+float approximateWeightedMedian(const float *keys, const float *weights,
+                                int length, unsigned int bins);
 
 
 //
@@ -31,22 +33,39 @@ float TFunctional1(const Eigen::VectorXf& data);
 float TFunctional2(const Eigen::VectorXf& data);
 
 // T3, T4 and T5
+struct TFunctional345_fft_t;
 typedef struct {
     float *real;
     float *imag;
+    int rows;
+
+    // Batched FFT backend (NULL if the direct loop is used)
+    TFunctional345_fft_t *fft;
 } TFunctional345_precalc_t;
 TFunctional345_precalc_t *TFunctional3_prepare(int rows, int cols);
 TFunctional345_precalc_t *TFunctional4_prepare(int rows, int cols);
 TFunctional345_precalc_t *TFunctional5_prepare(int rows, int cols);
+void TFunctional345_prepare_fft(TFunctional345_precalc_t *precalc, int cols);
 float TFunctional345(const Eigen::VectorXf& data,
                      TFunctional345_precalc_t *precalc);
+void TFunctional345_batch(const Eigen::MatrixXf& data,
+                          TFunctional345_precalc_t *precalc, float *output);
 void TFunctional345_destroy(TFunctional345_precalc_t *precalc);
 
 // T6
+struct TFunctional6_precalc_t;
+TFunctional6_precalc_t *TFunctional6_prepare(int rows, int cols);
 float TFunctional6(const Eigen::VectorXf& data);
+void TFunctional6_batch(const Eigen::MatrixXf& data, float *output,
+                        unsigned int approx_bins = 0);
+void TFunctional6_incremental(const Eigen::MatrixXf& data,
+                              TFunctional6_precalc_t *precalc, float *output);
+void TFunctional6_destroy(TFunctional6_precalc_t *precalc);
 
 // T7
 float TFunctional7(const Eigen::VectorXf& data);
+void TFunctional7_batch(const Eigen::MatrixXf& data, float *output,
+                        unsigned int approx_bins = 0);
 
 
 //
@@ -58,15 +77,21 @@ float PFunctional1(const Eigen::VectorXf& data);
 
 // P2
 float PFunctional2(const Eigen::VectorXf& data);
+void PFunctional2_batch(const Eigen::MatrixXf& data, float *output,
+                        unsigned int approx_bins = 0);
 
 // P3
-typedef void PFunctional3_precalc_t;
+struct PFunctional3_precalc_t;
 PFunctional3_precalc_t *PFunctional3_prepare(int rows);
-float PFunctional3(const Eigen::VectorXf& data);
+float PFunctional3(const Eigen::VectorXf& data,
+                   const PFunctional3_precalc_t *precalc);
+float PFunctional3(const float *data, const PFunctional3_precalc_t *precalc);
 void PFunctional3_destroy(PFunctional3_precalc_t *precalc);
 
 // Hermite P-functionals
 float PFunctionalHermite(const Eigen::VectorXf& data,
                          unsigned int order, int center);
+Eigen::VectorXf PFunctionalHermite_weights(int rows, unsigned int order,
+                                           int center);
 
 #endif
@@ -0,0 +1,92 @@
+/*
+ * Configuration
+ */
+
+/* Standard library */
+#include <math.h>   /* for sin, cos */
+#include <stdio.h>  /* for printf, fprintf */
+#include <stdlib.h> /* for malloc, free */
+
+/* Local */
+#include "tracetransform.h"
+
+
+/*
+ * Main application
+ */
+
+#define ROWS 48
+#define COLS 40
+#define STRIDE 64 /* rows padded to a larger buffer, as decoders often do */
+
+/* Transform a synthetic image through the C interface, once as bytes and
+ * once as floats, and check both yield the same signatures */
+int main(void) {
+    unsigned char gray[ROWS * STRIDE];
+    float values[ROWS * STRIDE];
+    size_t row, col, rows, cols, i;
+    tt_plan *plan;
+    tt_status status;
+    float *first, *second;
+    float difference = 0;
+
+    if (tt_api_version() != TRACETRANSFORM_API_VERSION) {
+        fprintf(stderr, "Library version mismatch\n");
+        return 1;
+    }
+
+    for (row = 0; row < ROWS; row++) {
+        for (col = 0; col < COLS; col++) {
+            unsigned char value =
+                127 + 127 * sin(row / 5.0) * cos(col / 7.0);
+            gray[row * STRIDE + col] = value;
+            values[row * STRIDE + col] = value / 255.0f;
+        }
+    }
+
+    status = tt_plan_create("T0 T1 T2 P1 P2", 2, 0, &plan);
+    if (status != TT_OK) {
+        fprintf(stderr, "Could not create a plan: %s\n",
+                tt_status_string(status));
+        return 1;
+    }
+
+    /* Transform the bytes */
+    status = tt_execute(plan, gray, TT_UINT8, ROWS, COLS, STRIDE);
+    if (status != TT_OK) {
+        fprintf(stderr, "Could not transform the image: %s\n",
+                tt_plan_error(plan));
+        tt_plan_destroy(plan);
+        return 1;
+    }
+    tt_get_signature(plan, NULL, 0, &rows, &cols);
+    first = malloc(rows * cols * sizeof(float));
+    second = malloc(rows * cols * sizeof(float));
+    tt_get_signature(plan, first, rows * cols, NULL, NULL);
+
+    /* Transform the floats, reusing the pre-calculations */
+    status = tt_execute(plan, values, TT_FLOAT32, ROWS, COLS,
+                        STRIDE * sizeof(float));
+    if (status != TT_OK) {
+        fprintf(stderr, "Could not transform the image: %s\n",
+                tt_plan_error(plan));
+        tt_plan_destroy(plan);
+        return 1;
+    }
+    tt_get_signature(plan, second, rows * cols, NULL, NULL);
+
+    for (i = 0; i < rows * cols; i++)
+        difference = fmaxf(difference, fabsf(first[i] - second[i]));
+    printf("Signatures: %zux%zu, first value %f, largest difference %g\n",
+           rows, cols, first[0], difference);
+
+    /* Invalid strides get refused */
+    status = tt_execute(plan, gray, TT_UINT8, ROWS, COLS, COLS - 1);
+    printf("Invalid stride: %s (%s)\n", tt_status_string(status),
+           tt_plan_error(plan));
+
+    free(first);
+    free(second);
+    tt_plan_destroy(plan);
+    return (difference < 1e-4 && status == TT_INVALID_ARGUMENT) ? 0 : 1;
+}
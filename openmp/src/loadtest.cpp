@@ -0,0 +1,192 @@
+//
+// Configuration
+//
+
+// Standard library
+#include <unistd.h>   // for close
+#include <algorithm>  // for sort, min
+#include <atomic>     // for atomic
+#include <chrono>     // for steady_clock, duration
+#include <cstddef>    // for size_t
+#include <exception>  // for exception
+#include <functional> // for cref, ref
+#include <iomanip>    // for setprecision
+#include <iostream>   // for operator<<, ostream, etc
+#include <mutex>      // for mutex, lock_guard
+#include <string>     // for string
+#include <thread>     // for thread
+#include <vector>     // for vector
+
+// Boost
+#include <boost/program_options.hpp>
+
+// Local
+#include "logger.hpp"
+#include "protocol.hpp"
+#include "synthetic.hpp"
+
+
+//
+// Auxiliary
+//
+
+// Outcome of the requests issued by all clients
+struct Results {
+    Results() : rejected(0), failed(0) {}
+
+    std::mutex mutex;
+    std::vector<double> latencies;
+    size_t rejected, failed;
+};
+
+static double percentile(const std::vector<double> &sorted, double p) {
+    size_t index = std::min<size_t>(p * sorted.size(), sorted.size() - 1);
+    return sorted[index];
+}
+
+// Issue requests over a single connection until the shared budget runs out,
+// reconnecting whenever the service turns the connection away
+static void client(const std::string &socket, const Eigen::MatrixXi &image,
+                   unsigned int angle, const std::string &spec,
+                   std::atomic<long> &remaining, Results &results) {
+    int fd = -1;
+    Eigen::MatrixXf signatures;
+    std::string message;
+    while (remaining-- > 0) {
+        if (fd < 0 && (fd = connectSocket(socket)) < 0) {
+            std::lock_guard<std::mutex> lock(results.mutex);
+            results.failed++;
+            continue;
+        }
+
+        std::chrono::steady_clock::time_point start =
+            std::chrono::steady_clock::now();
+        ResponseStatus status = ResponseStatus::Failure;
+        if (sendRequest(fd, image, angle, spec))
+            status = receiveResponse(fd, signatures, message);
+        double latency = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+
+        std::lock_guard<std::mutex> lock(results.mutex);
+        if (status == ResponseStatus::OK) {
+            results.latencies.push_back(latency);
+        } else {
+            if (status == ResponseStatus::Busy)
+                results.rejected++;
+            else
+                results.failed++;
+            close(fd);
+            fd = -1;
+        }
+    }
+    if (fd >= 0)
+        close(fd);
+}
+
+
+//
+// Main application
+//
+
+// Measure the latency and throughput of a running service
+int main(int argc, char **argv) {
+    //
+    // Initialization
+    //
+
+    std::vector<std::string> tfunctionals, pfunctionals;
+
+    // Declare named options
+    boost::program_options::options_description desc("Allowed options");
+    desc.add_options()
+        ("help,h",
+            "produce help message")
+        ("socket,s",
+            boost::program_options::value<std::string>()
+                ->default_value("tracetransform.sock"),
+            "socket the service listens on")
+        ("t-functional,T",
+            boost::program_options::value<std::vector<std::string>>(
+                &tfunctionals)->required(),
+            "T-functionals")
+        ("p-functional,P",
+            boost::program_options::value<std::vector<std::string>>(
+                &pfunctionals),
+            "P-functionals")
+        ("angle,a",
+            boost::program_options::value<unsigned int>()
+                ->default_value(1),
+            "angle stepsize")
+        ("size",
+            boost::program_options::value<int>()->default_value(64),
+            "size of the (synthetic) images to transform")
+        ("concurrency,c",
+            boost::program_options::value<unsigned int>()->default_value(4),
+            "amount of concurrent connections")
+        ("requests,n",
+            boost::program_options::value<long>()->default_value(100),
+            "total amount of requests")
+    ;
+
+    // Parse the options
+    boost::program_options::variables_map vm;
+    try {
+        store(boost::program_options::command_line_parser(argc, argv)
+                  .options(desc)
+                  .run(),
+              vm);
+        if (vm.count("help")) {
+            std::cout << desc << std::endl;
+            return 0;
+        }
+        notify(vm);
+    }
+    catch (const std::exception &e) {
+        std::cerr << "Invalid usage: " << e.what() << std::endl;
+
+        std::cout << desc << std::endl;
+        return 1;
+    }
+
+
+    //
+    // Execution
+    //
+
+    Eigen::MatrixXi image =
+        generateImage(SyntheticPattern::Noise, vm["size"].as<int>(), 0);
+    std::string spec = formatSpec(tfunctionals, pfunctionals);
+    std::atomic<long> remaining(vm["requests"].as<long>());
+    Results results;
+
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    std::vector<std::thread> clients;
+    for (unsigned int c = 0; c < vm["concurrency"].as<unsigned int>(); c++)
+        clients.push_back(std::thread(
+            client, vm["socket"].as<std::string>(), std::cref(image),
+            vm["angle"].as<unsigned int>(), spec, std::ref(remaining),
+            std::ref(results)));
+    for (size_t c = 0; c < clients.size(); c++)
+        clients[c].join();
+    double elapsed = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start).count();
+
+    std::vector<double> &latencies = results.latencies;
+    std::sort(latencies.begin(), latencies.end());
+    clog(info) << "Completed " << latencies.size() << " request(s) in "
+               << elapsed << " s (" << results.rejected << " rejected, "
+               << results.failed << " failed)" << std::endl;
+    if (latencies.empty())
+        return 1;
+    clog(info) << "Throughput: " << latencies.size() / elapsed
+               << " requests/s" << std::endl;
+    clog(info) << std::fixed << std::setprecision(6) << "Latency: p50="
+               << percentile(latencies, 0.50) << " s, p90="
+               << percentile(latencies, 0.90) << " s, p99="
+               << percentile(latencies, 0.99) << " s, max="
+               << latencies.back() << " s" << std::endl;
+
+    return 0;
+}
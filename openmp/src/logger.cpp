@@ -9,7 +9,7 @@
 // Standard library
 #include <stddef.h> // for size_t
 #include <cassert>  // for assert
-#include <ctime>    // for localtime, strftime, time, etc
+#include <ctime>    // for localtime, strftime, time_t, etc
 #include <sstream>  // for stringstream
 
 // Null stream
@@ -18,22 +18,70 @@ std::ostream cnull(0);
 // Logger instantiation
 Logger logger;
 
+// Whether the logger accepts records (it doesn't before construction or after
+// destruction, which threads exiting late might run into)
+static std::atomic<bool> accepting(false);
+
 
 //
 // Construction and destruction
 //
-//
 
-Logger::Logger() : _buf(std::cout.rdbuf()) {
-    // Replace the default stream buffer
-    // TODO: do this for cerr as well, and use it for warnings and errors
-    std::cout.flush();
-    std::cout.rdbuf(&_buf);
+Logger::Logger()
+    : _head(new Node()), _submitted(0), _written(0), _started(false),
+      _running(false), _sleeping(false), _output(NULL) {
+    _head.load()->next = NULL;
+    _tail = _head;
 
     // Default configuration
     settings.threshold = info;
     settings.prefix_timestamp = false;
     settings.prefix_level = false;
+
+    accepting = true;
+}
+
+Logger::~Logger() {
+    accepting = false;
+    stop();
+    delete _tail;
+}
+
+void Logger::start() {
+    if (_started)
+        return;
+
+    // Order direct output after the queued records
+    // TODO: do this for cerr as well, and use it for warnings and errors
+    std::cout.flush();
+    _output = std::cout.rdbuf();
+    _buf.wrap(_output);
+    std::cout.rdbuf(&_buf);
+
+    _running = true;
+    _thread = std::thread(&Logger::run, this);
+    _started = true;
+}
+
+void Logger::stop() {
+    if (!_started)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _running = false;
+        _wakeup.notify_one();
+    }
+    _thread.join();
+    _started = false;
+
+    std::cout.rdbuf(_output);
+}
+
+recordbuf::~recordbuf() {
+    // Don't lose unfinished lines
+    if (_open && !_text.empty())
+        submit();
 }
 
 
@@ -41,44 +89,186 @@ Logger::Logger() : _buf(std::cout.rdbuf()) {
 // Logging
 //
 
-// TODO: breaks when doing clog(...) << "foo \n bar"
 std::ostream &Logger::log(LogLevel level) {
     if (level <= settings.threshold) {
-        // Manage prefixes
-        char last_char = _buf.last_char();
-        if (last_char == '\r' || last_char == '\n') {
-            if (settings.prefix_timestamp)
-                std::cout << timestamp() << "  ";
-            if (settings.prefix_level || level <= warning)
-                std::cout << prefix(level) << "\t";
-        }
-
-        return std::cout;
+        static thread_local recordbuf buf;
+        static thread_local std::ostream stream(&buf);
+        buf.begin(level);
+        return stream;
     } else {
         return cnull;
     }
 }
 
+recordbuf::int_type recordbuf::overflow(int_type c) {
+    if (c == traits_type::eof())
+        return traits_type::not_eof(c);
+    if (c == '\n')
+        submit();
+    else
+        _text += (char)c;
+    return c;
+}
+
+std::streamsize recordbuf::xsputn(const char *s, std::streamsize n) {
+    for (std::streamsize i = 0; i < n; i++) {
+        if (s[i] == '\n')
+            submit();
+        else
+            _text += s[i];
+    }
+    return n;
+}
+
+void recordbuf::submit() {
+    // Lines which weren't started through the logger inherit the last level
+    LogRecord record;
+    record.level = _level;
+    record.time = _open ? _time : std::chrono::system_clock::now();
+    record.text.swap(_text);
+    _open = false;
+
+    if (accepting)
+        logger.submit(record);
+}
+
+void Logger::submit(LogRecord &record) {
+    LogLevel level = record.level;
+
+    // Write the record right away if there's no background thread
+    if (!_started) {
+        std::string line = format(record);
+        std::lock_guard<std::mutex> lock(_output_mutex);
+        std::cout.write(line.data(), line.size());
+        if (level <= warning)
+            std::cout.flush();
+        return;
+    }
+
+    // Enqueue the record
+    Node *node = new Node();
+    node->next.store(NULL, std::memory_order_relaxed);
+    node->record.level = record.level;
+    node->record.time = record.time;
+    node->record.text.swap(record.text);
+    Node *previous = _head.exchange(node, std::memory_order_acq_rel);
+    previous->next.store(node, std::memory_order_seq_cst);
+    _submitted++;
+
+    // NOTE: the consumer announces it's going to sleep before checking the
+    //       queue a last time, so either it sees the record or we see it
+    //       sleeping, and notify it while it waits (holding the mutex)
+    if (level <= warning) {
+        flush();
+    } else if (_sleeping.load(std::memory_order_seq_cst)) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _wakeup.notify_one();
+    }
+}
+
+void Logger::flush() {
+    uint64_t target = _submitted;
+    if (_written >= target || !_running)
+        return;
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _wakeup.notify_one();
+    _flushed.wait(lock, [&] { return _written >= target || !_running; });
+}
+
+
+//
+// Background formatting
+//
+
+void Logger::run() {
+    while (true) {
+        bool running = _running;
+
+        // Write all queued records
+        Node *next;
+        while ((next = _tail->next.load(std::memory_order_acquire)) != NULL) {
+            std::string line = format(next->record);
+            {
+                std::lock_guard<std::mutex> lock(_output_mutex);
+                _output->sputn(line.data(), line.size());
+            }
+
+            // The dequeued node becomes the new sentinel
+            delete _tail;
+            _tail = next;
+            _written++;
+        }
+        {
+            std::lock_guard<std::mutex> lock(_output_mutex);
+            _output->pubsync();
+        }
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _flushed.notify_all();
+        }
+        if (!running)
+            break;
+
+        // Sleep until a producer submits a record, or the logger stops
+        std::unique_lock<std::mutex> lock(_mutex);
+        _sleeping.store(true, std::memory_order_seq_cst);
+        _wakeup.wait(lock, [this] {
+            return _tail->next.load(std::memory_order_seq_cst) != NULL ||
+                   !_running;
+        });
+        _sleeping = false;
+    }
+}
+
+passbuf::int_type passbuf::overflow(int_type c) {
+    logger.flush();
+    std::lock_guard<std::mutex> lock(logger._output_mutex);
+    return _buf->sputc(c);
+}
+
+std::streamsize passbuf::xsputn(const char *s, std::streamsize n) {
+    logger.flush();
+    std::lock_guard<std::mutex> lock(logger._output_mutex);
+    return _buf->sputn(s, n);
+}
+
+int passbuf::sync() {
+    std::lock_guard<std::mutex> lock(logger._output_mutex);
+    return _buf->pubsync();
+}
+
 
 //
 // Auxiliary
 //
 
-std::string Logger::timestamp() {
-    time_t datetime;
-    time(&datetime);
+std::string Logger::timestamp(std::chrono::system_clock::time_point time) {
+    time_t datetime = std::chrono::system_clock::to_time_t(time);
 
     std::string buffer;
     buffer.resize(32);
 
+    struct tm local;
     size_t len = strftime(&buffer[0], buffer.length(), "%Y-%m-%dT%H:%M:%S%z",
-                          localtime(&datetime));
+                          localtime_r(&datetime, &local));
     assert(len);
     buffer.resize(len);
 
     return buffer;
 }
 
+std::string Logger::format(const LogRecord &record) const {
+    std::string line;
+    if (settings.prefix_timestamp)
+        line += timestamp(record.time) + "  ";
+    if (settings.prefix_level || record.level <= warning)
+        line += prefix(record.level) + "\t";
+    line += record.text;
+    line += '\n';
+    return line;
+}
+
 std::string Logger::prefix(LogLevel level) {
     switch (level) {
     case fatal:
@@ -7,8 +7,14 @@
 #define _TRACETRANSFORM_LOGGER_
 
 // Standard library
-#include <iostream> // for streambuf, ostream, etc
-#include <string>   // for string
+#include <stdint.h>           // for uint64_t
+#include <atomic>             // for atomic
+#include <chrono>             // for system_clock
+#include <condition_variable> // for condition_variable
+#include <iostream>           // for streambuf, ostream, etc
+#include <mutex>              // for mutex
+#include <string>             // for string
+#include <thread>             // for thread
 
 
 //
@@ -25,35 +31,75 @@ enum LogLevel {
     trace
 };
 
-// Streambuffer
-class keepbuf : public std::streambuf {
+// Single line of output, stamped when it was started
+struct LogRecord {
+    LogLevel level;
+    std::chrono::system_clock::time_point time;
+    std::string text;
+};
+
+// Streambuffer collecting the lines of a single thread into records
+class recordbuf : public std::streambuf {
   public:
-    keepbuf(std::streambuf *buf) : _buf(buf), _last_char('\n') {
-        // traits_type::eof would be better, but this fits our use case
-        // no buffering, overflow on every char
-        setp(0, 0);
+    recordbuf() : _open(false), _level(info) {}
+    ~recordbuf();
+
+    // Start a record, unless the previous line hasn't been finished yet
+    void begin(LogLevel level) {
+        if (!_open) {
+            _open = true;
+            _level = level;
+            _time = std::chrono::system_clock::now();
+        }
     }
-    char last_char() const { return _last_char; }
 
-    virtual int_type overflow(int_type c) {
-        _buf->sputc(c);
-        _buf->pubsync();
-        _last_char = c;
-        return c;
-    }
+  protected:
+    virtual int_type overflow(int_type c);
+    virtual std::streamsize xsputn(const char *s, std::streamsize n);
+
+  private:
+    void submit();
+
+    std::string _text;
+    bool _open;
+    LogLevel _level;
+    std::chrono::system_clock::time_point _time;
+};
+
+// Streambuffer for direct output, ordered after all pending records
+class passbuf : public std::streambuf {
+  public:
+    passbuf() : _buf(NULL) {}
+
+    void wrap(std::streambuf *buf) { _buf = buf; }
+
+  protected:
+    virtual int_type overflow(int_type c);
+    virtual std::streamsize xsputn(const char *s, std::streamsize n);
+    virtual int sync();
 
   private:
     std::streambuf *_buf;
-    char _last_char;
 };
 
 // Null stream
 extern std::ostream cnull;
 
 // Logger
+// NOTE: once started, records are queued without locking and written by a
+//       background thread. Warnings and errors are waited for, so they aren't
+//       lost when the program aborts afterwards. Until then (e.g. when
+//       embedded in another process), records are written synchronously.
 class Logger {
   public:
     Logger();
+    ~Logger();
+
+    // Start writing records from a background thread, routing std::cout
+    // through the logger to keep direct output ordered after the records, or
+    // stop doing so (which happens at destruction otherwise)
+    void start();
+    void stop();
 
     // Configuration
     struct {
@@ -64,14 +110,39 @@ class Logger {
 
     // Logging
     std::ostream &log(LogLevel level);
+    void submit(LogRecord &record);
+
+    // Wait until all submitted records have been written
+    void flush();
 
   private:
+    friend class passbuf;
+
     // Auxiliary
-    static std::string timestamp();
+    static std::string timestamp(std::chrono::system_clock::time_point time);
     static std::string prefix(LogLevel level);
-
-    // Replacement stream buffer
-    keepbuf _buf;
+    std::string format(const LogRecord &record) const;
+
+    // Background formatting
+    void run();
+
+    // Multiple-producer single-consumer queue
+    struct Node {
+        std::atomic<Node *> next;
+        LogRecord record;
+    };
+    std::atomic<Node *> _head;
+    Node *_tail;
+
+    std::atomic<uint64_t> _submitted, _written;
+    std::atomic<bool> _started, _running, _sleeping;
+    std::mutex _mutex, _output_mutex;
+    std::condition_variable _wakeup, _flushed;
+
+    // Output streams
+    std::streambuf *_output;
+    passbuf _buf;
+    std::thread _thread;
 };
 extern Logger logger;
 
@@ -0,0 +1,231 @@
+//
+// Configuration
+//
+
+// Header include
+#include "memory.hpp"
+
+// Standard library
+#include <errno.h>        // for EINVAL, ENOMEM
+#include <malloc.h>       // for malloc_usable_size, mallinfo2
+#include <sys/resource.h> // for getrusage, rusage
+#include <algorithm>      // for max
+#include <atomic>         // for atomic
+#include <iomanip>        // for setprecision
+#include <sstream>        // for stringstream
+
+// Only glibc lets the allocation functions be replaced while still exposing
+// the original implementation
+#if defined(__GLIBC__) && !defined(TRACETRANSFORM_NO_MEMORY_HOOKS)
+#define TRACETRANSFORM_MEMORY_HOOKS
+#endif
+
+
+//
+// Accounting
+//
+
+namespace {
+
+// Whether allocations get accounted for at all, which is only worth the
+// contended atomics when profiling or enforcing a memory budget
+std::atomic<bool> tracking(false);
+
+std::atomic<int64_t> usage(0), peak(0);
+
+// NOTE: the initial-exec model keeps TLS accesses from allocating, which
+//       would recurse into the hooks
+__thread int64_t thread_usage __attribute__((tls_model("initial-exec"))) = 0;
+__thread int64_t thread_peak __attribute__((tls_model("initial-exec"))) = 0;
+
+#ifdef TRACETRANSFORM_MEMORY_HOOKS
+
+inline void allocated(void *ptr) {
+    if (ptr == NULL || !tracking.load(std::memory_order_relaxed))
+        return;
+    int64_t size = malloc_usable_size(ptr);
+
+    int64_t current =
+        usage.fetch_add(size, std::memory_order_relaxed) + size;
+    int64_t maximum = peak.load(std::memory_order_relaxed);
+    while (current > maximum &&
+           !peak.compare_exchange_weak(maximum, current,
+                                       std::memory_order_relaxed))
+        ;
+
+    thread_usage += size;
+    if (thread_usage > thread_peak)
+        thread_peak = thread_usage;
+}
+
+inline void released(void *ptr) {
+    if (ptr == NULL || !tracking.load(std::memory_order_relaxed))
+        return;
+    int64_t size = malloc_usable_size(ptr);
+    usage.fetch_sub(size, std::memory_order_relaxed);
+    thread_usage -= size;
+}
+
+#endif
+
+}
+
+
+//
+// Allocation hooks
+//
+
+#ifdef TRACETRANSFORM_MEMORY_HOOKS
+
+extern "C" {
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+void *__libc_valloc(size_t size);
+void *__libc_pvalloc(size_t size);
+void __libc_free(void *ptr);
+
+void *malloc(size_t size) __THROW {
+    void *ptr = __libc_malloc(size);
+    allocated(ptr);
+    return ptr;
+}
+
+void *calloc(size_t count, size_t size) __THROW {
+    void *ptr = __libc_calloc(count, size);
+    allocated(ptr);
+    return ptr;
+}
+
+void *realloc(void *ptr, size_t size) __THROW {
+    // The original block is gone whenever realloc succeeds, or frees it
+    bool tracked = tracking.load(std::memory_order_relaxed);
+    size_t previous = (tracked && ptr != NULL) ? malloc_usable_size(ptr) : 0;
+    void *result = __libc_realloc(ptr, size);
+    if (tracked && (result != NULL || size == 0)) {
+        usage.fetch_sub(previous, std::memory_order_relaxed);
+        thread_usage -= previous;
+        allocated(result);
+    }
+    return result;
+}
+
+void *memalign(size_t alignment, size_t size) __THROW {
+    void *ptr = __libc_memalign(alignment, size);
+    allocated(ptr);
+    return ptr;
+}
+
+void *aligned_alloc(size_t alignment, size_t size) __THROW {
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void **ptr, size_t alignment, size_t size) __THROW {
+    if (alignment % sizeof(void *) != 0 ||
+        (alignment & (alignment - 1)) != 0 || alignment == 0)
+        return EINVAL;
+    void *result = memalign(alignment, size);
+    if (result == NULL)
+        return ENOMEM;
+    *ptr = result;
+    return 0;
+}
+
+void *valloc(size_t size) __THROW {
+    void *ptr = __libc_valloc(size);
+    allocated(ptr);
+    return ptr;
+}
+
+void *pvalloc(size_t size) __THROW {
+    void *ptr = __libc_pvalloc(size);
+    allocated(ptr);
+    return ptr;
+}
+
+void free(void *ptr) __THROW {
+    released(ptr);
+    __libc_free(ptr);
+}
+
+}
+
+#endif
+
+
+//
+// Module definitions
+//
+
+void trackMemory() {
+#ifdef TRACETRANSFORM_MEMORY_HOOKS
+    if (tracking)
+        return;
+
+    // Start from what the allocator holds already, for blocks allocated
+    // before to be released without the usage dropping below zero
+#if __GLIBC_PREREQ(2, 33)
+    struct mallinfo2 info = mallinfo2();
+#else
+    struct mallinfo info = mallinfo();
+#endif
+    usage = (int64_t)info.uordblks + (int64_t)info.hblkhd;
+    peak = usage.load();
+    tracking = true;
+#endif
+}
+
+bool memoryTracked() {
+#ifdef TRACETRANSFORM_MEMORY_HOOKS
+    return tracking;
+#else
+    return false;
+#endif
+}
+
+size_t heapUsage() { return std::max<int64_t>(usage, 0); }
+
+size_t heapPeak() { return std::max<int64_t>(peak, 0); }
+
+void resetHeapPeak() { peak = usage.load(); }
+
+size_t peakResidentSize() {
+    struct rusage resources;
+    if (getrusage(RUSAGE_SELF, &resources) != 0)
+        return 0;
+    return resources.ru_maxrss * (size_t)1024; // reported in KiB
+}
+
+std::string formatBytes(size_t bytes) {
+    const char *units[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+    double value = bytes;
+    size_t unit = 0;
+    while (value >= 1024 && unit < sizeof(units) / sizeof(units[0]) - 1) {
+        value /= 1024;
+        unit++;
+    }
+
+    std::stringstream ss;
+    if (unit == 0)
+        ss << bytes << " " << units[unit];
+    else
+        ss << std::fixed << std::setprecision(1) << value << " "
+           << units[unit];
+    return ss.str();
+}
+
+MemoryScope::MemoryScope()
+    : _base(thread_usage), _outer_peak(thread_peak) {
+    thread_peak = thread_usage;
+}
+
+MemoryScope::~MemoryScope() {
+    // Enclosing scopes should still see the peak of this one
+    thread_peak = std::max(thread_peak, _outer_peak);
+}
+
+size_t MemoryScope::peak() const {
+    return std::max<int64_t>(thread_peak - _base, 0);
+}
@@ -0,0 +1,55 @@
+//
+// Configuration
+//
+
+// Include guard
+#ifndef _TRACETRANSFORM_MEMORY_
+#define _TRACETRANSFORM_MEMORY_
+
+// Standard library
+#include <stdint.h> // for int64_t
+#include <cstddef>  // for size_t
+#include <string>   // for string
+
+
+//
+// Module definitions
+//
+
+// Heap accounting
+// NOTE: allocations are tracked by replacing the C allocation functions,
+//       which Eigen, the C++ runtime and FFTW all end up calling. This only
+//       works on glibc, and not together with the address sanitizer.
+// NOTE: the functions only account allocations once tracking has been
+//       started, since that costs contended atomics on every allocation
+void trackMemory();
+bool memoryTracked();
+
+// Bytes allocated by the process, currently and at most since the last reset
+size_t heapUsage();
+size_t heapPeak();
+void resetHeapPeak();
+
+// Peak resident set size of the process, as reported by the kernel
+size_t peakResidentSize();
+
+// Human-readable amount of bytes (e.g. "12.3 MiB")
+std::string formatBytes(size_t bytes);
+
+// Scoped high-water mark of the allocations made by the calling thread
+// NOTE: memory freed by another thread than the one which allocated it lowers
+//       the usage of the freeing thread, so only scopes which allocate and
+//       release their own buffers are accurate
+class MemoryScope {
+  public:
+    MemoryScope();
+    ~MemoryScope();
+
+    // Bytes allocated on top of what the thread held when entering the scope
+    size_t peak() const;
+
+  private:
+    int64_t _base, _outer_peak;
+};
+
+#endif
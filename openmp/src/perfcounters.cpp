@@ -0,0 +1,129 @@
+//
+// Configuration
+//
+
+// Header include
+#include "perfcounters.hpp"
+
+// Standard library
+#include <atomic>             // for atomic
+#ifdef __linux__
+#include <linux/perf_event.h> // for perf_event_attr, PERF_*
+#include <sys/syscall.h>      // for SYS_perf_event_open
+#include <unistd.h>           // for syscall, read, close
+#include <string.h>           // for memset
+#endif
+
+
+//
+// Auxiliary
+//
+
+namespace {
+
+const char *names[PerfCounterCount] = {"cycles", "instructions", "LLC misses",
+                                       "branch misses", "dTLB misses"};
+
+// Bitmask of the events any thread managed to open
+std::atomic<unsigned int> available(0);
+
+#ifdef __linux__
+
+struct PerfEvent {
+    uint32_t type;
+    uint64_t config;
+};
+
+#define CACHE_READ_MISS(cache)                                                 \
+    ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) |                            \
+     (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+const PerfEvent events[PerfCounterCount] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_LL)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_DTLB)}};
+
+// Group of counters of a single thread, read at once through its leader
+class PerfGroup {
+  public:
+    PerfGroup() : _leader(-1), _members(0) {
+        for (int counter = 0; counter < PerfCounterCount; counter++) {
+            perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = events[counter].type;
+            attr.config = events[counter].config;
+            attr.read_format = PERF_FORMAT_GROUP |
+                               PERF_FORMAT_TOTAL_TIME_ENABLED |
+                               PERF_FORMAT_TOTAL_TIME_RUNNING;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+
+            // Count the calling thread, on any CPU
+            int fd = syscall(SYS_perf_event_open, &attr, 0, -1, _leader, 0);
+            if (fd < 0)
+                continue;
+            if (_leader < 0)
+                _leader = fd;
+            _fds[_members] = fd;
+            _order[_members++] = counter;
+            available |= 1u << counter;
+        }
+    }
+
+    ~PerfGroup() {
+        for (int i = 0; i < _members; i++)
+            close(_fds[i]);
+    }
+
+    bool read(uint64_t values[PerfCounterCount]) const {
+        if (_leader < 0)
+            return false;
+        uint64_t buffer[3 + PerfCounterCount];
+        if (::read(_leader, buffer, sizeof(buffer)) <
+            (ssize_t)(3 * sizeof(uint64_t)))
+            return false;
+
+        // Extrapolate when the kernel had to multiplex the counters
+        uint64_t enabled = buffer[1], running = buffer[2];
+        double scale = (running > 0) ? (double)enabled / running : 0;
+
+        for (int counter = 0; counter < PerfCounterCount; counter++)
+            values[counter] = 0;
+        for (uint64_t i = 0; i < buffer[0] && i < (uint64_t)_members; i++)
+            values[_order[i]] = buffer[3 + i] * scale;
+        return true;
+    }
+
+  private:
+    int _leader, _members;
+    int _fds[PerfCounterCount];
+    int _order[PerfCounterCount];
+};
+
+#endif
+
+}
+
+
+//
+// Module definitions
+//
+
+const char *perfCounterName(int counter) { return names[counter]; }
+
+bool readPerfCounters(uint64_t values[PerfCounterCount]) {
+#ifdef __linux__
+    static thread_local PerfGroup group;
+    return group.read(values);
+#else
+    (void)values;
+    return false;
+#endif
+}
+
+bool perfCounterAvailable(int counter) {
+    return (available & (1u << counter)) != 0;
+}
@@ -0,0 +1,37 @@
+//
+// Configuration
+//
+
+// Include guard
+#ifndef _TRACETRANSFORM_PERFCOUNTERS_
+#define _TRACETRANSFORM_PERFCOUNTERS_
+
+// Standard library
+#include <stdint.h> // for uint64_t
+
+
+//
+// Module definitions
+//
+
+// Hardware events, counted in user space
+enum PerfCounter {
+    Cycles,
+    Instructions,
+    LLCMisses,
+    BranchMisses,
+    DTLBMisses,
+    PerfCounterCount
+};
+
+const char *perfCounterName(int counter);
+
+// Read the counters of the calling thread, opening them on first use
+// NOTE: events which the host cannot count read as zero, check their
+//       availability with perfCounterAvailable
+bool readPerfCounters(uint64_t values[PerfCounterCount]);
+
+// Whether an event could be counted by any thread so far
+bool perfCounterAvailable(int counter);
+
+#endif
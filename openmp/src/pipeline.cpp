@@ -0,0 +1,261 @@
+//
+// Configuration
+//
+
+// Header include
+#include "pipeline.hpp"
+
+// Standard library
+#include <cmath>   // for hypot, fabs
+#include <cstddef> // for size_t
+#include <utility> // for pair
+
+
+//
+// Auxiliary
+//
+
+// Rather than switching on the functional for every column and passing the
+// pre-calculations around as void pointers, the set of functionals is a type
+// here. Each stage is a kernel which gets inlined into one fused loop body,
+// quantities shared between stages (like the weighted median) are only
+// computed if a stage requires them, and the integrals are expressed as Eigen
+// reductions so they vectorize.
+
+template <typename Derived>
+inline int weightedMedian(const Eigen::MatrixBase<Derived> &data) {
+    float sum = data.sum();
+    float integral = 0;
+    for (int i = 0; i < data.size(); i++) {
+        integral += data[i];
+        if (2 * integral >= sum)
+            return i;
+    }
+    return data.size() - 1;
+}
+
+typedef Eigen::Map<const Eigen::VectorXf> ColumnMap;
+
+
+//
+// T-functional pipelines
+//
+
+TPipelineContext::TPipelineContext(int rows)
+    : ramp(Eigen::VectorXf::LinSpaced(rows, 0, rows - 1)),
+      ramp_squared(ramp.cwiseProduct(ramp)) {}
+
+// A column with the quantities shared between stages
+struct TColumn {
+    TColumn(const float *_data, int rows)
+        : data(_data, rows), median(0), squaredmedian(0) {}
+
+    ColumnMap data;
+    int median;        // for T1 and T2
+    int squaredmedian; // for T3, T4 and T5
+};
+
+// Kernels
+template <TFunctional F> struct TKernel;
+
+template <> struct TKernel<TFunctional::Radon> {
+    static const bool median = false, squaredmedian = false;
+    static inline float apply(const TColumn &column, const TPipelineContext &,
+                              size_t) {
+        return column.data.sum();
+    }
+};
+
+template <> struct TKernel<TFunctional::T1> {
+    static const bool median = true, squaredmedian = false;
+    static inline float apply(const TColumn &column,
+                              const TPipelineContext &context, size_t) {
+        int length = column.data.size() - column.median;
+        return column.data.segment(column.median, length)
+            .dot(context.ramp.head(length));
+    }
+};
+
+template <> struct TKernel<TFunctional::T2> {
+    static const bool median = true, squaredmedian = false;
+    static inline float apply(const TColumn &column,
+                              const TPipelineContext &context, size_t) {
+        int length = column.data.size() - column.median;
+        return column.data.segment(column.median, length)
+            .dot(context.ramp_squared.head(length));
+    }
+};
+
+struct TKernel345 {
+    static const bool median = false, squaredmedian = true;
+    static inline float apply(const TColumn &column,
+                              const TPipelineContext &context, size_t stage) {
+        // From r1 = 1, since exp(i*log(0)) == 0
+        const TFunctional345_precalc_t *precalc = context.precalcs[stage];
+        int length = column.data.size() - column.squaredmedian - 1;
+        if (length <= 0)
+            return 0;
+        Eigen::VectorBlock<const ColumnMap> data =
+            column.data.segment(column.squaredmedian + 1, length);
+        float integral_real = ColumnMap(precalc->real + 1, length).dot(data);
+        float integral_imag = ColumnMap(precalc->imag + 1, length).dot(data);
+        return hypot(integral_real, integral_imag);
+    }
+};
+template <> struct TKernel<TFunctional::T3> : TKernel345 {};
+template <> struct TKernel<TFunctional::T4> : TKernel345 {};
+template <> struct TKernel<TFunctional::T5> : TKernel345 {};
+
+// Requirements of a set of stages
+template <TFunctional... Fs> struct TRequirements;
+template <> struct TRequirements<> {
+    static const bool median = false, squaredmedian = false;
+};
+template <TFunctional F, TFunctional... Fs> struct TRequirements<F, Fs...> {
+    static const bool median =
+        TKernel<F>::median || TRequirements<Fs...>::median;
+    static const bool squaredmedian =
+        TKernel<F>::squaredmedian || TRequirements<Fs...>::squaredmedian;
+};
+
+// Unrolled application of all stages
+template <size_t I, TFunctional... Fs> struct TStages;
+template <size_t I> struct TStages<I> {
+    static inline void apply(const TColumn &, const TPipelineContext &,
+                             float *const *, int) {}
+};
+template <size_t I, TFunctional F, TFunctional... Fs>
+struct TStages<I, F, Fs...> {
+    static inline void apply(const TColumn &column,
+                             const TPipelineContext &context,
+                             float *const *outputs, int c) {
+        outputs[I][c] = TKernel<F>::apply(column, context, I);
+        TStages<I + 1, Fs...>::apply(column, context, outputs, c);
+    }
+};
+
+template <TFunctional... Fs>
+void traceTPipeline(const Eigen::MatrixXf &image,
+                    const TPipelineContext &context, float *const *outputs) {
+    for (int c = 0; c < image.cols(); c++) {
+        TColumn column(image.col(c).data(), image.rows());
+
+        // Transform the domain from t to r (or r1)
+        if (TRequirements<Fs...>::median)
+            column.median = weightedMedian(column.data);
+        if (TRequirements<Fs...>::squaredmedian)
+            column.squaredmedian = weightedMedian(column.data.cwiseSqrt());
+
+        TStages<0, Fs...>::apply(column, context, outputs, c);
+    }
+}
+
+TPipeline findTPipeline(const std::vector<TFunctional> &functionals) {
+    typedef TFunctional T;
+    static const std::vector<std::pair<std::vector<T>, TPipeline>> pipelines{
+        {{}, traceTPipeline<>},
+        {{T::Radon}, traceTPipeline<T::Radon>},
+        {{T::T1}, traceTPipeline<T::T1>},
+        {{T::T2}, traceTPipeline<T::T2>},
+        {{T::T1, T::T2}, traceTPipeline<T::T1, T::T2>},
+        {{T::Radon, T::T1, T::T2}, traceTPipeline<T::Radon, T::T1, T::T2>},
+        {{T::T3}, traceTPipeline<T::T3>},
+        {{T::T4}, traceTPipeline<T::T4>},
+        {{T::T5}, traceTPipeline<T::T5>},
+        {{T::T3, T::T4, T::T5}, traceTPipeline<T::T3, T::T4, T::T5>},
+        {{T::T1, T::T2, T::T3, T::T4, T::T5},
+         traceTPipeline<T::T1, T::T2, T::T3, T::T4, T::T5>},
+        {{T::Radon, T::T1, T::T2, T::T3, T::T4, T::T5},
+         traceTPipeline<T::Radon, T::T1, T::T2, T::T3, T::T4, T::T5>}};
+
+    for (size_t i = 0; i < pipelines.size(); i++) {
+        if (pipelines[i].first == functionals)
+            return pipelines[i].second;
+    }
+    return NULL;
+}
+
+
+//
+// P-functional pipelines
+//
+
+PPipelineContext::PPipelineContext(
+    int rows, const std::vector<PFunctionalWrapper> &stages)
+    : weights(stages.size()), precalcs(stages.size(), NULL) {
+    for (size_t p = 0; p < stages.size(); p++) {
+        if (stages[p].functional == PFunctional::Hermite)
+            weights[p] = PFunctionalHermite_weights(
+                rows, *stages[p].arguments.order, *stages[p].arguments.center);
+    }
+}
+
+// Kernels
+template <PFunctional F> struct PKernel;
+
+template <> struct PKernel<PFunctional::P1> {
+    static inline float apply(const ColumnMap &data, const PPipelineContext &,
+                              size_t) {
+        int length = data.size() - 1;
+        return (data.tail(length) - data.head(length)).cwiseAbs().sum();
+    }
+};
+
+template <> struct PKernel<PFunctional::P3> {
+    static inline float apply(const ColumnMap &data,
+                              const PPipelineContext &context, size_t stage) {
+        return PFunctional3(data.data(), context.precalcs[stage]);
+    }
+};
+
+template <> struct PKernel<PFunctional::Hermite> {
+    static inline float apply(const ColumnMap &data,
+                              const PPipelineContext &context, size_t stage) {
+        return data.dot(context.weights[stage]);
+    }
+};
+
+// Unrolled application of all stages
+template <size_t I, PFunctional... Fs> struct PStages;
+template <size_t I> struct PStages<I> {
+    static inline void apply(const ColumnMap &, const PPipelineContext &,
+                             float *const *, int) {}
+};
+template <size_t I, PFunctional F, PFunctional... Fs>
+struct PStages<I, F, Fs...> {
+    static inline void apply(const ColumnMap &data,
+                             const PPipelineContext &context,
+                             float *const *outputs, int c) {
+        outputs[I][c] = PKernel<F>::apply(data, context, I);
+        PStages<I + 1, Fs...>::apply(data, context, outputs, c);
+    }
+};
+
+template <PFunctional... Fs>
+void tracePPipeline(const Eigen::MatrixXf &sinogram,
+                    const PPipelineContext &context, float *const *outputs,
+                    int first, int last) {
+    for (int c = first; c < last; c++) {
+        ColumnMap data(sinogram.col(c).data(), sinogram.rows());
+        PStages<0, Fs...>::apply(data, context, outputs, c);
+    }
+}
+
+PPipeline findPPipeline(const std::vector<PFunctional> &functionals) {
+    typedef PFunctional P;
+    static const std::vector<std::pair<std::vector<P>, PPipeline>> pipelines{
+        {{}, tracePPipeline<>},
+        {{P::P1}, tracePPipeline<P::P1>},
+        {{P::P3}, tracePPipeline<P::P3>},
+        {{P::P1, P::P3}, tracePPipeline<P::P1, P::P3>},
+        {{P::Hermite}, tracePPipeline<P::Hermite>},
+        {{P::Hermite, P::Hermite}, tracePPipeline<P::Hermite, P::Hermite>},
+        {{P::Hermite, P::Hermite, P::Hermite},
+         tracePPipeline<P::Hermite, P::Hermite, P::Hermite>}};
+
+    for (size_t i = 0; i < pipelines.size(); i++) {
+        if (pipelines[i].first == functionals)
+            return pipelines[i].second;
+    }
+    return NULL;
+}
@@ -0,0 +1,75 @@
+//
+// Configuration
+//
+
+// Include guard
+#ifndef _TRACETRANSFORM_PIPELINE_
+#define _TRACETRANSFORM_PIPELINE_
+
+// Standard library
+#include <vector> // for vector
+
+// Eigen
+#include <Eigen/Dense>
+
+// Local
+#include "functionals.hpp"
+#include "sinogram.hpp"
+#include "circus.hpp"
+
+
+//
+// T-functional pipelines
+//
+
+// State shared by all columns (and angles) of a T-functional pipeline
+struct TPipelineContext {
+    TPipelineContext(int rows);
+
+    // Integration weights r and r^2, shared by T1 and T2
+    Eigen::VectorXf ramp;
+    Eigen::VectorXf ramp_squared;
+
+    // Pre-calculations of the T3-T5 stages, per stage
+    std::vector<TFunctional345_precalc_t *> precalcs;
+};
+
+// Trace all columns of a rotated image, writing the result of stage i for
+// column c to outputs[i][c]
+typedef void (*TPipeline)(const Eigen::MatrixXf &image,
+                          const TPipelineContext &context,
+                          float *const *outputs);
+
+// Look up a pipeline specialized for the given (ordered) set of column-wise
+// T-functionals (Radon and T1-T5), or NULL if there is none
+TPipeline findTPipeline(const std::vector<TFunctional> &functionals);
+
+
+//
+// P-functional pipelines
+//
+
+// State shared by all columns of a P-functional pipeline
+struct PPipelineContext {
+    PPipelineContext(int rows, const std::vector<PFunctionalWrapper> &stages);
+
+    // Integration weights of the Hermite stages, per stage
+    std::vector<Eigen::VectorXf> weights;
+
+    // Pre-calculations of the P3 stages, per stage
+    std::vector<const PFunctional3_precalc_t *> precalcs;
+};
+
+// Trace the columns [first, last) of a sinogram, writing the result of stage i
+// for column c to outputs[i][c]
+// NOTE: the columns are traced by the calling thread, so callers can split a
+//       sinogram over the threads of a parallel region
+typedef void (*PPipeline)(const Eigen::MatrixXf &sinogram,
+                          const PPipelineContext &context,
+                          float *const *outputs, int first, int last);
+
+// Look up a pipeline specialized for the given (ordered) set of column-wise
+// P-functionals (P1, P3 and Hermite), or NULL if there is none
+PPipeline findPPipeline(const std::vector<PFunctional> &functionals);
+
+#endif
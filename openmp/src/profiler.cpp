@@ -0,0 +1,278 @@
+//
+// Configuration
+//
+
+// Header include
+#include "profiler.hpp"
+
+// Standard library
+#include <algorithm> // for sort, max
+#include <cassert>   // for assert
+#include <cmath>     // for ceil, sqrt
+#include <iomanip>   // for setw, setprecision
+
+// Profiler instantiation
+Profiler profiler;
+
+
+//
+// Construction and destruction
+//
+
+Profiler::Profiler() {
+    settings.enabled = false;
+    settings.counters = false;
+}
+
+Profiler::Accumulator::Accumulator() {
+    for (int i = 0; i < max_phases; i++) {
+        totals[i] = 0;
+        elements[i] = 0;
+        memory[i] = 0;
+        for (int j = 0; j < PerfCounterCount; j++)
+            counters[i][j] = 0;
+    }
+}
+
+
+//
+// Recording
+//
+
+int Profiler::phase(const std::string &name) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (size_t i = 0; i < _names.size(); i++) {
+        if (_names[i] == name)
+            return i;
+    }
+    assert(_names.size() < (size_t)max_phases);
+    _names.push_back(name);
+    _samples.resize(_names.size());
+    _heap_peak.resize(_names.size());
+    _heap_threads.resize(_names.size());
+    return _names.size() - 1;
+}
+
+std::vector<std::string> Profiler::names() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _names;
+}
+
+Profiler::Accumulator &Profiler::accumulator() {
+    static thread_local Accumulator *local = NULL;
+    if (local == NULL) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _accumulators.emplace_back(new Accumulator());
+        local = _accumulators.back().get();
+    }
+    return *local;
+}
+
+void Profiler::record(int phase, uint64_t nanoseconds, uint64_t elements,
+                      const uint64_t *counters) {
+    Accumulator &local = accumulator();
+    local.totals[phase].fetch_add(nanoseconds, std::memory_order_relaxed);
+    local.elements[phase].fetch_add(elements, std::memory_order_relaxed);
+    if (counters != NULL) {
+        for (int i = 0; i < PerfCounterCount; i++)
+            local.counters[phase][i].fetch_add(counters[i],
+                                               std::memory_order_relaxed);
+    }
+}
+
+void Profiler::recordMemory(int phase, uint64_t bytes) {
+    // Only the owning thread writes its accumulator, so no need for a CAS
+    Accumulator &local = accumulator();
+    if (bytes > local.memory[phase].load(std::memory_order_relaxed))
+        local.memory[phase].store(bytes, std::memory_order_relaxed);
+}
+
+void Profiler::collect() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (size_t phase = 0; phase < _names.size(); phase++) {
+        uint64_t total = 0, heap_peak = 0, heap_threads = 0;
+        for (size_t i = 0; i < _accumulators.size(); i++) {
+            total += _accumulators[i]->totals[phase].exchange(0);
+            uint64_t memory = _accumulators[i]->memory[phase].exchange(0);
+            heap_peak = std::max(heap_peak, memory);
+            heap_threads += memory;
+        }
+        _heap_peak[phase] = std::max<size_t>(_heap_peak[phase], heap_peak);
+        _heap_threads[phase] =
+            std::max<size_t>(_heap_threads[phase], heap_threads);
+
+        // Phases which didn't run this iteration aren't sampled
+        if (total > 0)
+            _samples[phase].push_back(total / 1e9);
+    }
+}
+
+void Profiler::reset() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (size_t phase = 0; phase < _names.size(); phase++) {
+        for (size_t i = 0; i < _accumulators.size(); i++) {
+            _accumulators[i]->totals[phase] = 0;
+            _accumulators[i]->elements[phase] = 0;
+            _accumulators[i]->memory[phase] = 0;
+            for (int j = 0; j < PerfCounterCount; j++)
+                _accumulators[i]->counters[phase][j] = 0;
+        }
+        _samples[phase].clear();
+        _heap_peak[phase] = _heap_threads[phase] = 0;
+    }
+}
+
+
+//
+// Reporting
+//
+
+std::vector<PhaseStatistics> Profiler::statistics() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::vector<PhaseStatistics> statistics;
+    for (size_t phase = 0; phase < _names.size(); phase++) {
+        std::vector<double> samples = _samples[phase];
+        if (samples.empty())
+            continue;
+        std::sort(samples.begin(), samples.end());
+        size_t n = samples.size();
+
+        PhaseStatistics stats;
+        stats.name = _names[phase];
+        stats.samples = n;
+        stats.min = samples.front();
+        stats.median = (n % 2) ? samples[n / 2]
+                               : (samples[n / 2 - 1] + samples[n / 2]) / 2;
+        stats.p95 = samples[std::max((int)std::ceil(0.95 * n) - 1, 0)];
+
+        double sum = 0;
+        for (size_t i = 0; i < n; i++)
+            sum += samples[i];
+        stats.mean = sum / n;
+        double squares = 0;
+        for (size_t i = 0; i < n; i++)
+            squares += (samples[i] - stats.mean) * (samples[i] - stats.mean);
+        stats.stddev = (n > 1) ? std::sqrt(squares / (n - 1)) : 0;
+
+        stats.heap_peak = _heap_peak[phase];
+        stats.heap_threads = _heap_threads[phase];
+
+        statistics.push_back(stats);
+    }
+    return statistics;
+}
+
+void Profiler::report(std::ostream &stream) const {
+    std::vector<PhaseStatistics> statistics = this->statistics();
+    std::ios::fmtflags flags = stream.flags();
+    std::streamsize precision = stream.precision();
+    stream << "Time per phase (in seconds, summed over its threads)\n";
+    stream << std::left << std::setw(16) << "phase" << std::right;
+    for (const char *column : {"mean", "median", "stddev", "min", "p95"})
+        stream << std::setw(12) << column;
+    stream << "\n";
+    for (size_t i = 0; i < statistics.size(); i++) {
+        const PhaseStatistics &stats = statistics[i];
+        stream << std::left << std::setw(16) << stats.name << std::right
+               << std::fixed << std::setprecision(6);
+        for (double value :
+             {stats.mean, stats.median, stats.stddev, stats.min, stats.p95})
+            stream << std::setw(12) << value;
+        stream << "\n";
+    }
+    stream.flags(flags);
+    stream.precision(precision);
+    stream << std::flush;
+}
+
+void Profiler::reportCounters(std::ostream &stream) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::ios::fmtflags flags = stream.flags();
+    std::streamsize precision = stream.precision();
+
+    // Per phase, relative to the amount of processed elements
+    stream << "Events per phase (summed over its threads)\n";
+    stream << std::left << std::setw(16) << "phase" << std::right
+           << std::setw(14) << "elements" << std::setw(14) << "cycles"
+           << std::setw(8) << "IPC";
+    for (int counter = LLCMisses; counter < PerfCounterCount; counter++)
+        stream << std::setw(22)
+               << std::string(perfCounterName(counter)) + "/element";
+    stream << "\n";
+    for (size_t phase = 0; phase < _names.size(); phase++) {
+        uint64_t elements = 0, counters[PerfCounterCount] = {0};
+        for (size_t i = 0; i < _accumulators.size(); i++) {
+            elements += _accumulators[i]->elements[phase];
+            for (int counter = 0; counter < PerfCounterCount; counter++)
+                counters[counter] += _accumulators[i]->counters[phase][counter];
+        }
+        if (counters[Cycles] == 0)
+            continue;
+
+        stream << std::left << std::setw(16) << _names[phase] << std::right
+               << std::setw(14) << elements << std::setw(14)
+               << counters[Cycles] << std::fixed << std::setprecision(2)
+               << std::setw(8)
+               << (double)counters[Instructions] / counters[Cycles]
+               << std::setprecision(4);
+        for (int counter = LLCMisses; counter < PerfCounterCount; counter++) {
+            if (perfCounterAvailable(counter) && elements > 0)
+                stream << std::setw(22)
+                       << (double)counters[counter] / elements;
+            else
+                stream << std::setw(22) << "n/a";
+        }
+        stream << "\n";
+        stream.flags(flags);
+    }
+
+    // Per thread, in absolute numbers
+    stream << std::left << std::setw(16) << "thread" << std::right
+           << std::setw(14) << "cycles" << std::setw(8) << "IPC";
+    for (int counter = LLCMisses; counter < PerfCounterCount; counter++)
+        stream << std::setw(16) << perfCounterName(counter);
+    stream << "\n";
+    for (size_t i = 0; i < _accumulators.size(); i++) {
+        uint64_t counters[PerfCounterCount] = {0};
+        for (size_t phase = 0; phase < _names.size(); phase++) {
+            for (int counter = 0; counter < PerfCounterCount; counter++)
+                counters[counter] += _accumulators[i]->counters[phase][counter];
+        }
+        if (counters[Cycles] == 0)
+            continue;
+
+        stream << std::left << std::setw(16) << i << std::right
+               << std::setw(14) << counters[Cycles] << std::fixed
+               << std::setprecision(2) << std::setw(8)
+               << (double)counters[Instructions] / counters[Cycles];
+        for (int counter = LLCMisses; counter < PerfCounterCount; counter++) {
+            if (perfCounterAvailable(counter))
+                stream << std::setw(16) << counters[counter];
+            else
+                stream << std::setw(16) << "n/a";
+        }
+        stream << "\n";
+        stream.flags(flags);
+    }
+
+    stream.precision(precision);
+    stream << std::flush;
+}
+
+void Profiler::reportMemory(std::ostream &stream) const {
+    std::vector<PhaseStatistics> statistics = this->statistics();
+    std::ios::fmtflags flags = stream.flags();
+    stream << std::left << std::setw(16) << "phase" << std::right
+           << std::setw(14) << "peak" << std::setw(14) << "all threads"
+           << "\n";
+    for (size_t i = 0; i < statistics.size(); i++) {
+        const PhaseStatistics &stats = statistics[i];
+        if (stats.heap_threads == 0)
+            continue;
+        stream << std::left << std::setw(16) << stats.name << std::right
+               << std::setw(14) << formatBytes(stats.heap_peak)
+               << std::setw(14) << formatBytes(stats.heap_threads) << "\n";
+    }
+    stream.flags(flags);
+    stream << std::flush;
+}
@@ -0,0 +1,150 @@
+//
+// Configuration
+//
+
+// Include guard
+#ifndef _TRACETRANSFORM_PROFILER_
+#define _TRACETRANSFORM_PROFILER_
+
+// Standard library
+#include <stdint.h> // for uint64_t
+#include <atomic>   // for atomic
+#include <chrono>   // for steady_clock
+#include <cstddef>  // for size_t
+#include <memory>   // for unique_ptr
+#include <mutex>    // for mutex
+#include <ostream>  // for ostream
+#include <string>   // for string
+#include <vector>   // for vector
+
+// Local
+#include "memory.hpp"
+#include "perfcounters.hpp"
+#include "trace.hpp"
+
+
+//
+// Module definitions
+//
+
+// Statistics of a phase over all collected iterations (in seconds)
+struct PhaseStatistics {
+    std::string name;
+    size_t samples;
+    double mean, median, stddev, min, p95;
+
+    // Heap allocated at most by a single run of the phase, and that maximum
+    // summed over all threads (in bytes)
+    size_t heap_peak, heap_threads;
+};
+
+// Profiler
+// NOTE: phases are timed by every thread running them (never around a parallel
+//       region), so their time, elements and hardware events are all summed
+//       over those threads
+class Profiler {
+  public:
+    Profiler();
+
+    // Configuration
+    struct {
+        bool enabled;
+        bool counters;
+    } settings;
+
+    // Register a phase (or look up an existing one) and return its identifier
+    int phase(const std::string &name);
+    std::vector<std::string> names() const;
+
+    // Account time, and optionally processed elements and hardware events, to
+    // a phase on behalf of the calling thread
+    void record(int phase, uint64_t nanoseconds, uint64_t elements = 0,
+                const uint64_t *counters = NULL);
+
+    // Account the heap high-water mark of a single run of a phase
+    void recordMemory(int phase, uint64_t bytes);
+
+    // Finish an iteration, summing the time of every phase over all threads
+    void collect();
+
+    // Forget all collected iterations
+    void reset();
+
+    // Summarize the collected iterations
+    std::vector<PhaseStatistics> statistics() const;
+    void report(std::ostream &stream) const;
+
+    // Summarize the hardware events, per phase and per thread
+    void reportCounters(std::ostream &stream) const;
+
+    // Summarize the heap usage per phase
+    void reportMemory(std::ostream &stream) const;
+
+    static const int max_phases = 128;
+
+  private:
+    // Per-thread accumulators
+    struct Accumulator {
+        Accumulator();
+        std::atomic<uint64_t> totals[max_phases];
+        std::atomic<uint64_t> elements[max_phases];
+        std::atomic<uint64_t> counters[max_phases][PerfCounterCount];
+        std::atomic<uint64_t> memory[max_phases];
+    };
+    Accumulator &accumulator();
+
+    mutable std::mutex _mutex;
+    std::vector<std::string> _names;
+    std::vector<std::unique_ptr<Accumulator>> _accumulators;
+    std::vector<std::vector<double>> _samples;
+    std::vector<size_t> _heap_peak, _heap_threads;
+};
+extern Profiler profiler;
+
+// Scoped timer, accounting its lifetime (and the hardware events and heap
+// allocations during it) to a phase, and tracing it as a span
+class PhaseTimer {
+  public:
+    PhaseTimer(int phase, uint64_t elements = 0)
+        : _phase(phase), _elements(elements),
+          _active(profiler.settings.enabled), _counting(false),
+          _tracing(tracer.settings.enabled), _trace_start(0) {
+        if (_tracing)
+            _trace_start = Tracer::now();
+        if (_active) {
+            _counting =
+                profiler.settings.counters && readPerfCounters(_counters);
+            _start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~PhaseTimer() {
+        if (_active) {
+            uint64_t nanoseconds =
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - _start).count();
+            uint64_t counters[PerfCounterCount];
+            if (_counting && readPerfCounters(counters)) {
+                for (int i = 0; i < PerfCounterCount; i++)
+                    counters[i] -= _counters[i];
+                profiler.record(_phase, nanoseconds, _elements, counters);
+            } else {
+                profiler.record(_phase, nanoseconds, _elements);
+            }
+            profiler.recordMemory(_phase, _memory.peak());
+        }
+        if (_tracing)
+            tracer.record(_phase, _trace_start, Tracer::now());
+    }
+
+  private:
+    int _phase;
+    uint64_t _elements;
+    bool _active, _counting, _tracing;
+    std::chrono::steady_clock::time_point _start;
+    uint64_t _trace_start;
+    uint64_t _counters[PerfCounterCount];
+    MemoryScope _memory;
+};
+
+#endif
@@ -0,0 +1,214 @@
+//
+// Configuration
+//
+
+// Header include
+#include "protocol.hpp"
+
+// Standard library
+#include <errno.h>      // for errno, EINTR
+#include <string.h>     // for strncpy
+#include <sys/socket.h> // for socket, send, recv, etc
+#include <sys/un.h>     // for sockaddr_un
+#include <unistd.h>     // for close, unlink
+#include <sstream>      // for stringstream
+
+// Boost
+#include <boost/program_options.hpp>
+
+
+//
+// Auxiliary
+//
+
+// Fill in the address of a Unix domain socket, returning false when the path
+// doesn't fit
+static bool socketAddress(const std::string &path, struct sockaddr_un &addr) {
+    if (path.empty() || path.size() >= sizeof(addr.sun_path))
+        return false;
+    addr = sockaddr_un();
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    return true;
+}
+
+
+//
+// Module definitions
+//
+
+bool readFully(int fd, void *buffer, size_t length) {
+    char *data = static_cast<char *>(buffer);
+    while (length > 0) {
+        ssize_t count = recv(fd, data, length, 0);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return false;
+        data += count;
+        length -= count;
+    }
+    return true;
+}
+
+bool writeFully(int fd, const void *buffer, size_t length) {
+    const char *data = static_cast<const char *>(buffer);
+    while (length > 0) {
+        // NOTE: a peer which hung up shouldn't kill us with a SIGPIPE
+        ssize_t count = send(fd, data, length, MSG_NOSIGNAL);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return false;
+        data += count;
+        length -= count;
+    }
+    return true;
+}
+
+int listenSocket(const std::string &path, int backlog) {
+    struct sockaddr_un addr;
+    if (!socketAddress(path, addr))
+        return -1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+
+    // Remove the socket file a previous instance left behind
+    unlink(path.c_str());
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(fd, backlog) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int connectSocket(const std::string &path) {
+    struct sockaddr_un addr;
+    if (!socketAddress(path, addr))
+        return -1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+std::string formatSpec(const std::vector<std::string> &tfunctionals,
+                       const std::vector<std::string> &pfunctionals) {
+    std::stringstream spec;
+    for (size_t t = 0; t < tfunctionals.size(); t++)
+        spec << (t > 0 ? " " : "") << "T" << tfunctionals[t];
+    for (size_t p = 0; p < pfunctionals.size(); p++) {
+        spec << (spec.tellp() > 0 ? " " : "");
+        if (pfunctionals[p].empty() || pfunctionals[p][0] != 'H')
+            spec << "P";
+        spec << pfunctionals[p];
+    }
+    return spec.str();
+}
+
+void parseSpec(const std::string &spec,
+               std::vector<TFunctionalWrapper> &tfunctionals,
+               std::vector<PFunctionalWrapper> &pfunctionals) {
+    std::stringstream tokens(spec);
+    std::string token;
+    while (tokens >> token) {
+        // Functionals are named as on the command line, prefixed with their
+        // kind (except for the Hermite P-functionals, which carry their own)
+        if (token.size() > 1 && token[0] == 'T') {
+            std::stringstream name(token.substr(1));
+            TFunctionalWrapper tfunctional;
+            name >> tfunctional;
+            tfunctionals.push_back(tfunctional);
+        } else if (token.size() > 1 && (token[0] == 'P' || token[0] == 'H')) {
+            std::stringstream name(token[0] == 'P' ? token.substr(1) : token);
+            PFunctionalWrapper pfunctional;
+            name >> pfunctional;
+            pfunctionals.push_back(pfunctional);
+        } else {
+            throw boost::program_options::validation_error(
+                boost::program_options::validation_error::invalid_option_value,
+                "spec", token);
+        }
+    }
+}
+
+bool sendRequest(int fd, const Eigen::MatrixXi &image, unsigned int angle,
+                 const std::string &spec) {
+    RequestHeader header;
+    header.magic = request_magic;
+    header.version = protocol_version;
+    header.rows = image.rows();
+    header.cols = image.cols();
+    header.pixel_type = PixelType::UInt8;
+    header.angle = angle;
+    header.spec_length = spec.size();
+
+    // Eigen stores column-major, while the wire carries rows
+    std::vector<unsigned char> pixels(image.size());
+    for (int row = 0; row < image.rows(); row++)
+        for (int col = 0; col < image.cols(); col++)
+            pixels[row * image.cols() + col] = image(row, col);
+
+    return writeFully(fd, &header, sizeof(header)) &&
+           writeFully(fd, spec.data(), spec.size()) &&
+           writeFully(fd, pixels.data(), pixels.size());
+}
+
+ResponseStatus receiveResponse(int fd, Eigen::MatrixXf &signatures,
+                               std::string &message) {
+    ResponseHeader header;
+    if (!readFully(fd, &header, sizeof(header)) ||
+        header.magic != response_magic) {
+        message = "connection lost";
+        return ResponseStatus::Failure;
+    }
+
+    if (header.status == ResponseStatus::OK) {
+        size_t length = (size_t)header.rows * header.cols * sizeof(float);
+        if (header.length != length) {
+            message = "malformed response";
+            return ResponseStatus::Failure;
+        }
+        signatures.resize(header.rows, header.cols);
+        if (!readFully(fd, signatures.data(), header.length)) {
+            message = "connection lost";
+            return ResponseStatus::Failure;
+        }
+    } else {
+        message.resize(header.length);
+        if (!readFully(fd, &message[0], header.length)) {
+            message = "connection lost";
+            return ResponseStatus::Failure;
+        }
+    }
+    return header.status;
+}
+
+bool sendResponse(int fd, const Eigen::MatrixXf &signatures) {
+    ResponseHeader header;
+    header.magic = response_magic;
+    header.status = ResponseStatus::OK;
+    header.rows = signatures.rows();
+    header.cols = signatures.cols();
+    header.length = signatures.size() * sizeof(float);
+    return writeFully(fd, &header, sizeof(header)) &&
+           writeFully(fd, signatures.data(), header.length);
+}
+
+bool sendError(int fd, ResponseStatus status, const std::string &message) {
+    ResponseHeader header;
+    header.magic = response_magic;
+    header.status = status;
+    header.rows = header.cols = 0;
+    header.length = message.size();
+    return writeFully(fd, &header, sizeof(header)) &&
+           writeFully(fd, message.data(), message.size());
+}
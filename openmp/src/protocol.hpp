@@ -0,0 +1,110 @@
+//
+// Configuration
+//
+
+// Include guard
+#ifndef _TRACETRANSFORM_PROTOCOL_
+#define _TRACETRANSFORM_PROTOCOL_
+
+// Standard library
+#include <stdint.h> // for uint32_t
+#include <cstddef>  // for size_t
+#include <string>   // for string
+#include <vector>   // for vector
+
+// Eigen
+#include <Eigen/Dense>
+
+// Local
+#include "sinogram.hpp"
+#include "circus.hpp"
+
+
+//
+// Wire format
+//
+
+// Messages of the transform service, exchanged over a local socket in native
+// byte order:
+//   request:  RequestHeader, functional spec (text), pixels (row-major)
+//   response: ResponseHeader, signatures (float, column-major) or an error
+//             message (text)
+// A connection can carry any amount of requests, answered in order.
+
+const uint32_t request_magic = 0x51525454;  // "TTRQ"
+const uint32_t response_magic = 0x53525454; // "TTRS"
+const uint32_t protocol_version = 1;
+
+enum class PixelType : uint32_t {
+    UInt8,  // grayscale, range [0, 255]
+    Float32 // range [0, 1]
+};
+
+enum class ResponseStatus : uint32_t {
+    OK,
+    InvalidRequest,
+    Busy,
+    Failure
+};
+
+struct RequestHeader {
+    uint32_t magic, version;
+    uint32_t rows, cols;
+    PixelType pixel_type;
+    uint32_t angle;
+
+    // Length of the functional spec, e.g. "T0 T1 T6 P1 P2" or "T0 H2"
+    uint32_t spec_length;
+};
+
+struct ResponseHeader {
+    uint32_t magic;
+    ResponseStatus status;
+
+    // Shape of the signature matrix (zero for errors)
+    uint32_t rows, cols;
+
+    // Bytes following the header
+    uint32_t length;
+};
+
+// Limits requests are validated against
+const uint32_t max_image_dimension = 1 << 15;
+const size_t max_image_pixels = 1 << 28;
+const uint32_t max_spec_length = 4096;
+
+
+//
+// Module definitions
+//
+
+// Transfer a buffer completely, returning false on errors or end-of-file
+bool readFully(int fd, void *buffer, size_t length);
+bool writeFully(int fd, const void *buffer, size_t length);
+
+// Listen on, or connect to, a Unix domain socket (returning -1 on failure)
+int listenSocket(const std::string &path, int backlog);
+int connectSocket(const std::string &path);
+
+// Compose a functional spec out of functionals named as on the command line
+// (e.g. "0", "6" and "2", or "H3" for the Hermite P-functionals)
+std::string formatSpec(const std::vector<std::string> &tfunctionals,
+                       const std::vector<std::string> &pfunctionals);
+
+// Parse a functional spec, throwing a validation_error when malformed
+void parseSpec(const std::string &spec,
+               std::vector<TFunctionalWrapper> &tfunctionals,
+               std::vector<PFunctionalWrapper> &pfunctionals);
+
+// Send a request, and wait for its response
+// NOTE: on failure, the message describes what went wrong
+bool sendRequest(int fd, const Eigen::MatrixXi &image, unsigned int angle,
+                 const std::string &spec);
+ResponseStatus receiveResponse(int fd, Eigen::MatrixXf &signatures,
+                               std::string &message);
+
+// Answer a request
+bool sendResponse(int fd, const Eigen::MatrixXf &signatures);
+bool sendError(int fd, ResponseStatus status, const std::string &message);
+
+#endif
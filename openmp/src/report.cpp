@@ -0,0 +1,149 @@
+//
+// Configuration
+//
+
+// Header include
+#include "report.hpp"
+
+// Standard library
+#include <fstream>  // for ifstream, ofstream
+#include <iomanip>  // for setprecision
+#include <ostream>  // for ostream, operator<<
+#include <sstream>  // for stringstream
+#include <omp.h>    // for omp_get_max_threads
+
+// Local
+#include "memory.hpp"
+
+// Build description, as passed by the build system
+#ifndef TRACETRANSFORM_BUILD_TYPE
+#define TRACETRANSFORM_BUILD_TYPE "unknown"
+#endif
+#ifndef TRACETRANSFORM_BUILD_COMPILER
+#define TRACETRANSFORM_BUILD_COMPILER __VERSION__
+#endif
+#ifndef TRACETRANSFORM_BUILD_FLAGS
+#define TRACETRANSFORM_BUILD_FLAGS "unknown"
+#endif
+
+
+//
+// Auxiliary
+//
+
+static std::string quote(const std::string &text) {
+    std::stringstream quoted;
+    quoted << '"';
+    for (size_t i = 0; i < text.size(); i++) {
+        unsigned char c = text[i];
+        if (c == '"' || c == '\\')
+            quoted << '\\' << c;
+        else if (c < 0x20)
+            quoted << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+                   << (int)c << std::dec << std::setfill(' ');
+        else
+            quoted << c;
+    }
+    quoted << '"';
+    return quoted.str();
+}
+
+static std::string quote(const std::vector<std::string> &texts) {
+    std::string list = "[";
+    for (size_t i = 0; i < texts.size(); i++)
+        list += (i ? ", " : "") + quote(texts[i]);
+    return list + "]";
+}
+
+static std::string cpuModel() {
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line)) {
+        if (line.compare(0, 10, "model name") == 0) {
+            size_t colon = line.find(':');
+            if (colon != std::string::npos)
+                return line.substr(line.find_first_not_of(" \t", colon + 1));
+        }
+    }
+    return "unknown";
+}
+
+
+//
+// Module definitions
+//
+
+bool writeReport(const std::string &filename,
+                 const std::vector<BenchmarkRecord> &records) {
+    // Open file
+    std::ofstream fd_report(filename);
+    if (!fd_report.is_open())
+        return false;
+    fd_report << std::setprecision(9);
+
+    // Describe the environment
+    fd_report << "{\n"
+              << "  \"build\": {\n"
+              << "    \"type\": " << quote(TRACETRANSFORM_BUILD_TYPE) << ",\n"
+              << "    \"flags\": " << quote(TRACETRANSFORM_BUILD_FLAGS)
+              << ",\n"
+              << "    \"compiler\": " << quote(TRACETRANSFORM_BUILD_COMPILER)
+              << "\n"
+              << "  },\n"
+              << "  \"machine\": {\n"
+              << "    \"cpu\": " << quote(cpuModel()) << ",\n"
+              << "    \"threads\": " << omp_get_max_threads() << "\n"
+              << "  },\n";
+
+    // Print the records
+    fd_report << "  \"benchmarks\": [";
+    for (size_t r = 0; r < records.size(); r++) {
+        const BenchmarkRecord &record = records[r];
+        fd_report << (r ? "," : "") << "\n"
+                  << "    {\n"
+                  << "      \"input\": " << quote(record.input) << ",\n"
+                  << "      \"rows\": " << record.rows << ",\n"
+                  << "      \"cols\": " << record.cols << ",\n"
+                  << "      \"angle\": " << record.angle << ",\n"
+                  << "      \"tfunctionals\": " << quote(record.tfunctionals)
+                  << ",\n"
+                  << "      \"pfunctionals\": " << quote(record.pfunctionals)
+                  << ",\n";
+
+        fd_report << "      \"iterations\": [";
+        for (size_t i = 0; i < record.iterations.size(); i++)
+            fd_report << (i ? ", " : "") << record.iterations[i];
+        fd_report << "],\n";
+
+        fd_report << "      \"phase_time\": \"summed over threads\",\n";
+        fd_report << "      \"phases\": [";
+        for (size_t i = 0; i < record.phases.size(); i++) {
+            const PhaseStatistics &stats = record.phases[i];
+            fd_report << (i ? "," : "") << "\n"
+                      << "        {\"name\": " << quote(stats.name)
+                      << ", \"samples\": " << stats.samples
+                      << ", \"mean\": " << stats.mean
+                      << ", \"median\": " << stats.median
+                      << ", \"stddev\": " << stats.stddev
+                      << ", \"min\": " << stats.min
+                      << ", \"p95\": " << stats.p95
+                      << ", \"heap_peak\": " << stats.heap_peak
+                      << ", \"heap_threads\": " << stats.heap_threads << "}";
+        }
+        fd_report << "\n      ],\n";
+
+        fd_report << "      \"memory\": {\"heap_peak\": ";
+        if (memoryTracked())
+            fd_report << record.heap_peak;
+        else
+            fd_report << "null";
+        fd_report << ", \"rss_peak\": " << record.rss_peak << "}\n"
+                  << "    }";
+    }
+    fd_report << "\n  ]\n"
+              << "}\n";
+
+    fd_report << std::flush;
+    fd_report.close();
+    return !fd_report.fail();
+}
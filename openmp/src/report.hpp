@@ -0,0 +1,44 @@
+//
+// Configuration
+//
+
+// Include guard
+#ifndef _TRACETRANSFORM_REPORT_
+#define _TRACETRANSFORM_REPORT_
+
+// Standard library
+#include <cstddef> // for size_t
+#include <string>  // for string
+#include <vector>  // for vector
+
+// Local
+#include "profiler.hpp"
+
+
+//
+// Module definitions
+//
+
+// Benchmark results of a single image component
+struct BenchmarkRecord {
+    std::string input;
+    size_t rows, cols;
+    unsigned int angle;
+    std::vector<std::string> tfunctionals, pfunctionals;
+
+    // Elapsed time of every iteration (in seconds)
+    std::vector<double> iterations;
+
+    std::vector<PhaseStatistics> phases;
+
+    // Heap high-water mark while processing the record, and peak resident set
+    // size of the process so far (in bytes)
+    size_t heap_peak, rss_peak;
+};
+
+// Write a JSON report, describing the build and machine the records were
+// measured with, returning whether it got written successfully
+bool writeReport(const std::string &filename,
+                 const std::vector<BenchmarkRecord> &records);
+
+#endif
@@ -0,0 +1,217 @@
+//
+// Configuration
+//
+
+// Standard library
+#include <string.h>  // for strncpy
+#include <chrono>    // for steady_clock, duration
+#include <cstddef>   // for size_t
+#include <exception> // for exception
+#include <iostream>  // for operator<<, ostream, etc
+#include <string>    // for string
+#include <vector>    // for vector
+
+// Boost
+#include <boost/program_options.hpp>
+
+// Local
+#include "logger.hpp"
+#include "auxiliary.hpp"
+#include "shmring.hpp"
+#include "synthetic.hpp"
+
+
+//
+// Auxiliary
+//
+
+// Time to wait for a slot before checking whether the service went away (in
+// milliseconds)
+const int wait_interval = 1000;
+
+// Decode an image into a slot, the way an upstream decoder would
+static void fill(SharedRing &ring, size_t index, const Eigen::MatrixXi &image,
+                 PixelType pixel_type, unsigned int angle,
+                 const std::string &spec, uint64_t tag) {
+    RingSlot &slot = ring.slot(index);
+    slot.rows = image.rows();
+    slot.cols = image.cols();
+    slot.pixel_type = pixel_type;
+    slot.angle = angle;
+    slot.tag = tag;
+    strncpy(slot.spec, spec.c_str(), sizeof(slot.spec) - 1);
+    slot.spec[sizeof(slot.spec) - 1] = '\0';
+
+    if (pixel_type == PixelType::UInt8) {
+        slot.stride = image.cols();
+        unsigned char *pixels = static_cast<unsigned char *>(ring.input(index));
+        for (int row = 0; row < image.rows(); row++)
+            for (int col = 0; col < image.cols(); col++)
+                pixels[row * slot.stride + col] = image(row, col);
+    } else {
+        slot.stride = image.cols() * sizeof(float);
+        float *pixels = static_cast<float *>(ring.input(index));
+        for (int row = 0; row < image.rows(); row++)
+            for (int col = 0; col < image.cols(); col++)
+                pixels[row * image.cols() + col] = image(row, col) / 255.0;
+    }
+
+    ring.post(index, SlotState::Filled);
+}
+
+
+//
+// Main application
+//
+
+// Push images through a shared memory ring served by the demo (in 'serve'
+// mode with --shm), and measure the throughput
+int main(int argc, char **argv) {
+    //
+    // Initialization
+    //
+
+    std::vector<std::string> tfunctionals, pfunctionals;
+
+    // Declare named options
+    boost::program_options::options_description desc("Allowed options");
+    desc.add_options()
+        ("help,h",
+            "produce help message")
+        ("shm",
+            boost::program_options::value<std::string>()
+                ->default_value("/tracetransform"),
+            "name of the shared memory ring")
+        ("t-functional,T",
+            boost::program_options::value<std::vector<std::string>>(
+                &tfunctionals)->required(),
+            "T-functionals")
+        ("p-functional,P",
+            boost::program_options::value<std::vector<std::string>>(
+                &pfunctionals),
+            "P-functionals")
+        ("angle,a",
+            boost::program_options::value<unsigned int>()
+                ->default_value(1),
+            "angle stepsize")
+        ("input,i",
+            boost::program_options::value<std::string>(),
+            "image to transform (defaults to synthetic noise)")
+        ("size",
+            boost::program_options::value<int>()->default_value(64),
+            "size of the synthetic images to transform")
+        ("float",
+            "send the pixels as floating-point values")
+        ("requests,n",
+            boost::program_options::value<long>()->default_value(100),
+            "amount of images to transform")
+        ("output,o",
+            boost::program_options::value<std::string>(),
+            "CSV file to write the signatures of the last image to")
+    ;
+
+    // Parse the options
+    boost::program_options::variables_map vm;
+    try {
+        store(boost::program_options::command_line_parser(argc, argv)
+                  .options(desc)
+                  .run(),
+              vm);
+        if (vm.count("help")) {
+            std::cout << desc << std::endl;
+            return 0;
+        }
+        notify(vm);
+    }
+    catch (const std::exception &e) {
+        std::cerr << "Invalid usage: " << e.what() << std::endl;
+
+        std::cout << desc << std::endl;
+        return 1;
+    }
+
+    Eigen::MatrixXi image;
+    if (vm.count("input")) {
+        std::vector<Eigen::MatrixXi> components =
+            readnetpbm(vm["input"].as<std::string>());
+        if (components.size() != 1) {
+            clog(error) << "Only grayscale images are supported" << std::endl;
+            return 1;
+        }
+        image = components[0];
+    } else {
+        image = generateImage(SyntheticPattern::Noise, vm["size"].as<int>(),
+                              0);
+    }
+    PixelType pixel_type =
+        vm.count("float") ? PixelType::Float32 : PixelType::UInt8;
+    std::string spec = formatSpec(tfunctionals, pfunctionals);
+
+    SharedRing ring;
+    if (!ring.open(vm["shm"].as<std::string>())) {
+        clog(error) << "Could not attach to shared memory ring "
+                    << vm["shm"].as<std::string>() << std::endl;
+        return 1;
+    }
+    size_t element =
+        (pixel_type == PixelType::Float32) ? sizeof(float) : 1;
+    if ((size_t)image.size() * element > ring.inputCapacity()) {
+        clog(error) << "Image doesn't fit the slots of the ring" << std::endl;
+        return 1;
+    }
+
+
+    //
+    // Execution
+    //
+
+    // Keep every slot busy: refill a slot as soon as its result is in
+    long requests = vm["requests"].as<long>(), completed = 0, failed = 0;
+    long submitted = 0;
+    Eigen::MatrixXf signatures;
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    while (completed + failed < requests) {
+        size_t index = (completed + failed) % ring.slots();
+        if (submitted < requests &&
+            submitted - (completed + failed) < (long)ring.slots()) {
+            size_t next = submitted % ring.slots();
+            if (!ring.wait(next, SlotState::Free, wait_interval)) {
+                if (ring.closed())
+                    break;
+                continue;
+            }
+            fill(ring, next, image, pixel_type, vm["angle"].as<unsigned int>(),
+                 spec, submitted);
+            submitted++;
+            continue;
+        }
+
+        if (!ring.wait(index, SlotState::Done, wait_interval)) {
+            if (ring.closed())
+                break;
+            continue;
+        }
+        RingSlot &slot = ring.slot(index);
+        if (slot.status == ResponseStatus::OK) {
+            signatures = Eigen::Map<Eigen::MatrixXf>(
+                ring.output(index), slot.result_rows, slot.result_cols);
+            completed++;
+        } else {
+            clog(error) << "Request " << slot.tag
+                        << " failed: " << slot.message << std::endl;
+            failed++;
+        }
+        ring.post(index, SlotState::Free);
+    }
+    double elapsed = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start).count();
+
+    clog(info) << "Completed " << completed << " request(s) in " << elapsed
+               << " s (" << failed << " failed), "
+               << completed / elapsed << " requests/s" << std::endl;
+    if (vm.count("output") && completed > 0)
+        writecsv(vm["output"].as<std::string>(), signatures);
+
+    return (completed == requests) ? 0 : 1;
+}
@@ -0,0 +1,532 @@
+//
+// Configuration
+//
+
+// Header include
+#include "service.hpp"
+
+// Standard library
+#include <errno.h>      // for errno, EAGAIN
+#include <fcntl.h>      // for O_NONBLOCK, O_CLOEXEC
+#include <omp.h>        // for omp_set_num_threads
+#include <poll.h>       // for poll, pollfd
+#include <signal.h>     // for sigaction, SIGINT, SIGTERM
+#include <string.h>     // for memset, strncpy, strnlen
+#include <sys/socket.h> // for accept, recv, setsockopt
+#include <sys/time.h>   // for timeval
+#include <unistd.h>     // for close, unlink, pipe2, read, write
+#include <algorithm>    // for max
+#include <chrono>       // for steady_clock, duration
+#include <exception>    // for exception
+#include <functional>   // for ref
+#include <sstream>      // for stringstream
+#include <thread>       // for thread
+#include <vector>       // for vector
+
+// Eigen
+#include <Eigen/Dense>
+
+// Local
+#include "logger.hpp"
+#include "protocol.hpp"
+#include "shmring.hpp"
+
+
+//
+// Auxiliary
+//
+
+namespace {
+
+volatile sig_atomic_t interrupted = 0;
+
+void interrupt(int) { interrupted = 1; }
+
+// Install a handler for SIGINT and SIGTERM
+// NOTE: without SA_RESTART, so blocking calls get interrupted rather than
+//       resumed, which together with the timeouts on the connections keeps
+//       a shutdown from waiting on clients
+void handleSignals(void (*handler)(int)) {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = 0;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+}
+
+// Interval at which blocked threads check whether to stop (in milliseconds)
+const int poll_interval = 200;
+
+// Time a client gets to send or take a message (in seconds), before its
+// connection gets dropped
+const int io_timeout = 10;
+
+void setSendTimeout(int fd) {
+    struct timeval timeout;
+    timeout.tv_sec = io_timeout;
+    timeout.tv_usec = 0;
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+}
+
+// Read a message from a client, giving up when it stalls or when stopping
+bool receive(int fd, void *buffer, size_t length,
+             const std::atomic<bool> &stopping) {
+    std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(io_timeout);
+    char *data = static_cast<char *>(buffer);
+    while (length > 0) {
+        if (stopping || std::chrono::steady_clock::now() > deadline)
+            return false;
+        struct pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if (poll(&pfd, 1, poll_interval) <= 0)
+            continue;
+        ssize_t count = recv(fd, data, length, MSG_DONTWAIT);
+        if (count < 0 && (errno == EINTR || errno == EAGAIN))
+            continue;
+        if (count <= 0)
+            return false;
+        data += count;
+        length -= count;
+    }
+    return true;
+}
+
+}
+
+
+//
+// Module definitions
+//
+
+TransformService::TransformService(const ServiceSettings &settings)
+    : _settings(settings), _stopping(false), _requests(0) {}
+
+bool TransformService::run() {
+    int listener = listenSocket(_settings.socket, _settings.queue);
+    if (listener < 0) {
+        clog(error) << "Could not listen on " << _settings.socket
+                    << std::endl;
+        return false;
+    }
+    if (pipe2(_wakeup, O_NONBLOCK | O_CLOEXEC) != 0) {
+        clog(error) << "Could not create a pipe" << std::endl;
+        close(listener);
+        return false;
+    }
+
+    interrupted = 0;
+    handleSignals(interrupt);
+
+    std::vector<std::thread> workers;
+    for (unsigned int w = 0; w < _settings.workers; w++)
+        workers.push_back(std::thread(&TransformService::work, this));
+    clog(info) << "Serving on " << _settings.socket << " with "
+               << _settings.workers << " worker(s) of " << _settings.threads
+               << " thread(s)" << std::endl;
+
+    // Watch the connections in between requests, so a worker is only taken
+    // for the time it needs to handle a single request
+    std::vector<int> idle;
+    std::vector<struct pollfd> fds;
+    while (!interrupted) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            idle.insert(idle.end(), _returned.begin(), _returned.end());
+            _returned.clear();
+        }
+
+        struct pollfd watch;
+        watch.events = POLLIN;
+        watch.revents = 0;
+        fds.assign(2 + idle.size(), watch);
+        fds[0].fd = listener;
+        fds[1].fd = _wakeup[0];
+        for (size_t i = 0; i < idle.size(); i++)
+            fds[2 + i].fd = idle[i];
+        if (poll(fds.data(), fds.size(), poll_interval) <= 0)
+            continue;
+        if (fds[1].revents & POLLIN) {
+            char buffer[64];
+            while (read(_wakeup[0], buffer, sizeof(buffer)) > 0)
+                ;
+        }
+
+        // Queue the connections with a request (or a hang-up) coming in
+        size_t kept = 0;
+        std::unique_lock<std::mutex> lock(_mutex);
+        for (size_t i = 0; i < idle.size(); i++) {
+            if (fds[2 + i].revents != 0)
+                _connections.push_back(idle[i]);
+            else
+                idle[kept++] = idle[i];
+        }
+        bool queued = (kept < idle.size());
+        bool full = (_connections.size() >= _settings.queue);
+        lock.unlock();
+        idle.resize(kept);
+        if (queued)
+            _available.notify_all();
+
+        if ((fds[0].revents & POLLIN) == 0)
+            continue;
+        int fd = accept(listener, NULL, NULL);
+        if (fd < 0)
+            continue;
+
+        // Turn clients away rather than letting them pile up
+        if (full) {
+            clog(debug) << "Queue full, rejecting connection" << std::endl;
+            sendError(fd, ResponseStatus::Busy, "too many connections");
+            close(fd);
+            continue;
+        }
+        setSendTimeout(fd);
+        idle.push_back(fd);
+    }
+
+    // Finish the requests in flight, and drop the other connections along
+    // with the requests still coming in
+    clog(info) << "Shutting down" << std::endl;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _available.notify_all();
+    for (size_t w = 0; w < workers.size(); w++)
+        workers[w].join();
+    idle.insert(idle.end(), _returned.begin(), _returned.end());
+    idle.insert(idle.end(), _connections.begin(), _connections.end());
+    for (size_t i = 0; i < idle.size(); i++)
+        close(idle[i]);
+    _returned.clear();
+    _connections.clear();
+
+    close(_wakeup[0]);
+    close(_wakeup[1]);
+    close(listener);
+    unlink(_settings.socket.c_str());
+    handleSignals(SIG_DFL);
+    clog(info) << "Served " << _requests << " request(s)" << std::endl;
+    return true;
+}
+
+void TransformService::work() {
+    // NOTE: the OpenMP thread count is a per-thread setting, so every worker
+    //       gets a team of its own size
+    omp_set_num_threads(_settings.threads);
+
+    // NOTE: plans are kept per worker, as they can't be used concurrently
+    PlanCache plans;
+    while (true) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _available.wait(lock, [this] {
+            return _stopping || !_connections.empty();
+        });
+        if (_stopping)
+            return;
+        int fd = _connections.front();
+        _connections.pop_front();
+        lock.unlock();
+
+        // Hand the connection back after a single request, unless it failed
+        if (!handle(fd, plans)) {
+            close(fd);
+            continue;
+        }
+        lock.lock();
+        _returned.push_back(fd);
+        lock.unlock();
+        // NOTE: a full pipe will wake the main thread all the same
+        if (write(_wakeup[1], "", 1) < 0 && errno != EAGAIN)
+            clog(warning) << "Could not wake the main thread" << std::endl;
+    }
+}
+
+bool TransformService::handle(int fd, PlanCache &plans) {
+    RequestHeader header;
+    if (!receive(fd, &header, sizeof(header), _stopping))
+        return false;
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+
+    // Malformed headers leave the stream out of sync, so the connection gets
+    // closed after reporting them
+    std::string problem;
+    if (header.magic != request_magic)
+        problem = "invalid magic";
+    else if (header.version != protocol_version)
+        problem = "unsupported protocol version";
+    else if (header.spec_length > max_spec_length)
+        problem = "functional spec too long";
+    else
+        problem = checkRequest(header.rows, header.cols, header.pixel_type,
+                               header.angle);
+    if (!problem.empty()) {
+        clog(warning) << "Rejecting request: " << problem << std::endl;
+        sendError(fd, ResponseStatus::InvalidRequest, problem);
+        return false;
+    }
+
+    // Read the payload
+    std::string spec(header.spec_length, '\0');
+    if (!receive(fd, &spec[0], spec.size(), _stopping))
+        return false;
+    size_t element = (header.pixel_type == PixelType::Float32)
+                         ? sizeof(float)
+                         : sizeof(unsigned char);
+    std::vector<char> data((size_t)header.rows * header.cols * element);
+    if (!receive(fd, data.data(), data.size(), _stopping))
+        return false;
+
+    // Transform the image
+    Eigen::MatrixXf signatures;
+    ResponseStatus status;
+    if (header.pixel_type == PixelType::UInt8)
+        status = transform(
+            GrayImageView(reinterpret_cast<unsigned char *>(data.data()),
+                          header.rows, header.cols,
+                          Eigen::OuterStride<>(header.cols)),
+            header.angle, spec, plans, signatures, problem);
+    else
+        status = transform(
+            FloatImageView(reinterpret_cast<float *>(data.data()),
+                           header.rows, header.cols,
+                           Eigen::OuterStride<>(header.cols)),
+            header.angle, spec, plans, signatures, problem);
+    if (status != ResponseStatus::OK)
+        return sendError(fd, status, problem);
+
+    clog(debug) << "Transformed a " << header.rows << "x" << header.cols
+                << " image with '" << spec << "' in "
+                << std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start).count()
+                << " s" << std::endl;
+    return sendResponse(fd, signatures);
+}
+
+std::string TransformService::checkRequest(uint32_t rows, uint32_t cols,
+                                           PixelType pixel_type,
+                                           uint32_t angle) const {
+    if (pixel_type != PixelType::UInt8 && pixel_type != PixelType::Float32)
+        return "unsupported pixel type";
+    else if (rows == 0 || cols == 0 || rows > max_image_dimension ||
+             cols > max_image_dimension ||
+             (size_t)rows * cols > max_image_pixels)
+        return "invalid image size";
+    else if (angle == 0 || angle > 360)
+        return "invalid angle stepsize";
+    return "";
+}
+
+template <typename Image>
+ResponseStatus
+TransformService::transform(const Image &image, unsigned int angle,
+                            const std::string &spec, PlanCache &plans,
+                            Eigen::MatrixXf &signatures,
+                            std::string &problem) {
+    // Parse the functionals
+    std::vector<TFunctionalWrapper> tfunctionals;
+    std::vector<PFunctionalWrapper> pfunctionals;
+    try {
+        parseSpec(spec, tfunctionals, pfunctionals);
+    } catch (const std::exception &e) {
+        problem = std::string("invalid functional spec: ") + e.what();
+        return ResponseStatus::InvalidRequest;
+    }
+    size_t orthonormal_count = 0;
+    for (size_t p = 0; p < pfunctionals.size(); p++) {
+        if (pfunctionals[p].functional == PFunctional::Hermite)
+            orthonormal_count++;
+        pfunctionals[p].arguments.approx_bins =
+            _settings.parguments.approx_bins;
+    }
+    if (tfunctionals.empty() ||
+        (orthonormal_count > 0 && orthonormal_count < pfunctionals.size())) {
+        problem = "invalid combination of functionals";
+        return ResponseStatus::InvalidRequest;
+    }
+    bool orthonormal = (orthonormal_count > 0);
+    for (size_t t = 0; t < tfunctionals.size(); t++)
+        tfunctionals[t].arguments = _settings.targuments;
+
+    // Look up the signatures of images seen before
+    std::string cache_key;
+    if (_settings.cache != NULL && !pfunctionals.empty()) {
+        Hasher hasher;
+        hashImage(hasher, image);
+        cache_key = signatureKey(hasher, angle, tfunctionals, pfunctionals);
+        std::vector<Eigen::MatrixXf> cached;
+        if (_settings.cache->load(cache_key, cached) && cached.size() == 1) {
+            signatures = cached[0];
+            _requests++;
+            return ResponseStatus::OK;
+        }
+    }
+
+    try {
+        std::stringstream key;
+        key << image.rows() << "x" << image.cols() << "@" << angle << ":"
+            << spec;
+        Transformer transformer(image, "request", angle, orthonormal);
+        signatures = transformer.getTransform(tfunctionals, pfunctionals,
+                                              false, lookup(plans, key.str()));
+    } catch (const std::exception &e) {
+        clog(error) << "Failed to transform an image: " << e.what()
+                    << std::endl;
+        problem = e.what();
+        return ResponseStatus::Failure;
+    }
+    if (!cache_key.empty())
+        _settings.cache->store(cache_key,
+                               std::vector<Eigen::MatrixXf>(1, signatures));
+    _requests++;
+    return ResponseStatus::OK;
+}
+
+TransformPlan *TransformService::lookup(PlanCache &plans,
+                                        const std::string &key) {
+    // Move the plan to the front, so the least recently used one is last
+    for (PlanCache::iterator it = plans.begin(); it != plans.end(); ++it) {
+        if (it->key == key) {
+            plans.splice(plans.begin(), plans, it);
+            return plans.front().plan.get();
+        }
+    }
+
+    CachedPlan entry;
+    entry.key = key;
+    entry.plan.reset(new TransformPlan());
+    plans.push_front(std::move(entry));
+    while (plans.size() > std::max<size_t>(_settings.plans, 1))
+        plans.pop_back();
+    return plans.front().plan.get();
+}
+
+
+//
+// Shared memory ring
+//
+
+bool TransformService::runRing() {
+    SharedRing ring;
+    if (!ring.create(_settings.ring, _settings.slots, _settings.slot_size,
+                     _settings.result_size)) {
+        clog(error) << "Could not create shared memory ring "
+                    << _settings.ring << std::endl;
+        return false;
+    }
+
+    interrupted = 0;
+    handleSignals(interrupt);
+
+    // Hand out the slots in order, so the ring is processed first-in
+    // first-out
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> workers;
+    for (unsigned int w = 0; w < _settings.workers; w++)
+        workers.push_back(std::thread(&TransformService::workRing, this,
+                                      std::ref(ring), std::ref(next)));
+    clog(info) << "Serving on shared memory ring " << _settings.ring
+               << " of " << _settings.slots << " slot(s) with "
+               << _settings.workers << " worker(s) of " << _settings.threads
+               << " thread(s)" << std::endl;
+
+    while (!interrupted)
+        std::this_thread::sleep_for(std::chrono::milliseconds(poll_interval));
+
+    clog(info) << "Shutting down" << std::endl;
+    _stopping = true;
+    ring.close();
+    for (size_t w = 0; w < workers.size(); w++)
+        workers[w].join();
+
+    handleSignals(SIG_DFL);
+    clog(info) << "Served " << _requests << " request(s)" << std::endl;
+    return true;
+}
+
+void TransformService::workRing(SharedRing &ring, std::atomic<size_t> &next) {
+    omp_set_num_threads(_settings.threads);
+
+    PlanCache plans;
+    size_t index = next++ % ring.slots();
+    while (!_stopping) {
+        // NOTE: when there are as many workers as slots, another worker
+        //       might be waiting for the same slot, so it has to be claimed
+        if (!ring.wait(index, SlotState::Filled, poll_interval) ||
+            !ring.claim(index, SlotState::Filled, SlotState::Processing))
+            continue;
+        handleSlot(ring, index, plans);
+        ring.post(index, SlotState::Done);
+        index = next++ % ring.slots();
+    }
+}
+
+void TransformService::handleSlot(SharedRing &ring, size_t index,
+                                  PlanCache &plans) {
+    RingSlot &slot = ring.slot(index);
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    slot.result_rows = slot.result_cols = 0;
+    slot.message[0] = '\0';
+
+    // Take the request out of the shared memory before validating it, so a
+    // client changing it in the meantime can't get a different one processed
+    const uint32_t rows = slot.rows, cols = slot.cols;
+    const PixelType pixel_type = slot.pixel_type;
+    const uint32_t stride = slot.stride, angle = slot.angle;
+    std::string spec(slot.spec, strnlen(slot.spec, sizeof(slot.spec)));
+
+    // Validate the request against the dimensions of the slot
+    size_t element = (pixel_type == PixelType::Float32)
+                         ? sizeof(float)
+                         : sizeof(unsigned char);
+    std::string problem = checkRequest(rows, cols, pixel_type, angle);
+    if (problem.empty() &&
+        (stride < cols * element || stride % element != 0 ||
+         (size_t)(rows - 1) * stride + cols * element > ring.inputCapacity()))
+        problem = "image doesn't fit the slot";
+
+    // Transform straight out of the shared memory
+    Eigen::MatrixXf signatures;
+    ResponseStatus status = ResponseStatus::InvalidRequest;
+    if (problem.empty()) {
+        if (pixel_type == PixelType::UInt8)
+            status = transform(
+                GrayImageView(static_cast<unsigned char *>(ring.input(index)),
+                              rows, cols, Eigen::OuterStride<>(stride)),
+                angle, spec, plans, signatures, problem);
+        else
+            status = transform(
+                FloatImageView(static_cast<float *>(ring.input(index)), rows,
+                               cols, Eigen::OuterStride<>(stride / element)),
+                angle, spec, plans, signatures, problem);
+    }
+    if (status == ResponseStatus::OK &&
+        (size_t)signatures.size() > ring.outputCapacity()) {
+        status = ResponseStatus::InvalidRequest;
+        problem = "signatures don't fit the slot";
+    }
+
+    slot.status = status;
+    if (status == ResponseStatus::OK) {
+        Eigen::Map<Eigen::MatrixXf>(ring.output(index), signatures.rows(),
+                                    signatures.cols()) = signatures;
+        slot.result_rows = signatures.rows();
+        slot.result_cols = signatures.cols();
+        clog(debug) << "Transformed a " << rows << "x" << cols
+                    << " image with '" << spec << "' in "
+                    << std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - start).count()
+                    << " s" << std::endl;
+    } else {
+        clog(warning) << "Rejecting request: " << problem << std::endl;
+        strncpy(slot.message, problem.c_str(), sizeof(slot.message) - 1);
+        slot.message[sizeof(slot.message) - 1] = '\0';
+    }
+}
@@ -0,0 +1,123 @@
+//
+// Configuration
+//
+
+// Include guard
+#ifndef _TRACETRANSFORM_SERVICE_
+#define _TRACETRANSFORM_SERVICE_
+
+// Standard library
+#include <stdint.h>           // for uint32_t
+#include <atomic>             // for atomic
+#include <condition_variable> // for condition_variable
+#include <cstddef>            // for size_t
+#include <deque>              // for deque
+#include <list>               // for list
+#include <memory>             // for unique_ptr
+#include <mutex>              // for mutex
+#include <string>             // for string
+#include <vector>             // for vector
+
+// Eigen
+#include <Eigen/Dense>
+
+// Local
+#include "sinogram.hpp"
+#include "circus.hpp"
+#include "transform.hpp"
+#include "protocol.hpp"
+#include "shmring.hpp"
+#include "cache.hpp"
+
+
+//
+// Module definitions
+//
+
+struct ServiceSettings {
+    ServiceSettings()
+        : socket("tracetransform.sock"), slots(8), slot_size(16 << 20),
+          result_size(360 * 64), workers(1), queue(16), threads(1),
+          plans(8), cache(NULL) {}
+
+    // Path of the Unix domain socket to listen on
+    std::string socket;
+
+    // Name of the shared memory ring to take images from instead (see
+    // shmring.hpp), and its amount of slots with their input (in bytes) and
+    // output (in floats) capacity
+    std::string ring;
+    size_t slots, slot_size, result_size;
+
+    // Amount of requests served concurrently, and of connections with a
+    // request which can wait for a worker before new ones get turned away
+    unsigned int workers;
+    size_t queue;
+
+    // OpenMP threads every worker transforms with
+    int threads;
+
+    // Amount of transform plans every worker keeps around
+    size_t plans;
+
+    // Cache of the signatures of images seen before (optional, and shared by
+    // the workers)
+    MatrixCache *cache;
+
+    // Arguments applied to the functionals of every request
+    TFunctionalArguments targuments;
+    PFunctionalArguments parguments;
+};
+
+// Long-running service transforming the images clients send over a socket
+// or put in a shared memory ring, which saves the start-up cost of a process
+// per image and reuses the pre-calculations of images of the same size
+class TransformService {
+  public:
+    TransformService(const ServiceSettings &settings);
+
+    // Serve requests until interrupted (by SIGINT or SIGTERM), returning
+    // false if the socket or ring couldn't be set up
+    bool run();
+    bool runRing();
+
+  private:
+    struct CachedPlan {
+        std::string key;
+        std::unique_ptr<TransformPlan> plan;
+    };
+    typedef std::list<CachedPlan> PlanCache;
+
+    void work();
+    bool handle(int fd, PlanCache &plans);
+
+    void workRing(SharedRing &ring, std::atomic<size_t> &next);
+    void handleSlot(SharedRing &ring, size_t index, PlanCache &plans);
+
+    // Validate the shape of a request, returning what's wrong with it
+    std::string checkRequest(uint32_t rows, uint32_t cols,
+                             PixelType pixel_type, uint32_t angle) const;
+
+    // Transform an image with the functionals of a spec
+    template <typename Image>
+    ResponseStatus transform(const Image &image, unsigned int angle,
+                             const std::string &spec, PlanCache &plans,
+                             Eigen::MatrixXf &signatures,
+                             std::string &problem);
+    TransformPlan *lookup(PlanCache &plans, const std::string &key);
+
+    ServiceSettings _settings;
+
+    // Connections with a request waiting for a worker, and connections the
+    // workers handed back to be watched for their next request
+    std::deque<int> _connections;
+    std::vector<int> _returned;
+    int _wakeup[2];
+    std::mutex _mutex;
+    std::condition_variable _available;
+    std::atomic<bool> _stopping;
+
+    std::atomic<size_t> _requests;
+};
+
+#endif
@@ -0,0 +1,210 @@
+//
+// Configuration
+//
+
+// Header include
+#include "shmring.hpp"
+
+// Standard library
+#include <errno.h>        // for errno, EINTR
+#include <fcntl.h>        // for O_CREAT, O_RDWR
+#include <linux/futex.h>  // for FUTEX_WAIT, FUTEX_WAKE
+#include <sys/mman.h>     // for mmap, munmap, shm_open, shm_unlink
+#include <sys/stat.h>     // for fstat
+#include <sys/syscall.h>  // for SYS_futex
+#include <time.h>         // for timespec
+#include <unistd.h>       // for close, ftruncate, syscall
+#include <climits>        // for INT_MAX
+
+
+//
+// Auxiliary
+//
+
+namespace {
+
+// Alignment of the input and output areas, which keeps vectorized loads of
+// the rows from straddling cache lines
+const size_t area_alignment = 64;
+
+size_t align(size_t size) {
+    return (size + area_alignment - 1) / area_alignment * area_alignment;
+}
+
+size_t slotsOffset() { return align(sizeof(RingHeader)); }
+
+size_t inputsOffset(size_t slots) {
+    return slotsOffset() + align(slots * sizeof(RingSlot));
+}
+
+size_t outputsOffset(size_t slots, size_t input_capacity) {
+    return inputsOffset(slots) + slots * align(input_capacity);
+}
+
+size_t ringSize(size_t slots, size_t input_capacity, size_t output_capacity) {
+    return outputsOffset(slots, input_capacity) +
+           slots * align(output_capacity * sizeof(float));
+}
+
+// NOTE: the futexes are shared between processes, so they can't use the
+//       FUTEX_PRIVATE_FLAG
+int futexWait(uint32_t *word, uint32_t value, int timeout) {
+    struct timespec ts;
+    ts.tv_sec = timeout / 1000;
+    ts.tv_nsec = (timeout % 1000) * 1000000L;
+    return syscall(SYS_futex, word, FUTEX_WAIT, value, &ts, NULL, 0);
+}
+
+void futexWake(uint32_t *word) {
+    syscall(SYS_futex, word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+}
+
+
+//
+// Module definitions
+//
+
+SharedRing::SharedRing()
+    : _owner(false), _memory(NULL), _size(0), _header(NULL), _slots(0),
+      _input_capacity(0), _output_capacity(0) {}
+
+SharedRing::~SharedRing() {
+    if (_memory != NULL)
+        munmap(_memory, _size);
+    if (_owner)
+        shm_unlink(_name.c_str());
+}
+
+bool SharedRing::create(const std::string &name, size_t slots,
+                        size_t input_capacity, size_t output_capacity) {
+    if (slots == 0)
+        return false;
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0)
+        return false;
+    size_t size = ringSize(slots, input_capacity, output_capacity);
+    if (ftruncate(fd, size) != 0 || !map(fd, size)) {
+        ::close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+    ::close(fd);
+    _name = name;
+    _owner = true;
+
+    // NOTE: the object starts out zeroed, so all slots are free
+    _header->slots = slots;
+    _header->input_capacity = input_capacity;
+    _header->output_capacity = output_capacity;
+    _header->closed = 0;
+    _slots = slots;
+    _input_capacity = input_capacity;
+    _output_capacity = output_capacity;
+    _header->version = ring_version;
+    __atomic_store_n(&_header->magic, ring_magic, __ATOMIC_RELEASE);
+    return true;
+}
+
+bool SharedRing::open(const std::string &name) {
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    bool valid = fstat(fd, &st) == 0 &&
+                 (size_t)st.st_size >= sizeof(RingHeader) &&
+                 map(fd, st.st_size);
+    ::close(fd);
+    if (!valid)
+        return false;
+
+    // Check whether the ring is fully initialized, and fits the object
+    // NOTE: every field is bounded by the size of the object first, for the
+    //       size of the ring not to overflow
+    bool initialized =
+        __atomic_load_n(&_header->magic, __ATOMIC_ACQUIRE) == ring_magic &&
+        _header->version == ring_version;
+    size_t slots = _header->slots;
+    uint64_t input_capacity = _header->input_capacity;
+    uint64_t output_capacity = _header->output_capacity;
+    if (!initialized || slots == 0 || slots > _size / sizeof(RingSlot) ||
+        input_capacity > _size || output_capacity > _size / sizeof(float) ||
+        ringSize(slots, input_capacity, output_capacity) > _size) {
+        munmap(_memory, _size);
+        _memory = NULL;
+        _header = NULL;
+        return false;
+    }
+    _name = name;
+    _slots = slots;
+    _input_capacity = input_capacity;
+    _output_capacity = output_capacity;
+    return true;
+}
+
+bool SharedRing::map(int fd, size_t size) {
+    void *memory =
+        mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED)
+        return false;
+    _memory = memory;
+    _size = size;
+    _header = static_cast<RingHeader *>(memory);
+    return true;
+}
+
+RingSlot &SharedRing::slot(size_t index) {
+    char *base = static_cast<char *>(_memory) + slotsOffset();
+    return reinterpret_cast<RingSlot *>(base)[index];
+}
+
+void *SharedRing::input(size_t index) {
+    return static_cast<char *>(_memory) + inputsOffset(_slots) +
+           index * align(_input_capacity);
+}
+
+float *SharedRing::output(size_t index) {
+    char *base = static_cast<char *>(_memory) +
+                 outputsOffset(_slots, _input_capacity);
+    return reinterpret_cast<float *>(
+        base + index * align(_output_capacity * sizeof(float)));
+}
+
+bool SharedRing::wait(size_t index, SlotState state, int timeout) {
+    uint32_t *word = &slot(index).state;
+    uint32_t current = __atomic_load_n(word, __ATOMIC_ACQUIRE);
+    if (current == (uint32_t)state)
+        return true;
+    if (closed())
+        return false;
+
+    // NOTE: the futex only returns when the word changed (or spuriously), so
+    //       the state has to be checked again
+    futexWait(word, current, timeout);
+    return __atomic_load_n(word, __ATOMIC_ACQUIRE) == (uint32_t)state;
+}
+
+void SharedRing::post(size_t index, SlotState state) {
+    uint32_t *word = &slot(index).state;
+    __atomic_store_n(word, (uint32_t)state, __ATOMIC_RELEASE);
+    futexWake(word);
+}
+
+bool SharedRing::claim(size_t index, SlotState from, SlotState to) {
+    uint32_t expected = (uint32_t)from;
+    return __atomic_compare_exchange_n(&slot(index).state, &expected,
+                                       (uint32_t)to, false, __ATOMIC_ACQ_REL,
+                                       __ATOMIC_ACQUIRE);
+}
+
+void SharedRing::close() {
+    __atomic_store_n(&_header->closed, 1, __ATOMIC_RELEASE);
+    for (size_t i = 0; i < slots(); i++)
+        futexWake(&slot(i).state);
+}
+
+bool SharedRing::closed() const {
+    return __atomic_load_n(&_header->closed, __ATOMIC_ACQUIRE) != 0;
+}
@@ -0,0 +1,127 @@
+//
+// Configuration
+//
+
+// Include guard
+#ifndef _TRACETRANSFORM_SHMRING_
+#define _TRACETRANSFORM_SHMRING_
+
+// Standard library
+#include <stdint.h> // for uint32_t, uint64_t
+#include <cstddef>  // for size_t
+#include <string>   // for string
+
+// Local
+#include "protocol.hpp"
+
+
+//
+// Memory layout
+//
+
+// A ring lives in a single POSIX shared memory object:
+//   RingHeader, RingSlot[slots], inputs[slots], outputs[slots]
+// Every slot pairs an input area, which the producer decodes images into,
+// with an output area the signatures get written back to. Slots are handed
+// back and forth through their state word, which doubles as a futex:
+//   Free -> Filled (producer) -> Processing -> Done (service) -> Free
+// The producer fills the slots in order, and the service processes them in
+// the same order, so results come back first-in first-out.
+
+const uint32_t ring_magic = 0x474e5254; // "TRNG"
+const uint32_t ring_version = 1;
+
+enum class SlotState : uint32_t {
+    Free,
+    Filled,
+    Processing,
+    Done
+};
+
+struct RingHeader {
+    uint32_t magic, version;
+    uint32_t slots;
+
+    // Set when the service shuts down
+    uint32_t closed;
+
+    // Capacity of a slot's input (in bytes) and output (in floats) area
+    uint64_t input_capacity, output_capacity;
+};
+
+struct RingSlot {
+    // Futex word, see SlotState
+    uint32_t state;
+
+    // Request, filled in by the producer
+    uint32_t rows, cols;
+    PixelType pixel_type;
+    uint32_t stride; // bytes between the starts of two rows
+    uint32_t angle;
+    char spec[256];  // NUL-terminated functional spec
+    uint64_t tag;    // opaque to the service
+
+    // Response, filled in by the service
+    ResponseStatus status;
+    uint32_t result_rows, result_cols; // column-major signatures
+    char message[256];                 // NUL-terminated error message
+};
+
+
+//
+// Module definitions
+//
+
+class SharedRing {
+  public:
+    SharedRing();
+    ~SharedRing();
+
+    // Create a new ring, replacing any existing one of the same name
+    bool create(const std::string &name, size_t slots, size_t input_capacity,
+                size_t output_capacity);
+
+    // Attach to a ring created by someone else
+    bool open(const std::string &name);
+
+    // Geometry of the ring, as checked against the mapping when creating or
+    // attaching to it
+    // NOTE: the header is writable by every process using the ring, so it
+    //       doesn't get consulted again afterwards
+    size_t slots() const { return _slots; }
+    size_t inputCapacity() const { return _input_capacity; }
+    size_t outputCapacity() const { return _output_capacity; }
+
+    RingSlot &slot(size_t index);
+    void *input(size_t index);
+    float *output(size_t index);
+
+    // Wait for a slot to reach a state, giving up after a timeout (in
+    // milliseconds) or when the ring gets closed
+    bool wait(size_t index, SlotState state, int timeout);
+
+    // Move a slot to another state, publishing everything written to it
+    void post(size_t index, SlotState state);
+
+    // Atomically move a slot from one state to another
+    bool claim(size_t index, SlotState from, SlotState to);
+
+    // Tell everyone waiting on the ring it won't be served anymore
+    void close();
+    bool closed() const;
+
+  private:
+    SharedRing(const SharedRing &);
+    SharedRing &operator=(const SharedRing &);
+
+    bool map(int fd, size_t size);
+
+    std::string _name;
+    bool _owner;
+    void *_memory;
+    size_t _size;
+    RingHeader *_header;
+    size_t _slots, _input_capacity, _output_capacity;
+};
+
+#endif
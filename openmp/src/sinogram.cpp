@@ -6,26 +6,45 @@
 #include "sinogram.hpp"
 
 // Standard library
-#include <cassert> // for assert
-#include <cmath>   // for floor
-#include <cstddef> // for size_t
-#include <map>     // for map, _Rb_tree_iterator, etc
-#include <new>     // for operator new
-#include <utility> // for pair
+#include <algorithm> // for max, min
+#include <cassert>   // for assert
+#include <cmath>     // for floor, ceil, cos, sin
+#include <cstddef>   // for size_t
+#include <limits>    // for numeric_limits
+#include <map>       // for map, _Rb_tree_iterator, etc
+#include <memory>    // for unique_ptr
+#include <new>       // for operator new
+#include <utility>   // for pair
+#include <omp.h>     // for omp_get_max_threads
 
 // Boost
 #include <boost/program_options.hpp>
 
 // Local
 #include "global.hpp"
+#include "logger.hpp"
 #include "auxiliary.hpp"
 #include "functionals.hpp"
+#include "pipeline.hpp"
+#include "profiler.hpp"
 
 
 //
 // Structures
 //
 
+// Set-up shared by the transforms of every angle: the column-wise
+// T-functionals a pipeline processes together, and the profiling phases
+struct TraceStages {
+    TraceStages(int rows) : context(rows), pipeline(NULL), phase_columns(-1) {}
+
+    std::vector<size_t> indices;
+    TPipelineContext context;
+    TPipeline pipeline;
+    std::vector<int> phases;
+    int phase_columns;
+};
+
 
 //
 // Module definitions
@@ -64,97 +83,51 @@ std::istream &operator>>(std::istream &in, TFunctionalWrapper &wrapper) {
     return in;
 }
 
-std::vector<Eigen::MatrixXf>
-getSinograms(const Eigen::MatrixXf &input, unsigned int angle_stepsize,
-             const std::vector<TFunctionalWrapper> &tfunctionals) {
-    assert(input.rows() == input.cols()); // padded image!
-
-    // Get the image origin to rotate around
-    Point<float>::type origin((input.cols() - 1) / 2.0,
-                              (input.rows() - 1) / 2.0);
-
-    // Calculate and allocate the output matrices
-    int a_steps = (int)std::floor(360 / angle_stepsize);
-    std::vector<Eigen::MatrixXf> outputs(tfunctionals.size());
-    for (size_t t = 0; t < tfunctionals.size(); t++)
-        outputs[t] = Eigen::MatrixXf(input.cols(), a_steps);
-
-    // Pre-calculate
-    std::map<size_t, void *> precalculations;
+TPrecalculations::TPrecalculations(
+    int rows, int cols, const std::vector<TFunctionalWrapper> &tfunctionals)
+    : _rows(rows), _cols(cols), _threads(omp_get_max_threads()) {
     for (size_t t = 0; t < tfunctionals.size(); t++) {
         TFunctional tfunctional = tfunctionals[t].functional;
+        _functionals.push_back(tfunctional);
+        _arguments.push_back(tfunctionals[t].arguments);
         switch (tfunctional) {
         case TFunctional::T3:
-            precalculations[t] =
-                TFunctional3_prepare(input.rows(), input.cols());
+            _precalculations[t] = TFunctional3_prepare(rows, cols);
             break;
         case TFunctional::T4:
-            precalculations[t] =
-                TFunctional4_prepare(input.rows(), input.cols());
+            _precalculations[t] = TFunctional4_prepare(rows, cols);
             break;
         case TFunctional::T5:
-            precalculations[t] =
-                TFunctional5_prepare(input.rows(), input.cols());
+            _precalculations[t] = TFunctional5_prepare(rows, cols);
+            break;
+        case TFunctional::T6:
+            if (tfunctionals[t].arguments.incremental &&
+                tfunctionals[t].arguments.approx_bins == 0)
+                _precalculations[t] = TFunctional6_prepare(rows, cols);
             break;
         case TFunctional::Radon:
         case TFunctional::T1:
         case TFunctional::T2:
-        case TFunctional::T6:
         case TFunctional::T7:
         default:
             break;
         }
-    }
 
-    // Process all angles
-    #pragma omp parallel for
-    for (int a_step = 0; a_step < a_steps; a_step++) {
-        // Rotate the image
-        float a = a_step * angle_stepsize;
-        Eigen::MatrixXf input_rotated = rotate(input, origin, deg2rad(a));
-
-        // Process all projection bands
-        for (int column = 0; column < input.cols(); column++) {
-            Eigen::VectorXf data = input_rotated.col(column);
-
-            // Process all T-functionals
-            for (size_t t = 0; t < tfunctionals.size(); t++) {
-                TFunctional tfunctional = tfunctionals[t].functional;
-                float result;
-                switch (tfunctional) {
-                case TFunctional::Radon:
-                    result = TFunctionalRadon(data);
-                    break;
-                case TFunctional::T1:
-                    result = TFunctional1(data);
-                    break;
-                case TFunctional::T2:
-                    result = TFunctional2(data);
-                    break;
-                case TFunctional::T3:
-                case TFunctional::T4:
-                case TFunctional::T5:
-                    result = TFunctional345(data,
-                        (TFunctional345_precalc_t *)precalculations[t]);
-                    break;
-                case TFunctional::T6:
-                    result = TFunctional6(data);
-                    break;
-                case TFunctional::T7:
-                    result = TFunctional7(data);
-                    break;
-                }
-                outputs[t](column, // row (in the sinogram)
-                           a_step  // column
-                           ) = result;
-            }
+        // Large images use the batched FFT backend
+        unsigned int fft_threshold = tfunctionals[t].arguments.fft_threshold;
+        if ((tfunctional == TFunctional::T3 || tfunctional == TFunctional::T4 ||
+             tfunctional == TFunctional::T5) &&
+            fft_threshold > 0 && (unsigned int)rows >= fft_threshold) {
+            TFunctional345_prepare_fft(
+                (TFunctional345_precalc_t *)_precalculations[t], cols);
         }
     }
+}
 
-    // Destroy pre-calculations
-    std::map<size_t, void *>::iterator it = precalculations.begin();
-    while (it != precalculations.end()) {
-        TFunctional tfunctional = tfunctionals[it->first].functional;
+TPrecalculations::~TPrecalculations() {
+    std::map<size_t, void *>::iterator it = _precalculations.begin();
+    while (it != _precalculations.end()) {
+        TFunctional tfunctional = _functionals[it->first];
         switch (tfunctional) {
         case TFunctional::T3:
         case TFunctional::T4:
@@ -164,16 +137,510 @@ getSinograms(const Eigen::MatrixXf &input, unsigned int angle_stepsize,
             TFunctional345_destroy(precalc);
             break;
         }
+        case TFunctional::T6: {
+            TFunctional6_precalc_t *precalc =
+                (TFunctional6_precalc_t *)it->second;
+            TFunctional6_destroy(precalc);
+            break;
+        }
         case TFunctional::Radon:
         case TFunctional::T1:
         case TFunctional::T2:
-        case TFunctional::T6:
         case TFunctional::T7:
         default:
             break;
         }
         ++it;
     }
+}
+
+bool TPrecalculations::matches(
+    int rows, int cols,
+    const std::vector<TFunctionalWrapper> &tfunctionals) const {
+    // NOTE: the incremental T6 keeps state per thread, for as many threads as
+    //       there were when pre-calculating
+    if (rows != _rows || cols != _cols || omp_get_max_threads() != _threads ||
+        tfunctionals.size() != _functionals.size())
+        return false;
+    for (size_t t = 0; t < tfunctionals.size(); t++) {
+        // NOTE: the arguments decide which pre-calculations get made (the
+        //       FFT backend, the incremental T6)
+        const TFunctionalArguments &arguments = tfunctionals[t].arguments;
+        if (tfunctionals[t].functional != _functionals[t] ||
+            arguments.fft_threshold != _arguments[t].fft_threshold ||
+            arguments.approx_bins != _arguments[t].approx_bins ||
+            arguments.incremental != _arguments[t].incremental)
+            return false;
+    }
+    return true;
+}
+
+// Process the T-functionals of a rotated image which handle all bands at once
+static void traceAngle(const Eigen::MatrixXf &input_rotated, int a_step,
+                       const std::vector<TFunctionalWrapper> &tfunctionals,
+                       std::map<size_t, void *> &precalculations,
+                       const std::vector<int> &phases,
+                       std::vector<float> &approximation_errors,
+                       std::vector<Eigen::MatrixXf> &outputs) {
+    for (size_t t = 0; t < tfunctionals.size(); t++) {
+        TFunctional tfunctional = tfunctionals[t].functional;
+        if (tfunctional == TFunctional::T3 || tfunctional == TFunctional::T4 ||
+            tfunctional == TFunctional::T5) {
+            TFunctional345_precalc_t *precalc =
+                (TFunctional345_precalc_t *)precalculations[t];
+            if (precalc->fft != NULL) {
+                PhaseTimer timer(phases[t], input_rotated.size());
+                TFunctional345_batch(input_rotated, precalc,
+                                     outputs[t].col(a_step).data());
+            }
+        } else if (tfunctional == TFunctional::T6 &&
+                   precalculations.count(t)) {
+            PhaseTimer timer(phases[t], input_rotated.size());
+            TFunctional6_incremental(
+                input_rotated,
+                (TFunctional6_precalc_t *)precalculations.find(t)->second,
+                outputs[t].col(a_step).data());
+        } else if (tfunctional == TFunctional::T6 ||
+                   tfunctional == TFunctional::T7) {
+            PhaseTimer timer(phases[t], input_rotated.size());
+            void (*batch)(const Eigen::MatrixXf &, float *, unsigned int) =
+                (tfunctional == TFunctional::T6) ? TFunctional6_batch
+                                                 : TFunctional7_batch;
+            unsigned int approx_bins = tfunctionals[t].arguments.approx_bins;
+            float *output = outputs[t].col(a_step).data();
+
+            // Sort a limited amount of columns at once
+            const int columns = sort_columns;
+            const int cols = input_rotated.cols();
+            for (int first = 0; first < cols; first += columns) {
+                int count = std::min(columns, cols - first);
+                batch(input_rotated.middleCols(first, count), output + first,
+                      approx_bins);
+            }
+
+            // Compare approximations against the exact result
+            if (approx_bins > 0 && logger.settings.threshold >= debug) {
+                Eigen::VectorXf exact(cols);
+                for (int first = 0; first < cols; first += columns) {
+                    int count = std::min(columns, cols - first);
+                    batch(input_rotated.middleCols(first, count),
+                          exact.data() + first, 0);
+                }
+                Eigen::Map<Eigen::VectorXf> approximation(output,
+                                                          exact.size());
+                float error = relative_error(approximation, exact);
+                #pragma omp critical (approximation_error)
+                approximation_errors[t] =
+                    std::max(approximation_errors[t], error);
+            }
+        }
+    }
+}
+
+// Process the remaining T-functionals of a rotated image band by band, for
+// sets of T-functionals there is no specialized pipeline for
+static void traceColumns(const Eigen::MatrixXf &input_rotated, int a_step,
+                         const std::vector<TFunctionalWrapper> &tfunctionals,
+                         std::map<size_t, void *> &precalculations,
+                         std::vector<Eigen::MatrixXf> &outputs) {
+    for (int column = 0; column < input_rotated.cols(); column++) {
+        Eigen::VectorXf data = input_rotated.col(column);
+
+        // Process all T-functionals
+        for (size_t t = 0; t < tfunctionals.size(); t++) {
+            TFunctional tfunctional = tfunctionals[t].functional;
+            float result;
+            switch (tfunctional) {
+            case TFunctional::Radon:
+                result = TFunctionalRadon(data);
+                break;
+            case TFunctional::T1:
+                result = TFunctional1(data);
+                break;
+            case TFunctional::T2:
+                result = TFunctional2(data);
+                break;
+            case TFunctional::T3:
+            case TFunctional::T4:
+            case TFunctional::T5: {
+                TFunctional345_precalc_t *precalc =
+                    (TFunctional345_precalc_t *)precalculations[t];
+                if (precalc->fft != NULL)
+                    continue; // already processed in batch
+                result = TFunctional345(data, precalc);
+                break;
+            }
+            case TFunctional::T6:
+            case TFunctional::T7:
+                continue; // already processed in batch
+            }
+            outputs[t](column, // row (in the sinogram)
+                       a_step  // column
+                       ) = result;
+        }
+    }
+}
+
+// Look for a pipeline specialized in the column-wise T-functionals, and
+// register the profiling phases of every T-functional
+// NOTE: the column-wise T-functionals are interleaved, so they are accounted
+//       for as a single phase
+static void prepareStages(const std::vector<TFunctionalWrapper> &tfunctionals,
+                          std::map<size_t, void *> &precalculations,
+                          TraceStages &stages) {
+    std::vector<TFunctional> stage_functionals;
+    for (size_t t = 0; t < tfunctionals.size(); t++) {
+        TFunctional tfunctional = tfunctionals[t].functional;
+        TFunctional345_precalc_t *precalc = NULL;
+        bool columnwise = false;
+        switch (tfunctional) {
+        case TFunctional::T3:
+        case TFunctional::T4:
+        case TFunctional::T5:
+            precalc = (TFunctional345_precalc_t *)precalculations[t];
+            columnwise = (precalc->fft == NULL);
+            break;
+        case TFunctional::Radon:
+        case TFunctional::T1:
+        case TFunctional::T2:
+            columnwise = true;
+            break;
+        case TFunctional::T6:
+        case TFunctional::T7:
+        default:
+            break;
+        }
+        if (columnwise) {
+            stages.indices.push_back(t);
+            stage_functionals.push_back(tfunctional);
+            stages.context.precalcs.push_back(precalc);
+        }
+    }
+    stages.pipeline = findTPipeline(stage_functionals);
+    clog(trace) << "Using " << (stages.pipeline ? "specialized" : "generic")
+                << " T-functional pipeline" << std::endl;
+
+    stages.phases.resize(tfunctionals.size());
+    for (size_t t = 0; t < tfunctionals.size(); t++)
+        stages.phases[t] = profiler.phase(tfunctionals[t].name);
+    std::string stage_names;
+    for (size_t i = 0; i < stages.indices.size(); i++)
+        stage_names += (i ? "+" : "") + tfunctionals[stages.indices[i]].name;
+    stages.phase_columns =
+        profiler.phase(stage_names.empty() ? "columns" : stage_names);
+}
+
+// Process all projection bands of a rotated image
+static void traceRotated(const Eigen::MatrixXf &input_rotated, int a_step,
+                         const std::vector<TFunctionalWrapper> &tfunctionals,
+                         std::map<size_t, void *> &precalculations,
+                         const TraceStages &stages,
+                         std::vector<float> &approximation_errors,
+                         std::vector<Eigen::MatrixXf> &outputs) {
+    traceAngle(input_rotated, a_step, tfunctionals, precalculations,
+               stages.phases, approximation_errors, outputs);
+
+    PhaseTimer timer(stages.phase_columns, input_rotated.size());
+    if (stages.pipeline != NULL) {
+        std::vector<float *> stage_outputs(stages.indices.size());
+        for (size_t i = 0; i < stages.indices.size(); i++)
+            stage_outputs[i] = outputs[stages.indices[i]].col(a_step).data();
+        stages.pipeline(input_rotated, stages.context, stage_outputs.data());
+    } else {
+        traceColumns(input_rotated, a_step, tfunctionals, precalculations,
+                     outputs);
+    }
+}
+
+// Report how far the approximated T-functionals deviate at most
+static void
+reportApproximations(const std::vector<TFunctionalWrapper> &tfunctionals,
+                     const std::vector<float> &approximation_errors) {
+    for (size_t t = 0; t < tfunctionals.size(); t++) {
+        TFunctional tfunctional = tfunctionals[t].functional;
+        if ((tfunctional == TFunctional::T6 ||
+             tfunctional == TFunctional::T7) &&
+            tfunctionals[t].arguments.approx_bins > 0 &&
+            logger.settings.threshold >= debug)
+            clog(debug) << "Approximate " << tfunctionals[t].name
+                        << " deviates at most " << approximation_errors[t]
+                        << " (relative) from the exact result" << std::endl;
+    }
+}
+
+std::vector<Eigen::MatrixXf>
+getSinograms(const Eigen::MatrixXf &input, unsigned int angle_stepsize,
+             const std::vector<TFunctionalWrapper> &tfunctionals,
+             TPrecalculations *plan) {
+    std::vector<const Eigen::MatrixXf *> inputs(1, &input);
+    return getSinograms(inputs, angle_stepsize, tfunctionals, plan)[0];
+}
+
+std::vector<std::vector<Eigen::MatrixXf>>
+getSinograms(const std::vector<const Eigen::MatrixXf *> &inputs,
+             unsigned int angle_stepsize,
+             const std::vector<TFunctionalWrapper> &tfunctionals,
+             TPrecalculations *plan) {
+    assert(!inputs.empty());
+    const Eigen::MatrixXf &input = *inputs[0];
+    assert(input.rows() == input.cols()); // padded image!
+    for (size_t c = 1; c < inputs.size(); c++)
+        assert(inputs[c]->rows() == input.rows() &&
+               inputs[c]->cols() == input.cols());
+
+    // Get the image origin to rotate around
+    Point<float>::type origin((input.cols() - 1) / 2.0,
+                              (input.rows() - 1) / 2.0);
+
+    // Calculate and allocate the output matrices
+    int a_steps = (int)std::floor(360 / angle_stepsize);
+    std::vector<std::vector<Eigen::MatrixXf>> outputs(
+        inputs.size(), std::vector<Eigen::MatrixXf>(tfunctionals.size()));
+    std::vector<std::unique_ptr<TPrecalculations>> locals(inputs.size());
+    std::vector<std::map<size_t, void *>> precalculations(inputs.size());
+    {
+        PhaseTimer timer(profiler.phase("sinograms"));
+        for (size_t c = 0; c < inputs.size(); c++)
+            for (size_t t = 0; t < tfunctionals.size(); t++)
+                outputs[c][t] = Eigen::MatrixXf(input.cols(), a_steps);
+
+        // Pre-calculate, unless the caller provided usable pre-calculations
+        if (plan == NULL ||
+            !plan->matches(input.rows(), input.cols(), tfunctionals)) {
+            locals[0].reset(
+                new TPrecalculations(input.rows(), input.cols(), tfunctionals));
+            plan = locals[0].get();
+        }
+        precalculations[0] = plan->precalculations();
+
+        // The incremental T6 carries the order of the previous angle over,
+        // which only makes sense within a single channel
+        bool stateful = false;
+        for (size_t t = 0; t < tfunctionals.size(); t++)
+            stateful |= (tfunctionals[t].functional == TFunctional::T6 &&
+                         precalculations[0].count(t));
+        for (size_t c = 1; c < inputs.size(); c++) {
+            if (stateful) {
+                locals[c].reset(new TPrecalculations(
+                    input.rows(), input.cols(), tfunctionals));
+                precalculations[c] = locals[c]->precalculations();
+            } else {
+                precalculations[c] = precalculations[0];
+            }
+        }
+    }
+
+    // Store several images interleaved, in groups of four, for them to be
+    // rotated in a single pass over the memory
+    std::vector<InterleavedImage> groups;
+    if (inputs.size() > 1) {
+        PhaseTimer timer(profiler.phase("interleave"),
+                         input.size() * inputs.size());
+        for (size_t c = 0; c < inputs.size(); c += 4) {
+            std::vector<const Eigen::MatrixXf *> group(
+                inputs.begin() + c,
+                inputs.begin() + std::min(c + 4, inputs.size()));
+            groups.push_back(interleave(group));
+        }
+    }
+
+    // Look for a pipeline specialized in the column-wise T-functionals
+    // NOTE: the pre-calculations of T3-T5 are read-only, so every channel can
+    //       use those of the first one
+    TraceStages stages(input.rows());
+    prepareStages(tfunctionals, precalculations[0], stages);
+    int phase_angles = profiler.phase("angles");
+    int phase_rotate = profiler.phase("rotate");
+
+    // Maximal relative error of approximated T-functionals
+    std::vector<float> approximation_errors(tfunctionals.size(), 0);
+
+    // Process all angles
+    // NOTE: the static schedule hands each thread a contiguous range of
+    //       angles, which the incremental T6 mode relies on
+    #pragma omp parallel
+    {
+        TraceSpan chunk(phase_angles);
+        #pragma omp for schedule(static) nowait
+        for (int a_step = 0; a_step < a_steps; a_step++) {
+            // Rotate the images
+            float a = a_step * angle_stepsize;
+            std::vector<Eigen::MatrixXf> rotated;
+            {
+                PhaseTimer timer(phase_rotate, input.size() * inputs.size());
+                if (inputs.size() == 1)
+                    rotated.push_back(rotate(input, origin, deg2rad(a)));
+                for (size_t g = 0; g < groups.size(); g++) {
+                    std::vector<Eigen::MatrixXf> channels =
+                        rotate(groups[g], origin, deg2rad(a));
+                    for (size_t c = 0; c < channels.size(); c++) {
+                        rotated.push_back(Eigen::MatrixXf());
+                        rotated.back().swap(channels[c]);
+                    }
+                }
+            }
+
+            // Trace the channels while their rotations are still cached
+            for (size_t c = 0; c < inputs.size(); c++) {
+                traceRotated(rotated[c], a_step, tfunctionals,
+                             precalculations[c], stages, approximation_errors,
+                             outputs[c]);
+            }
+        }
+    }
+
+    reportApproximations(tfunctionals, approximation_errors);
+
+    return outputs;
+}
+
+// Width of the strips of columns images get sampled in when streaming them
+// NOTE: a multiple of the vector width, for the columns of a strip to be
+//       aligned like those of a whole rotated image, and summed alike
+static const int strip_size = 64;
+
+std::vector<Eigen::MatrixXf>
+getSinograms(const TiledImage &input, unsigned int angle_stepsize,
+             const std::vector<TFunctionalWrapper> &tfunctionals,
+             size_t budget) {
+    const int n = padded_size(input.rows(), input.cols());
+    const int a_steps = (int)std::floor(360 / angle_stepsize);
+    const int strips = (n + strip_size - 1) / strip_size;
+    const int threads = omp_get_max_threads();
+    Point<float>::type origin((n - 1) / 2.0, (n - 1) / 2.0);
+
+    // Every strip starts with a fresh order of the columns, so the
+    // incremental T6 has nothing to repair
+    std::vector<TFunctionalWrapper> functionals(tfunctionals);
+    for (size_t t = 0; t < functionals.size(); t++)
+        functionals[t].arguments.incremental = false;
+
+    std::vector<Eigen::MatrixXf> outputs(tfunctionals.size());
+    std::unique_ptr<TPrecalculations> plan;
+    {
+        PhaseTimer timer(profiler.phase("sinograms"));
+        for (size_t t = 0; t < tfunctionals.size(); t++)
+            outputs[t] = Eigen::MatrixXf(n, a_steps);
+        plan.reset(new TPrecalculations(n, strip_size, functionals));
+    }
+    std::map<size_t, void *> precalculations = plan->precalculations();
+    TraceStages stages(n);
+    prepareStages(functionals, precalculations, stages);
+
+    // Size the batches of angles to the budget: the trace lines of a wave of
+    // strips cross a band of the image which widens with the angles a batch
+    // spans, and all tiles of that band (as well as those of the previous
+    // wave, which only get released afterwards) are mapped in at once
+    const size_t word = sizeof(float);
+    const size_t fixed = tfunctionals.size() * n * a_steps * word +
+                         threads * 16 * (size_t)n * strip_size * word;
+    const size_t stored = (size_t)input.tileRows() * input.tileCols() *
+                          tile_size * tile_size;
+    int batch = a_steps;
+    if (budget > 0) {
+        batch = 1;
+        while (batch < a_steps) {
+            float spread = std::min<float>(
+                deg2rad((batch + 1) * angle_stepsize), M_PI / 2);
+            size_t band = 2 * threads * strip_size + 2 * tile_size +
+                          n * std::sin(spread) / 2;
+            if (fixed + std::min(band * n, stored) * word > budget)
+                break;
+            batch++;
+        }
+    }
+    clog(debug) << "Streaming " << input.rows() << "x" << input.cols()
+                << " image in batches of " << batch << " angles" << std::endl;
+
+    // Offset of the image within the padded one it's sampled as
+    const float df_x = (n + 1) / 2 - (input.cols() + 1) / 2;
+    const float df_y = (n + 1) / 2 - (input.rows() + 1) / 2;
+    const float center = origin.x();
+
+    // Rightmost column of the rotated images every tile gets sampled for,
+    // within the current batch of angles
+    std::vector<int> last(input.tileRows() * input.tileCols());
+    const int released = std::numeric_limits<int>::max();
+
+    int phase_angles = profiler.phase("angles");
+    int phase_sample = profiler.phase("sample");
+    std::vector<float> approximation_errors(tfunctionals.size(), 0);
+
+    // Process the angles batch by batch, sweeping all of them over the image
+    // at once in waves of a strip per thread
+    #pragma omp parallel
+    {
+        TraceSpan chunk(phase_angles);
+        std::map<size_t, void *> precalcs = precalculations;
+        Eigen::MatrixXf strip(n, strip_size);
+        std::vector<Eigen::MatrixXf> strip_outputs(
+            tfunctionals.size(), Eigen::MatrixXf(strip_size, 1));
+
+        for (int first_step = 0; first_step < a_steps; first_step += batch) {
+            const int last_step = std::min(first_step + batch, a_steps);
+
+            // NOTE: the pixels are widened with the neighbours interpolation
+            //       reads, and the corners bound the rotated columns
+            #pragma omp for schedule(static)
+            for (size_t i = 0; i < last.size(); i++) {
+                float left = df_x + (i % input.tileCols()) * tile_size - 1;
+                float top = df_y + (i / input.tileCols()) * tile_size - 1;
+                float right = left + tile_size + 1;
+                float bottom = top + tile_size + 1;
+                float max_col = -1;
+                for (int a_step = first_step; a_step < last_step; a_step++) {
+                    float a = deg2rad(a_step * angle_stepsize);
+                    float c = std::cos(a), s = std::sin(a);
+                    max_col = std::max(
+                        max_col, center +
+                                     std::max((left - center) * c,
+                                              (right - center) * c) +
+                                     std::max((top - center) * s,
+                                              (bottom - center) * s));
+                }
+                last[i] = (int)std::ceil(max_col) + 1;
+            }
+
+            for (int wave = 0; wave < strips; wave += threads) {
+                const int wave_end = std::min(wave + threads, strips);
+
+                #pragma omp for schedule(static)
+                for (int s = wave; s < wave_end; s++) {
+                    const int first = s * strip_size;
+                    const int count = std::min(strip_size, n - first);
+                    for (int a_step = first_step; a_step < last_step;
+                         a_step++) {
+                        {
+                            PhaseTimer timer(phase_sample, strip.size());
+                            sampleRotated(input, n, origin,
+                                          deg2rad(a_step * angle_stepsize),
+                                          first, strip);
+                        }
+                        traceRotated(strip, 0, functionals, precalcs, stages,
+                                     approximation_errors, strip_outputs);
+                        for (size_t t = 0; t < tfunctionals.size(); t++)
+                            outputs[t].block(first, a_step, count, 1) =
+                                strip_outputs[t].topRows(count);
+                    }
+                }
+
+                // Hand back the tiles no remaining strip crosses
+                #pragma omp single
+                for (size_t i = 0; i < last.size(); i++) {
+                    if (last[i] < wave_end * strip_size) {
+                        input.release(i / input.tileCols(),
+                                      i % input.tileCols());
+                        last[i] = released;
+                    }
+                }
+            }
+
+            #pragma omp single
+            input.release();
+        }
+    }
+
+    reportApproximations(tfunctionals, approximation_errors);
 
     return outputs;
 }
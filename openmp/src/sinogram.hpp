@@ -7,13 +7,18 @@
 #define _TRACETRANSFORM_SINOGRAM_
 
 // Standard library
+#include <cstddef> // for size_t
 #include <istream> // for istream
+#include <map>     // for map
 #include <string>  // for string
 #include <vector>  // for vector
 
 // Eigen
 #include <Eigen/Dense>
 
+// Local
+#include "tiles.hpp"
+
 
 //
 // Functionals
@@ -30,7 +35,25 @@ enum class TFunctional {
     T7
 };
 
-struct TFunctionalArguments {};
+struct TFunctionalArguments {
+    TFunctionalArguments(unsigned int _fft_threshold = 4096,
+                         unsigned int _approx_bins = 0,
+                         bool _incremental = false)
+        : fft_threshold(_fft_threshold), approx_bins(_approx_bins),
+          incremental(_incremental) {}
+
+    // Arguments for T3, T4 and T5: image size from which on the integrals are
+    // computed with batched FFT correlations (0 disables the FFT backend)
+    unsigned int fft_threshold;
+
+    // Arguments for T6 and T7: amount of histogram bins to approximate the
+    // weighted median with (0 to sort exactly)
+    unsigned int approx_bins;
+
+    // Arguments for T6: repair the permutation of the previous angle rather
+    // than sorting from scratch
+    bool incremental;
+};
 
 struct TFunctionalWrapper {
     TFunctionalWrapper() : name("invalid"), functional(TFunctional()) {
@@ -54,8 +77,58 @@ std::istream &operator>>(std::istream &in, TFunctionalWrapper &wrapper);
 // Module definitions
 //
 
+// Amount of columns T6 and T7 sort at once, for their scratch space not to
+// grow with the whole image
+const int sort_columns = 64;
+
+// Pre-calculations of the T-functionals for images of a single size, which
+// can be kept around to transform several images
+// NOTE: the incremental T6 keeps per-thread state in there, so they mustn't
+//       be used by concurrent transforms
+class TPrecalculations {
+  public:
+    TPrecalculations(int rows, int cols,
+                     const std::vector<TFunctionalWrapper> &tfunctionals);
+    ~TPrecalculations();
+
+    bool matches(int rows, int cols,
+                 const std::vector<TFunctionalWrapper> &tfunctionals) const;
+
+    // Pre-calculation of every T-functional which needs one
+    const std::map<size_t, void *> &precalculations() const {
+        return _precalculations;
+    }
+
+  private:
+    TPrecalculations(const TPrecalculations &);
+    TPrecalculations &operator=(const TPrecalculations &);
+
+    int _rows, _cols, _threads;
+    std::vector<TFunctional> _functionals;
+    std::vector<TFunctionalArguments> _arguments;
+    std::map<size_t, void *> _precalculations;
+};
+
 std::vector<Eigen::MatrixXf>
 getSinograms(const Eigen::MatrixXf &input, unsigned int angle_stepsize,
-             const std::vector<TFunctionalWrapper> &tfunctionals);
+             const std::vector<TFunctionalWrapper> &tfunctionals,
+             TPrecalculations *plan = NULL);
+
+// Calculate the sinograms of several images of the same size at once (e.g.
+// the channels of a colour image), which get rotated together
+std::vector<std::vector<Eigen::MatrixXf>>
+getSinograms(const std::vector<const Eigen::MatrixXf *> &inputs,
+             unsigned int angle_stepsize,
+             const std::vector<TFunctionalWrapper> &tfunctionals,
+             TPrecalculations *plan = NULL);
+
+// Calculate the sinograms of an image streamed from a tiled store, which
+// doesn't get padded or rotated as a whole: strips of the rotated image are
+// sampled from the tiles, in batches of angles sized to keep the memory
+// usage within the given budget (0 for no limit)
+std::vector<Eigen::MatrixXf>
+getSinograms(const TiledImage &input, unsigned int angle_stepsize,
+             const std::vector<TFunctionalWrapper> &tfunctionals,
+             size_t budget = 0);
 
 #endif
@@ -0,0 +1,178 @@
+//
+// Configuration
+//
+
+// Header include
+#include "sort.hpp"
+
+// Standard library
+#include <stdint.h>  // for uint32_t
+#include <algorithm> // for fill
+#include <cstring>   // for memcpy
+#include <utility>   // for swap
+#include <vector>    // for vector
+
+
+//
+// Auxiliary
+//
+
+// CPU counterpart of the batched GPU sort: rather than sorting every column
+// on its own, all segments of a batch are sorted at once by an LSD radix sort
+// on the float bit patterns, after which a final stable counting pass
+// regroups the elements per segment. This amortizes the histogram overhead
+// over the whole batch, and makes the cost linear in the amount of elements.
+
+namespace {
+
+const int radix_bits = 11;
+const int radix_size = 1 << radix_bits;
+const int radix_passes = 3; // ceil(32 / radix_bits)
+
+// Batches smaller than this are insertion sorted segment by segment
+const int insertion_threshold = 256;
+
+// Map a float onto an unsigned integer with the same ordering
+inline uint32_t encode(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits ^ ((uint32_t)((int32_t)bits >> 31) | 0x80000000u);
+}
+
+inline float decode(uint32_t bits) {
+    bits ^= ((bits >> 31) - 1) | 0x80000000u;
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+void insertionSort(float *keys, int *indices, int length) {
+    for (int i = 1; i < length; i++) {
+        float key = keys[i];
+        int index = indices ? indices[i] : 0;
+        int j = i - 1;
+        while (j >= 0 && keys[j] > key) {
+            keys[j + 1] = keys[j];
+            if (indices)
+                indices[j + 1] = indices[j];
+            j--;
+        }
+        keys[j + 1] = key;
+        if (indices)
+            indices[j + 1] = index;
+    }
+}
+
+// Per-thread scratch space, reused across calls
+struct Scratch {
+    std::vector<uint32_t> keys[2];
+    std::vector<uint32_t> positions[2];
+    std::vector<int> indices;
+    std::vector<int> segment_of;
+    std::vector<int> next;
+    uint32_t histograms[radix_passes][radix_size];
+};
+
+}
+
+
+//
+// Module definitions
+//
+
+void sortSegments(float *keys, int *indices, const int *offsets,
+                  int segments) {
+    if (segments <= 0)
+        return;
+    const int base = offsets[0];
+    const int total = offsets[segments] - base;
+    keys += base;
+    if (indices)
+        indices += base;
+
+    // Small batches
+    if (total < insertion_threshold) {
+        for (int s = 0; s < segments; s++)
+            insertionSort(keys + offsets[s] - base,
+                          indices ? indices + offsets[s] - base : NULL,
+                          offsets[s + 1] - offsets[s]);
+        return;
+    }
+
+    static thread_local Scratch scratch;
+    for (int i = 0; i < 2; i++) {
+        scratch.keys[i].resize(total);
+        scratch.positions[i].resize(total);
+    }
+    uint32_t *key_in = scratch.keys[0].data(), *key_out = scratch.keys[1].data();
+    uint32_t *pos_in = scratch.positions[0].data(),
+             *pos_out = scratch.positions[1].data();
+
+    // Encode the keys, and build the histograms of all digits in one pass
+    for (int d = 0; d < radix_passes; d++)
+        std::fill(scratch.histograms[d], scratch.histograms[d] + radix_size, 0);
+    for (int i = 0; i < total; i++) {
+        uint32_t key = encode(keys[i]);
+        key_in[i] = key;
+        pos_in[i] = i;
+        for (int d = 0; d < radix_passes; d++)
+            scratch.histograms[d][(key >> (d * radix_bits)) & (radix_size - 1)]++;
+    }
+
+    // Scatter by every digit, from least to most significant
+    for (int d = 0; d < radix_passes; d++) {
+        const int shift = d * radix_bits;
+        uint32_t *histogram = scratch.histograms[d];
+
+        // Skip digits which are identical for all keys
+        if (histogram[(key_in[0] >> shift) & (radix_size - 1)] ==
+            (uint32_t)total)
+            continue;
+
+        uint32_t sum = 0;
+        for (int b = 0; b < radix_size; b++) {
+            uint32_t count = histogram[b];
+            histogram[b] = sum;
+            sum += count;
+        }
+        for (int i = 0; i < total; i++) {
+            uint32_t dst = histogram[(key_in[i] >> shift) & (radix_size - 1)]++;
+            key_out[dst] = key_in[i];
+            pos_out[dst] = pos_in[i];
+        }
+        std::swap(key_in, key_out);
+        std::swap(pos_in, pos_out);
+    }
+
+    // Regroup the elements per segment (stable, so each stays sorted)
+    if (segments > 1) {
+        scratch.segment_of.resize(total);
+        scratch.next.resize(segments);
+        for (int s = 0; s < segments; s++) {
+            scratch.next[s] = offsets[s] - base;
+            for (int p = offsets[s] - base; p < offsets[s + 1] - base; p++)
+                scratch.segment_of[p] = s;
+        }
+        for (int i = 0; i < total; i++) {
+            int dst = scratch.next[scratch.segment_of[pos_in[i]]]++;
+            key_out[dst] = key_in[i];
+            pos_out[dst] = pos_in[i];
+        }
+        std::swap(key_in, key_out);
+        std::swap(pos_in, pos_out);
+    }
+
+    // Decode the keys, and permute the indices
+    for (int i = 0; i < total; i++)
+        keys[i] = decode(key_in[i]);
+    if (indices) {
+        scratch.indices.assign(indices, indices + total);
+        for (int i = 0; i < total; i++)
+            indices[i] = scratch.indices[pos_in[i]];
+    }
+}
+
+void sortPairs(float *keys, int *indices, int length) {
+    int offsets[2] = {0, length};
+    sortSegments(keys, indices, offsets, 1);
+}
@@ -0,0 +1,22 @@
+//
+// Configuration
+//
+
+// Include guard
+#ifndef _TRACETRANSFORM_SORT_
+#define _TRACETRANSFORM_SORT_
+
+
+//
+// Module definitions
+//
+
+// Sort a batch of segments in ascending order, each segment s spanning
+// [offsets[s], offsets[s+1]) of the keys and (optional) indices array. The
+// indices are permuted along with their keys.
+void sortSegments(float *keys, int *indices, const int *offsets, int segments);
+
+// Sort a single array of keys, permuting the (optional) indices along
+void sortPairs(float *keys, int *indices, int length);
+
+#endif
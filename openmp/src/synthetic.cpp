@@ -0,0 +1,156 @@
+//
+// Configuration
+//
+
+// Header include
+#include "synthetic.hpp"
+
+// Standard library
+#include <stdint.h>  // for uint32_t
+#include <algorithm> // for min, max
+#include <cmath>     // for cos, sin, exp, hypot, abs
+#include <random>    // for mt19937
+
+// Boost
+#include <boost/algorithm/string.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/program_options.hpp>
+
+// Local
+#include "auxiliary.hpp"
+
+
+//
+// Auxiliary
+//
+
+// Uniformly distributed random number in [0, 1)
+// NOTE: the standard distributions are implementation defined, so they would
+//       generate different images depending on the standard library
+static double uniform(std::mt19937 &generator) {
+    return (uint32_t)generator() / 4294967296.0;
+}
+
+static int pixel(float value) {
+    return std::min(std::max((int)(255 * value + 0.5), 0), 255);
+}
+
+[[noreturn]] static void invalid(const std::string &input) {
+    throw boost::program_options::validation_error(
+        boost::program_options::validation_error::invalid_option_value,
+        "inputs", input);
+}
+
+
+//
+// Module definitions
+//
+
+bool isSyntheticInput(const std::string &input) {
+    return input.compare(0, 4, "gen:") == 0;
+}
+
+SyntheticInput parseSyntheticInput(const std::string &input) {
+    std::vector<std::string> fields;
+    boost::split(fields, input, boost::is_any_of(":"));
+    if (fields.size() < 3 || fields.size() > 4 || fields[0] != "gen")
+        invalid(input);
+
+    SyntheticInput synthetic;
+    synthetic.name = fields[1];
+    if (fields[1] == "noise")
+        synthetic.pattern = SyntheticPattern::Noise;
+    else if (fields[1] == "disc")
+        synthetic.pattern = SyntheticPattern::Disc;
+    else if (fields[1] == "gradient")
+        synthetic.pattern = SyntheticPattern::Gradient;
+    else if (fields[1] == "blobs")
+        synthetic.pattern = SyntheticPattern::Blobs;
+    else
+        invalid(input);
+
+    try {
+        std::vector<std::string> range;
+        boost::split(range, fields[2], boost::is_any_of("-"));
+        if (range.size() > 2)
+            invalid(input);
+        int size = boost::lexical_cast<int>(range.front());
+        int max_size = boost::lexical_cast<int>(range.back());
+        if (size < 1 || max_size < size)
+            invalid(input);
+        for (; size <= max_size; size *= 2)
+            synthetic.sizes.push_back(size);
+
+        synthetic.seed =
+            (fields.size() == 4) ? boost::lexical_cast<unsigned int>(fields[3])
+                                 : 0;
+    }
+    catch (const boost::bad_lexical_cast &) {
+        invalid(input);
+    }
+
+    return synthetic;
+}
+
+Eigen::MatrixXi generateImage(SyntheticPattern pattern, int size,
+                              unsigned int seed) {
+    std::mt19937 generator(seed);
+    Eigen::MatrixXi output(size, size);
+    switch (pattern) {
+    case SyntheticPattern::Noise: {
+        for (int col = 0; col < size; col++)
+            for (int row = 0; row < size; row++)
+                output(row, col) = pixel(uniform(generator));
+        break;
+    }
+    case SyntheticPattern::Disc: {
+        // Slightly off-center, so that the signature depends on the angle
+        float x0 = size * (0.4 + 0.2 * uniform(generator));
+        float y0 = size * (0.4 + 0.2 * uniform(generator));
+        float radius = size * (0.25 + 0.1 * uniform(generator));
+        for (int col = 0; col < size; col++)
+            for (int row = 0; row < size; row++)
+                output(row, col) =
+                    (std::hypot(col - x0, row - y0) <= radius) ? 255 : 0;
+        break;
+    }
+    case SyntheticPattern::Gradient: {
+        float angle = deg2rad(360 * uniform(generator));
+        float dx = std::cos(angle), dy = std::sin(angle);
+        float extent = (std::abs(dx) + std::abs(dy)) * size;
+        for (int col = 0; col < size; col++)
+            for (int row = 0; row < size; row++)
+                output(row, col) = pixel(
+                    0.5 + ((col - size / 2.0) * dx + (row - size / 2.0) * dy) /
+                              extent);
+        break;
+    }
+    case SyntheticPattern::Blobs: {
+        Eigen::MatrixXf intensity = Eigen::MatrixXf::Zero(size, size);
+        for (int blob = 0; blob < 8; blob++) {
+            float x0 = size * uniform(generator);
+            float y0 = size * uniform(generator);
+            float sigma = size * (0.01 + 0.04 * uniform(generator));
+            float amplitude = 0.5 + 0.5 * uniform(generator);
+
+            // Only evaluate the Gaussian within three standard deviations
+            int first_col = std::max((int)(x0 - 3 * sigma), 0);
+            int last_col = std::min((int)(x0 + 3 * sigma), size - 1);
+            int first_row = std::max((int)(y0 - 3 * sigma), 0);
+            int last_row = std::min((int)(y0 + 3 * sigma), size - 1);
+            for (int col = first_col; col <= last_col; col++)
+                for (int row = first_row; row <= last_row; row++) {
+                    float r2 =
+                        (col - x0) * (col - x0) + (row - y0) * (row - y0);
+                    intensity(row, col) +=
+                        amplitude * std::exp(-r2 / (2 * sigma * sigma));
+                }
+        }
+        for (int col = 0; col < size; col++)
+            for (int row = 0; row < size; row++)
+                output(row, col) = pixel(intensity(row, col));
+        break;
+    }
+    }
+    return output;
+}
@@ -0,0 +1,47 @@
+//
+// Configuration
+//
+
+// Include guard
+#ifndef _TRACETRANSFORM_SYNTHETIC_
+#define _TRACETRANSFORM_SYNTHETIC_
+
+// Standard library
+#include <string> // for string
+#include <vector> // for vector
+
+// Eigen
+#include <Eigen/Dense>
+
+
+//
+// Module definitions
+//
+
+enum class SyntheticPattern {
+    Noise,
+    Disc,
+    Gradient,
+    Blobs
+};
+
+// Series of synthetic images, specified as
+// "gen:<pattern>:<size>[-<max size>][:<seed>]" (sizes doubling up to the
+// maximum)
+struct SyntheticInput {
+    std::string name;
+    SyntheticPattern pattern;
+    std::vector<int> sizes;
+    unsigned int seed;
+};
+
+bool isSyntheticInput(const std::string &input);
+
+SyntheticInput parseSyntheticInput(const std::string &input);
+
+// Generate a square grayscale image (range [0, 255]), deterministically for a
+// given seed
+Eigen::MatrixXi generateImage(SyntheticPattern pattern, int size,
+                              unsigned int seed);
+
+#endif
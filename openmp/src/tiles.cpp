@@ -0,0 +1,289 @@
+//
+// Configuration
+//
+
+// Header include
+#include "tiles.hpp"
+
+// Standard library
+#include <errno.h>     // for errno
+#include <stdlib.h>    // for mkstemp
+#include <sys/mman.h>  // for mmap, munmap, madvise
+#include <unistd.h>    // for close, ftruncate, pwrite, unlink
+#include <cassert>     // for assert
+#include <cmath>       // for floor, cos, sin, modf
+#include <cstring>     // for memcmp, strerror
+#include <fstream>     // for ifstream
+#include <limits>      // for numeric_limits
+#include <stdexcept>   // for runtime_error
+
+// Local
+#include "logger.hpp"
+#include "auxiliary.hpp"
+
+
+//
+// Auxiliary
+//
+
+namespace {
+
+const size_t tile_area = (size_t)tile_size * tile_size;
+
+// Read the next value of a Netpbm file, skipping whitespace and comments
+template <typename T> T readValue(std::istream &stream) {
+    int next = stream.get();
+    while (next == '#' || next == ' ' || next == '\t' || next == '\n' ||
+           next == '\r') {
+        if (next == '#')
+            stream.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        next = stream.get();
+    }
+    stream.unget();
+
+    T value;
+    stream >> value;
+    if (stream.fail())
+        throw std::runtime_error("Error processing file");
+    return value;
+}
+
+size_t readHeader(std::istream &stream, size_t &rows, size_t &cols) {
+    std::string magic = readValue<std::string>(stream);
+    size_t channels;
+    if (magic == "P2")
+        channels = 1;
+    else if (magic == "P3")
+        channels = 3;
+    else
+        throw std::runtime_error("Invalid Netpbm magic");
+    cols = readValue<size_t>(stream);
+    rows = readValue<size_t>(stream);
+    return channels;
+}
+
+}
+
+
+//
+// Module definitions
+//
+
+TiledImage::TiledImage(int rows, int cols, const std::string &directory)
+    : _rows(rows), _cols(cols), _tile_rows((rows + tile_size - 1) / tile_size),
+      _tile_cols((cols + tile_size - 1) / tile_size), _fd(-1), _size(0),
+      _data(NULL) {
+    _size = (size_t)_tile_rows * _tile_cols * tile_area * sizeof(float);
+
+    std::string pattern = directory + "/tracetransform-XXXXXX";
+    std::vector<char> filename(pattern.begin(), pattern.end());
+    filename.push_back('\0');
+    _fd = mkstemp(filename.data());
+    if (_fd == -1)
+        throw std::runtime_error("could not create scratch file in " +
+                                 directory + ": " + strerror(errno));
+    unlink(filename.data());
+
+    void *data = MAP_FAILED;
+    if (ftruncate(_fd, _size) == 0)
+        data = mmap(NULL, _size, PROT_READ, MAP_SHARED, _fd, 0);
+    if (data == MAP_FAILED) {
+        std::string reason = strerror(errno);
+        close(_fd);
+        throw std::runtime_error("could not map scratch file: " + reason);
+    }
+    _data = (float *)data;
+    clog(trace) << "Storing " << rows << "x" << cols << " image as "
+                << _tile_rows << "x" << _tile_cols << " tiles" << std::endl;
+}
+
+TiledImage::~TiledImage() {
+    munmap(_data, _size);
+    close(_fd);
+}
+
+void TiledImage::writeBand(int band, const float *values) {
+    assert(band >= 0 && band < _tile_rows);
+    const int first = band * tile_size;
+    const int rows = std::min(tile_size, _rows - first);
+
+    // Transpose the rows into tiles, leaving the pixels beyond the edges of
+    // the image zero
+    std::vector<float> tiles(_tile_cols * tile_area, 0);
+    for (int row = 0; row < rows; row++) {
+        for (int col = 0; col < _cols; col++) {
+            float *tile = tiles.data() + (col / tile_size) * tile_area;
+            tile[(col % tile_size) * tile_size + row] =
+                values[(size_t)row * _cols + col];
+        }
+    }
+
+    const size_t length = tiles.size() * sizeof(float);
+    const char *data = (const char *)tiles.data();
+    off_t offset = (off_t)band * length;
+    for (size_t written = 0; written < length;) {
+        ssize_t count =
+            pwrite(_fd, data + written, length - written, offset + written);
+        if (count < 0 && errno != EINTR)
+            throw std::runtime_error(std::string("could not write tiles: ") +
+                                     strerror(errno));
+        if (count > 0)
+            written += count;
+    }
+}
+
+void TiledImage::release(int tile_row, int tile_col) const {
+    size_t index = (size_t)tile_row * _tile_cols + tile_col;
+    madvise(_data + index * tile_area, tile_area * sizeof(float),
+            MADV_DONTNEED);
+}
+
+void TiledImage::release() const { madvise(_data, _size, MADV_DONTNEED); }
+
+bool TiledImage::identical(const TiledImage &other) const {
+    if (other._rows != _rows || other._cols != _cols)
+        return false;
+
+    // Compare band by band, for neither image to be mapped in as a whole
+    const size_t band = (size_t)_tile_cols * tile_area;
+    bool same = true;
+    for (int tile_row = 0; same && tile_row < _tile_rows; tile_row++) {
+        same = (memcmp(_data + tile_row * band, other._data + tile_row * band,
+                       band * sizeof(float)) == 0);
+        for (int tile_col = 0; tile_col < _tile_cols; tile_col++) {
+            release(tile_row, tile_col);
+            other.release(tile_row, tile_col);
+        }
+    }
+    return same;
+}
+
+Eigen::MatrixXf TiledImage::resize(size_t rows, size_t cols) const {
+    Eigen::Matrix2f transform;
+    transform << ((float)_rows) / rows, 0, 0, (((float)_cols) / cols);
+
+    // Interpolate like interpolate() does, releasing every column of tiles
+    // once the output has moved past it
+    // NOTE: the pixels are addressed in column-major order, for those beyond
+    //       the last row of non-square images to be read from the next column
+    //       like with an image in memory
+    auto linear = [this](size_t index) {
+        return pixel(index % _rows, index / _rows);
+    };
+    Eigen::MatrixXf output = Eigen::MatrixXf::Zero(rows, cols);
+    int tile_col = 0;
+    for (size_t col = 1; col < cols - 1; col++) {
+        for (size_t row = 1; row < rows - 1; row++) {
+            Point<float>::type p(col, row);
+            p += Eigen::RowVector2f(0.5, 0.5);
+            p *= transform;
+            p -= Eigen::RowVector2f(0.5, 0.5);
+
+            float x_int, y_int;
+            float x_fract = std::modf(p.x(), &x_int);
+            float y_fract = std::modf(p.y(), &y_int);
+            size_t index = (size_t)x_int * _rows + (size_t)y_int;
+            output(row, col) =
+                linear(index)             * (1 - x_fract) * (1 - y_fract) +
+                linear(index + _rows)     * x_fract       * (1 - y_fract) +
+                linear(index + 1)         * (1 - x_fract) * y_fract +
+                linear(index + _rows + 1) * x_fract       * y_fract;
+        }
+
+        int next = (int)((col + 1.5) * transform(0, 0) - 0.5) / tile_size;
+        for (; tile_col < std::min(next, _tile_cols); tile_col++)
+            for (int tile_row = 0; tile_row < _tile_rows; tile_row++)
+                release(tile_row, tile_col);
+    }
+    release();
+    return output;
+}
+
+void sampleRotated(const TiledImage &image, int size,
+                   const Point<float>::type &origin, float angle, int first,
+                   Eigen::MatrixXf &strip) {
+    // Offset of the image within the padded one, as pad() places it
+    const int df_x = (size + 1) / 2 - (image.cols() + 1) / 2;
+    const int df_y = (size + 1) / 2 - (image.rows() + 1) / 2;
+
+    Eigen::Matrix2f transform;
+    transform << std::cos(-angle), -std::sin(-angle), std::sin(-angle),
+        std::cos(-angle);
+
+    strip.setZero();
+    for (int i = 0; i < strip.cols() && first + i < size; i++) {
+        const int col = first + i;
+        for (int row = 0; row < size; row++) {
+            Point<float>::type p(col, row);
+            p -= origin;
+            p *= transform;
+            p += origin;
+            if (!(p.x() >= 0 && p.x() < size - 1 && p.y() >= 0 &&
+                  p.y() < size - 1))
+                continue;
+
+            // NOTE: the coordinates are positive, so truncating them yields
+            //       the same parts as modf() does
+            int x = (int)p.x(), y = (int)p.y();
+            float x_fract = p.x() - x;
+            float y_fract = p.y() - y;
+            x -= df_x;
+            y -= df_y;
+            strip(row, i) =
+                image.pixel(y,     x)     * (1 - x_fract) * (1 - y_fract) +
+                image.pixel(y,     x + 1) * x_fract       * (1 - y_fract) +
+                image.pixel(y + 1, x)     * (1 - x_fract) * y_fract +
+                image.pixel(y + 1, x + 1) * x_fract       * y_fract;
+        }
+    }
+}
+
+void readNetpbmHeader(const std::string &filename, size_t &rows,
+                      size_t &cols, size_t &channels) {
+    std::ifstream infile(filename);
+    if (!infile.good())
+        throw std::runtime_error("could not open input file");
+    channels = readHeader(infile, rows, cols);
+}
+
+std::vector<std::unique_ptr<TiledImage>>
+readTiledNetpbm(const std::string &filename, const std::string &directory) {
+    std::ifstream infile(filename);
+    if (!infile.good())
+        throw std::runtime_error("could not open input file");
+
+    size_t rows, cols;
+    size_t channels = readHeader(infile, rows, cols);
+    size_t maxval = readValue<size_t>(infile);
+    if (maxval != 255)
+        clog(warning) << "Pixels not properly clipped to [0,255]" << std::endl;
+
+    std::vector<std::unique_ptr<TiledImage>> images(channels);
+    for (size_t i = 0; i < channels; i++)
+        images[i].reset(new TiledImage(rows, cols, directory));
+
+    // Read a band of rows at a time, scaling the pixels like gray2mat()
+    std::vector<std::vector<float>> bands(
+        channels, std::vector<float>(tile_size * cols));
+    for (int band = 0; band < images[0]->tileRows(); band++) {
+        size_t first = (size_t)band * tile_size;
+        size_t count = std::min<size_t>(tile_size, rows - first);
+        for (size_t row = 0; row < count; row++) {
+            for (size_t col = 0; col < cols; col++) {
+                for (size_t i = 0; i < channels; i++) {
+                    unsigned int value = readValue<unsigned int>(infile);
+                    bands[i][row * cols + col] = value / 255.0;
+                }
+            }
+        }
+        for (size_t i = 0; i < channels; i++)
+            images[i]->writeBand(band, bands[i].data());
+    }
+
+    // Trailing data?
+    infile >> std::ws;
+    if (!infile.eof())
+        clog(warning) << "Trailing data at end of image file" << std::endl;
+
+    return images;
+}
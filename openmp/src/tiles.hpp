@@ -0,0 +1,102 @@
+//
+// Configuration
+//
+
+// Include guard
+#ifndef _TRACETRANSFORM_TILES_
+#define _TRACETRANSFORM_TILES_
+
+// Standard library
+#include <cstddef> // for size_t
+#include <memory>  // for unique_ptr
+#include <string>  // for string
+#include <vector>  // for vector
+
+// Eigen
+#include <Eigen/Dense>
+
+// Local
+#include "global.hpp"
+
+
+//
+// Module definitions
+//
+
+// Side (in pixels) of the square tiles images get stored as
+const int tile_size = 128;
+
+// Image stored as square tiles in a memory-mapped scratch file, for images
+// too large to be kept in memory as a whole, let alone padded and rotated
+// once per thread. The tiles keep pixels which are close together in the
+// same pages, whatever the direction a trace line crosses them in.
+// NOTE: pixels outside of the image read as zero, so the image can be
+//       sampled as if it were padded, without storing the padding
+class TiledImage {
+  public:
+    // Create an empty store, backed by a file in the given directory which
+    // gets removed as soon as it's opened
+    TiledImage(int rows, int cols, const std::string &directory);
+    ~TiledImage();
+
+    int rows() const { return _rows; }
+    int cols() const { return _cols; }
+    int tileRows() const { return _tile_rows; }
+    int tileCols() const { return _tile_cols; }
+
+    // Store a band of tile_size rows (fewer for the last band), given row by
+    // row
+    void writeBand(int band, const float *values);
+
+    inline float pixel(int row, int col) const {
+        if (row < 0 || col < 0 || row >= _rows || col >= _cols)
+            return 0;
+        const float *tile =
+            _data + ((size_t)(row / tile_size) * _tile_cols + col / tile_size) *
+                        tile_size * tile_size;
+        return tile[(col % tile_size) * tile_size + row % tile_size];
+    }
+
+    // Hand the memory of a tile back to the system, after which it gets read
+    // from the file again when needed
+    void release(int tile_row, int tile_col) const;
+    void release() const;
+
+    // Whether two stores hold the same pixels
+    bool identical(const TiledImage &other) const;
+
+    // Resize the image like resize() does, for images which get shrunk
+    // enough to fit in memory
+    Eigen::MatrixXf resize(size_t rows, size_t cols) const;
+
+    // Bytes of memory taken by the tiles, if they're all mapped in
+    size_t size() const { return _size; }
+
+  private:
+    TiledImage(const TiledImage &);
+    TiledImage &operator=(const TiledImage &);
+
+    int _rows, _cols;
+    int _tile_rows, _tile_cols;
+    int _fd;
+    size_t _size;
+    float *_data;
+};
+
+// Sample a band of columns of an image padded to the given size and rotated
+// around the origin, exactly like rotate() does with the padded image in
+// memory, reading only the tiles the trace lines cross
+void sampleRotated(const TiledImage &image, int size,
+                   const Point<float>::type &origin, float angle, int first,
+                   Eigen::MatrixXf &strip);
+
+// Read the size and amount of channels of an ASCII Netpbm file
+void readNetpbmHeader(const std::string &filename, size_t &rows,
+                      size_t &cols, size_t &channels);
+
+// Read an ASCII Netpbm file into a tiled store per channel (range [0, 1]),
+// streaming it rather than loading it as a whole
+std::vector<std::unique_ptr<TiledImage>>
+readTiledNetpbm(const std::string &filename, const std::string &directory);
+
+#endif
@@ -0,0 +1,148 @@
+//
+// Configuration
+//
+
+// Header include
+#include "trace.hpp"
+
+// Standard library
+#include <omp.h>     // for omp_get_thread_num
+#include <algorithm> // for min
+#include <chrono>    // for steady_clock
+#include <fstream>   // for ofstream
+#include <iomanip>   // for setprecision
+#ifdef __linux__
+#include <sys/syscall.h> // for SYS_gettid
+#include <unistd.h>      // for syscall
+#endif
+
+// Tracer instantiation
+Tracer tracer;
+
+
+//
+// Auxiliary
+//
+
+namespace {
+
+const std::chrono::steady_clock::time_point epoch =
+    std::chrono::steady_clock::now();
+
+std::string quote(const std::string &text) {
+    std::string quoted = "\"";
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] == '"' || text[i] == '\\')
+            quoted += '\\';
+        if ((unsigned char)text[i] >= 0x20)
+            quoted += text[i];
+    }
+    return quoted + "\"";
+}
+
+}
+
+
+//
+// Construction and destruction
+//
+
+Tracer::Tracer() {
+    settings.enabled = false;
+    settings.capacity = 1 << 16;
+}
+
+
+//
+// Recording
+//
+
+int Tracer::label(const std::string &text) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _labels.push_back(text);
+    return _labels.size() - 1;
+}
+
+uint64_t Tracer::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now() - epoch).count();
+}
+
+Tracer::Buffer &Tracer::buffer() {
+    static thread_local Buffer *local = NULL;
+    if (local == NULL) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _buffers.emplace_back(new Buffer());
+        local = _buffers.back().get();
+#ifdef __linux__
+        local->thread = syscall(SYS_gettid);
+#else
+        local->thread = _buffers.size();
+#endif
+        local->index = omp_get_thread_num();
+        local->spans.resize(settings.capacity);
+        local->recorded = 0;
+    }
+    return *local;
+}
+
+void Tracer::record(int32_t name, uint64_t start, uint64_t end,
+                    int32_t label) {
+    Buffer &local = buffer();
+    Span &span = local.spans[local.recorded++ % local.spans.size()];
+    span.start = start;
+    span.end = end;
+    span.name = name;
+    span.label = label;
+}
+
+
+//
+// Output
+//
+
+void Tracer::write(const std::string &filename,
+                   const std::vector<std::string> &names) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // Open file
+    std::ofstream fd_trace(filename);
+    fd_trace << std::fixed << std::setprecision(3);
+
+    fd_trace << "{\"traceEvents\": [";
+    bool first = true;
+    for (size_t b = 0; b < _buffers.size(); b++) {
+        const Buffer &buffer = *_buffers[b];
+
+        // Name the thread
+        fd_trace << (first ? "" : ",") << "\n"
+                 << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, "
+                 << "\"tid\": " << buffer.thread << ", \"args\": {\"name\": "
+                 << quote("OpenMP thread " + std::to_string(buffer.index))
+                 << "}}";
+        first = false;
+
+        // Print the spans which haven't been overwritten, oldest first
+        size_t count = std::min(buffer.recorded, buffer.spans.size());
+        for (size_t i = buffer.recorded - count; i < buffer.recorded; i++) {
+            const Span &span = buffer.spans[i % buffer.spans.size()];
+            std::string name = (span.name >= 0 &&
+                                (size_t)span.name < names.size())
+                                   ? names[span.name]
+                                   : "unknown";
+            fd_trace << ",\n"
+                     << "{\"name\": " << quote(name)
+                     << ", \"ph\": \"X\", \"pid\": 1, \"tid\": "
+                     << buffer.thread << ", \"ts\": " << span.start / 1e3
+                     << ", \"dur\": " << (span.end - span.start) / 1e3;
+            if (span.label >= 0)
+                fd_trace << ", \"args\": {\"label\": "
+                         << quote(_labels[span.label]) << "}";
+            fd_trace << "}";
+        }
+    }
+    fd_trace << "\n], \"displayTimeUnit\": \"ms\"}\n";
+
+    fd_trace << std::flush;
+    fd_trace.close();
+}
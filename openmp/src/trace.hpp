@@ -0,0 +1,92 @@
+//
+// Configuration
+//
+
+// Include guard
+#ifndef _TRACETRANSFORM_TRACE_
+#define _TRACETRANSFORM_TRACE_
+
+// Standard library
+#include <stdint.h> // for uint64_t, int32_t
+#include <cstddef>  // for size_t
+#include <memory>   // for unique_ptr
+#include <mutex>    // for mutex
+#include <string>   // for string
+#include <vector>   // for vector
+
+
+//
+// Module definitions
+//
+
+// Timeline of spans, recorded into a ring buffer per thread and exported in
+// the Chrome trace event format
+class Tracer {
+  public:
+    Tracer();
+
+    // Configuration
+    struct {
+        bool enabled;
+
+        // Amount of spans kept per thread (older ones get overwritten)
+        size_t capacity;
+    } settings;
+
+    // Register a free-form label (e.g. an image name) to attach to spans
+    int label(const std::string &text);
+
+    // Nanoseconds since the tracer was created
+    static uint64_t now();
+
+    // Record a finished span on behalf of the calling thread
+    void record(int32_t name, uint64_t start, uint64_t end,
+                int32_t label = -1);
+
+    // Write all recorded spans, naming them through the given table
+    // NOTE: must not run concurrently with threads still recording
+    void write(const std::string &filename,
+               const std::vector<std::string> &names) const;
+
+  private:
+    struct Span {
+        uint64_t start, end;
+        int32_t name, label;
+    };
+
+    struct Buffer {
+        uint64_t thread;
+        int index;
+        std::vector<Span> spans;
+        size_t recorded;
+    };
+    Buffer &buffer();
+
+    mutable std::mutex _mutex;
+    std::vector<std::string> _labels;
+    std::vector<std::unique_ptr<Buffer>> _buffers;
+};
+extern Tracer tracer;
+
+// Scoped span
+class TraceSpan {
+  public:
+    TraceSpan(int32_t name, int32_t label = -1)
+        : _name(name), _label(label), _active(tracer.settings.enabled),
+          _start(0) {
+        if (_active)
+            _start = Tracer::now();
+    }
+
+    ~TraceSpan() {
+        if (_active)
+            tracer.record(_name, _start, Tracer::now(), _label);
+    }
+
+  private:
+    int32_t _name, _label;
+    bool _active;
+    uint64_t _start;
+};
+
+#endif
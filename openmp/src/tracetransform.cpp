@@ -0,0 +1,198 @@
+//
+// Configuration
+//
+
+// Header include
+#include "tracetransform.h"
+
+// Standard library
+#include <omp.h>     // for omp_get_max_threads, omp_set_num_threads
+#include <exception> // for exception
+#include <mutex>     // for mutex, lock_guard
+#include <new>       // for bad_alloc, nothrow
+#include <string>    // for string
+#include <vector>    // for vector
+
+// Eigen
+#include <Eigen/Dense>
+
+// Local
+#include "auxiliary.hpp"
+#include "protocol.hpp"
+#include "transform.hpp"
+
+
+//
+// Plans
+//
+
+struct tt_plan {
+    std::vector<TFunctionalWrapper> tfunctionals;
+    std::vector<PFunctionalWrapper> pfunctionals;
+    unsigned int angle_stepsize;
+    bool orthonormal;
+    int threads;
+
+    TransformPlan plan;
+    Eigen::MatrixXf signatures;
+    std::string error;
+
+    // NOTE: the pre-calculations can't be used by several transforms at once
+    mutable std::mutex mutex;
+};
+
+namespace {
+
+// Restore the amount of OpenMP threads of the calling thread on leaving
+class ThreadCount {
+  public:
+    ThreadCount(int threads) : _previous(omp_get_max_threads()) {
+        if (threads > 0)
+            omp_set_num_threads(threads);
+    }
+    ~ThreadCount() { omp_set_num_threads(_previous); }
+
+  private:
+    int _previous;
+};
+
+tt_status fail(tt_plan *plan, tt_status status, const std::string &message) {
+    plan->error = message;
+    return status;
+}
+
+template <typename Image>
+void execute(tt_plan *plan, const Image &image) {
+    Transformer transformer(image, "library", plan->angle_stepsize,
+                            plan->orthonormal);
+    plan->signatures = transformer.getTransform(
+        plan->tfunctionals, plan->pfunctionals, false, &plan->plan);
+}
+
+}
+
+
+//
+// Library interface
+//
+
+int tt_api_version(void) { return TRACETRANSFORM_API_VERSION; }
+
+const char *tt_status_string(tt_status status) {
+    switch (status) {
+    case TT_OK:
+        return "success";
+    case TT_INVALID_ARGUMENT:
+        return "invalid argument";
+    case TT_OUT_OF_MEMORY:
+        return "out of memory";
+    case TT_FAILURE:
+        return "failure";
+    }
+    return "unknown status";
+}
+
+tt_status tt_plan_create(const char *spec, unsigned int angle_stepsize,
+                         int threads, tt_plan **plan) {
+    if (spec == NULL || plan == NULL || angle_stepsize == 0 ||
+        angle_stepsize > 360 || threads < 0)
+        return TT_INVALID_ARGUMENT;
+    *plan = NULL;
+
+    tt_plan *created = new (std::nothrow) tt_plan();
+    if (created == NULL)
+        return TT_OUT_OF_MEMORY;
+    try {
+        parseSpec(spec, created->tfunctionals, created->pfunctionals);
+    } catch (const std::bad_alloc &) {
+        delete created;
+        return TT_OUT_OF_MEMORY;
+    } catch (const std::exception &) {
+        delete created;
+        return TT_INVALID_ARGUMENT;
+    }
+
+    // Orthonormal P-functionals can't be mixed with regular ones
+    size_t orthonormal_count = 0;
+    for (size_t p = 0; p < created->pfunctionals.size(); p++) {
+        if (created->pfunctionals[p].functional == PFunctional::Hermite)
+            orthonormal_count++;
+    }
+    if (created->tfunctionals.empty() ||
+        (orthonormal_count > 0 &&
+         orthonormal_count < created->pfunctionals.size())) {
+        delete created;
+        return TT_INVALID_ARGUMENT;
+    }
+    created->orthonormal = (orthonormal_count > 0);
+    created->angle_stepsize = angle_stepsize;
+    created->threads = threads;
+
+    *plan = created;
+    return TT_OK;
+}
+
+tt_status tt_execute(tt_plan *plan, const void *pixels, tt_pixel_type type,
+                     size_t rows, size_t cols, size_t stride) {
+    if (plan == NULL)
+        return TT_INVALID_ARGUMENT;
+    std::lock_guard<std::mutex> lock(plan->mutex);
+
+    size_t element = (type == TT_FLOAT32) ? sizeof(float) : 1;
+    if (pixels == NULL || (type != TT_UINT8 && type != TT_FLOAT32))
+        return fail(plan, TT_INVALID_ARGUMENT, "invalid image");
+    if (rows == 0 || cols == 0 || rows > max_image_dimension ||
+        cols > max_image_dimension)
+        return fail(plan, TT_INVALID_ARGUMENT, "invalid image size");
+    if (stride < cols * element || stride % element != 0)
+        return fail(plan, TT_INVALID_ARGUMENT, "invalid stride");
+
+    try {
+        ThreadCount threads(plan->threads);
+        if (type == TT_UINT8)
+            execute(plan, GrayImageView(
+                              static_cast<const unsigned char *>(pixels),
+                              rows, cols, Eigen::OuterStride<>(stride)));
+        else
+            execute(plan, FloatImageView(static_cast<const float *>(pixels),
+                                         rows, cols,
+                                         Eigen::OuterStride<>(stride /
+                                                              element)));
+    } catch (const std::bad_alloc &) {
+        plan->signatures.resize(0, 0);
+        return fail(plan, TT_OUT_OF_MEMORY, "out of memory");
+    } catch (const std::exception &e) {
+        plan->signatures.resize(0, 0);
+        return fail(plan, TT_FAILURE, e.what());
+    }
+    plan->error.clear();
+    return TT_OK;
+}
+
+tt_status tt_get_signature(const tt_plan *plan, float *buffer,
+                           size_t capacity, size_t *rows, size_t *cols) {
+    if (plan == NULL)
+        return TT_INVALID_ARGUMENT;
+    std::lock_guard<std::mutex> lock(plan->mutex);
+
+    const Eigen::MatrixXf &signatures = plan->signatures;
+    if (rows != NULL)
+        *rows = signatures.rows();
+    if (cols != NULL)
+        *cols = signatures.cols();
+    if (buffer != NULL) {
+        if (capacity < (size_t)signatures.size())
+            return TT_INVALID_ARGUMENT;
+        Eigen::Map<Eigen::MatrixXf>(buffer, signatures.rows(),
+                                    signatures.cols()) = signatures;
+    }
+    return TT_OK;
+}
+
+const char *tt_plan_error(const tt_plan *plan) {
+    if (plan == NULL)
+        return "invalid plan";
+    return plan->error.c_str();
+}
+
+void tt_plan_destroy(tt_plan *plan) { delete plan; }
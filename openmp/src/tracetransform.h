@@ -0,0 +1,81 @@
+/*
+ * Configuration
+ */
+
+/* Include guard */
+#ifndef _TRACETRANSFORM_H_
+#define _TRACETRANSFORM_H_
+
+/* Standard library */
+#include <stddef.h> /* for size_t */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TT_API __attribute__((visibility("default")))
+
+
+/*
+ * Library interface
+ */
+
+/* NOTE: this interface only changes in backwards-compatible ways, as long as
+ *       the version stays the same. */
+#define TRACETRANSFORM_API_VERSION 1
+
+typedef enum {
+    TT_OK = 0,
+    TT_INVALID_ARGUMENT,
+    TT_OUT_OF_MEMORY,
+    TT_FAILURE
+} tt_status;
+
+typedef enum {
+    TT_UINT8,  /* grayscale, range [0, 255] */
+    TT_FLOAT32 /* range [0, 1] */
+} tt_pixel_type;
+
+/* Transform of images with a fixed set of functionals, keeping the
+ * pre-calculations for images of the same size around between executions.
+ *
+ * Different plans can be used concurrently from different threads. A single
+ * plan can be shared as well, but executions on it get serialized. */
+typedef struct tt_plan tt_plan;
+
+TT_API int tt_api_version(void);
+
+TT_API const char *tt_status_string(tt_status status);
+
+/* Create a plan for the functionals of a spec, named as on the command line
+ * of the demo and prefixed with their kind (e.g. "T0 T1 T6 P1 P2", or
+ * "T0 H2 H3" for orthonormal functionals). The angle stepsize is in degrees,
+ * and threads is the amount of OpenMP threads an execution may use (0 for
+ * the OpenMP default). */
+TT_API tt_status tt_plan_create(const char *spec, unsigned int angle_stepsize,
+                                int threads, tt_plan **plan);
+
+/* Transform an image in caller-owned memory, stored row by row with stride
+ * bytes between the starts of two rows. The memory is only read during the
+ * call. */
+TT_API tt_status tt_execute(tt_plan *plan, const void *pixels,
+                            tt_pixel_type type, size_t rows, size_t cols,
+                            size_t stride);
+
+/* Retrieve the signatures of the last execution: a column-major matrix with
+ * a row per angle and a column per pair of T- and P-functional. The shape is
+ * always returned, the values only if the buffer can hold them all. */
+TT_API tt_status tt_get_signature(const tt_plan *plan, float *buffer,
+                                  size_t capacity, size_t *rows,
+                                  size_t *cols);
+
+/* Message describing why the last call on a plan failed */
+TT_API const char *tt_plan_error(const tt_plan *plan);
+
+TT_API void tt_plan_destroy(tt_plan *plan);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
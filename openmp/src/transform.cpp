@@ -7,8 +7,9 @@
 
 // Standard library
 #include <stddef.h>  // for size_t
-#include <algorithm> // for min
-#include <cmath>     // for ceil, sqrt
+#include <algorithm> // for min, max
+#include <cassert>   // for assert
+#include <cmath>     // for ceil, sqrt, floor
 #include <new>       // for operator new
 #include <ostream>   // for operator<<, basic_ostream, etc
 #include <string>    // for operator<<
@@ -19,46 +20,156 @@
 #include "auxiliary.hpp"
 #include "sinogram.hpp"
 #include "circus.hpp"
+#include "profiler.hpp"
 
 
 //
 // Module definitions
 //
 
+static Eigen::MatrixXf load(const Eigen::MatrixXf &image) { return image; }
+
+static Eigen::MatrixXf load(const FloatImageView &image) { return image; }
+
+static Eigen::MatrixXf load(const GrayImageView &image) {
+    return gray2mat(image);
+}
+
 Transformer::Transformer(const Eigen::MatrixXf &image,
                          const std::string &basename,
                          unsigned int angle_stepsize, bool orthonormal)
-    : _image(image), _basename(basename), _orthonormal(orthonormal),
-      _angle_stepsize(angle_stepsize) {
-    // Orthonormal P-functionals need a stretched image in order to ensure a
-    // square sinogram
+    : _tiles(NULL), _budget(0), _basename(basename),
+      _orthonormal(orthonormal), _angle_stepsize(angle_stepsize) {
+    prepare(image);
+}
+
+Transformer::Transformer(const FloatImageView &image,
+                         const std::string &basename,
+                         unsigned int angle_stepsize, bool orthonormal)
+    : _tiles(NULL), _budget(0), _basename(basename),
+      _orthonormal(orthonormal), _angle_stepsize(angle_stepsize) {
+    prepare(image);
+}
+
+Transformer::Transformer(const GrayImageView &image,
+                         const std::string &basename,
+                         unsigned int angle_stepsize, bool orthonormal)
+    : _tiles(NULL), _budget(0), _basename(basename),
+      _orthonormal(orthonormal), _angle_stepsize(angle_stepsize) {
+    prepare(image);
+}
+
+Transformer::Transformer(const TiledImage &image, const std::string &basename,
+                         unsigned int angle_stepsize, bool orthonormal,
+                         size_t budget)
+    : _tiles(NULL), _budget(budget), _basename(basename),
+      _orthonormal(orthonormal), _angle_stepsize(angle_stepsize) {
     if (_orthonormal) {
-        size_t ndiag = (int)std::ceil(360.0 / angle_stepsize);
-        size_t nsize = (int)std::ceil(ndiag / std::sqrt(2));
+        size_t nsize = stretchedSize(_angle_stepsize);
         clog(debug) << "Stretching input image to " << nsize << " squared."
                     << std::endl;
-        _image = resize(_image, nsize, nsize);
+        {
+            PhaseTimer timer(profiler.phase("resize"), nsize * nsize);
+            _image = image.resize(nsize, nsize);
+        }
+
+        PhaseTimer timer(profiler.phase("pad"), _image.size());
+        _image = pad(_image);
+        clog(debug) << "Padded image to " << _image.rows() << "x"
+                    << _image.cols() << std::endl;
+    } else {
+        _tiles = &image;
     }
+}
+
+template <typename Image> void Transformer::prepare(const Image &image) {
+    if (_orthonormal) {
+        // Orthonormal P-functionals need a stretched image in order to ensure
+        // a square sinogram
+        size_t nsize = stretchedSize(_angle_stepsize);
+        clog(debug) << "Stretching input image to " << nsize << " squared."
+                    << std::endl;
+        {
+            PhaseTimer timer(profiler.phase("resize"), nsize * nsize);
+            _image = resize(load(image), nsize, nsize);
+        }
 
-    // Pad the images so we can freely rotate without losing information
-    _image = pad(_image);
+        PhaseTimer timer(profiler.phase("pad"), _image.size());
+        _image = pad(_image);
+    } else {
+        // Pad the images so we can freely rotate without losing information
+        // NOTE: padding straight from the input saves a copy of it
+        PhaseTimer timer(profiler.phase("pad"), image.size());
+        _image = pad(image);
+    }
     clog(debug) << "Padded image to " << _image.rows() << "x" << _image.cols()
                 << std::endl;
 }
 
-void
+Eigen::MatrixXf
 Transformer::getTransform(const std::vector<TFunctionalWrapper> &tfunctionals,
                           std::vector<PFunctionalWrapper> &pfunctionals,
-                          bool write_data) const {
-    Eigen::MatrixXf signatures((int)std::floor(360 / _angle_stepsize),
-                               tfunctionals.size() * pfunctionals.size());
+                          bool write_data, TransformPlan *plan) const {
+    return calculateSignatures(calculateSinograms(tfunctionals, plan),
+                               tfunctionals, pfunctionals, write_data, plan);
+}
 
+std::vector<Eigen::MatrixXf> Transformer::calculateSinograms(
+    const std::vector<TFunctionalWrapper> &tfunctionals,
+    TransformPlan *plan) const {
     // Process all T-functionals
     clog(debug) << "Calculating sinograms for given T-functionals" << std::endl;
-    std::vector<Eigen::MatrixXf> sinograms =
-        getSinograms(_image, _angle_stepsize, tfunctionals);
+    if (_tiles != NULL)
+        return getSinograms(*_tiles, _angle_stepsize, tfunctionals, _budget);
+    return getSinograms(
+        _image, _angle_stepsize, tfunctionals,
+        sinogramPlan(plan, _image.rows(), _image.cols(), tfunctionals));
+}
+
+std::vector<std::vector<Eigen::MatrixXf>> Transformer::calculateSinograms(
+    const std::vector<const Transformer *> &transformers,
+    const std::vector<TFunctionalWrapper> &tfunctionals,
+    TransformPlan *plan) {
+    assert(!transformers.empty());
+    const Transformer &first = *transformers[0];
+    std::vector<const Eigen::MatrixXf *> images;
+    for (size_t i = 0; i < transformers.size(); i++) {
+        assert(transformers[i]->_tiles == NULL &&
+               transformers[i]->_image.rows() == first._image.rows() &&
+               transformers[i]->_angle_stepsize == first._angle_stepsize);
+        images.push_back(&transformers[i]->_image);
+    }
+
+    clog(debug) << "Calculating sinograms of " << images.size()
+                << " images at once for given T-functionals" << std::endl;
+    return getSinograms(images, first._angle_stepsize, tfunctionals,
+                        sinogramPlan(plan, first._image.rows(),
+                                     first._image.cols(), tfunctionals));
+}
+
+TPrecalculations *
+Transformer::sinogramPlan(TransformPlan *plan, int rows, int cols,
+                          const std::vector<TFunctionalWrapper> &tfunctionals) {
+    if (plan == NULL)
+        return NULL;
+    if (!plan->sinogram || !plan->sinogram->matches(rows, cols, tfunctionals))
+        plan->sinogram.reset(new TPrecalculations(rows, cols, tfunctionals));
+    return plan->sinogram.get();
+}
+
+Eigen::MatrixXf Transformer::calculateSignatures(
+    std::vector<Eigen::MatrixXf> sinograms,
+    const std::vector<TFunctionalWrapper> &tfunctionals,
+    std::vector<PFunctionalWrapper> &pfunctionals, bool write_data,
+    TransformPlan *plan) const {
+    assert(sinograms.size() == tfunctionals.size());
+    Eigen::MatrixXf signatures((int)std::floor(360 / _angle_stepsize),
+                               tfunctionals.size() * pfunctionals.size());
+
     for (size_t t = 0; t < tfunctionals.size(); t++) {
         if (write_data && clog(debug)) {
+            PhaseTimer timer(profiler.phase("output"), sinograms[t].size());
+
             // Save the sinogram trace
             std::stringstream fn_trace_data;
             fn_trace_data << _basename << "-" << tfunctionals[t].name << ".csv";
@@ -75,6 +186,7 @@ Transformer::getTransform(const std::vector<TFunctionalWrapper> &tfunctionals,
         if (_orthonormal) {
             clog(trace) << "Orthonormalizing sinogram" << std::endl;
             size_t sinogram_center;
+            PhaseTimer timer(profiler.phase("nos"), sinograms[t].size());
             sinograms[t] =
                 nearest_orthonormal_sinogram(sinograms[t], sinogram_center);
             for (size_t p = 0; p < pfunctionals.size(); p++) {
@@ -88,25 +200,114 @@ Transformer::getTransform(const std::vector<TFunctionalWrapper> &tfunctionals,
         if (pfunctionals.size() > 0) {
             clog(debug) << "Calculating circusfunctions for given P-functionals"
                         << std::endl;
+            PPrecalculations *circus_plan = NULL;
+            if (plan != NULL) {
+                if (!plan->circus ||
+                    !plan->circus->matches(sinograms[t].rows(), pfunctionals))
+                    plan->circus.reset(new PPrecalculations(
+                        sinograms[t].rows(), pfunctionals));
+                circus_plan = plan->circus.get();
+            }
             std::vector<Eigen::VectorXf> circusfunctions =
-                getCircusFunctions(sinograms[t], pfunctionals);
+                getCircusFunctions(sinograms[t], pfunctionals, circus_plan);
             for (size_t p = 0; p < pfunctionals.size(); p++) {
                 // Normalize
+                PhaseTimer timer(profiler.phase("zscore"),
+                                 circusfunctions[p].size());
                 Eigen::VectorXf normalized = zscore(circusfunctions[p]);
 
-                if (write_data) {
-                    // Aggregate the signatures
-                    assert(signatures.rows() == normalized.size());
-                    signatures.col(t * pfunctionals.size() + p) = normalized;
-                }
+                // Aggregate the signatures
+                assert(signatures.rows() == normalized.size());
+                signatures.col(t * pfunctionals.size() + p) = normalized;
             }
         }
     }
 
     // Save the signatures
     if (write_data && pfunctionals.size() > 0) {
+        PhaseTimer timer(profiler.phase("output"), signatures.size());
         std::stringstream fn_signatures;
         fn_signatures << _basename << ".csv";
         writecsv(fn_signatures.str(), signatures);
     }
+
+    return signatures;
+}
+
+size_t Transformer::stretchedSize(unsigned int angle_stepsize) {
+    size_t ndiag = (int)std::ceil(360.0 / angle_stepsize);
+    return (int)std::ceil(ndiag / std::sqrt(2));
+}
+
+int Transformer::paddedSize(size_t rows, size_t cols,
+                            unsigned int angle_stepsize, bool orthonormal) {
+    if (orthonormal)
+        rows = cols = stretchedSize(angle_stepsize);
+    return padded_size(rows, cols);
+}
+
+size_t Transformer::estimateMemory(
+    size_t rows, size_t cols, unsigned int angle_stepsize, bool orthonormal,
+    const std::vector<TFunctionalWrapper> &tfunctionals,
+    const std::vector<PFunctionalWrapper> &pfunctionals, int threads) {
+    const size_t word = sizeof(float);
+    size_t a_steps = (size_t)std::floor(360 / angle_stepsize);
+
+    // Input image, its stretched copy, and the padded image
+    size_t memory = rows * cols * word;
+    if (orthonormal) {
+        size_t nsize = stretchedSize(angle_stepsize);
+        memory += nsize * nsize * word;
+    }
+    size_t n = paddedSize(rows, cols, angle_stepsize, orthonormal);
+    memory += n * n * word;
+
+    // Sinograms
+    memory += tfunctionals.size() * n * a_steps * word;
+
+    // Rotated image of every thread, and the scratch space of the
+    // T-functionals processing all columns at once
+    size_t scratch = 0;
+    for (size_t t = 0; t < tfunctionals.size(); t++) {
+        unsigned int fft_threshold = tfunctionals[t].arguments.fft_threshold;
+        switch (tfunctionals[t].functional) {
+        case TFunctional::T3:
+        case TFunctional::T4:
+        case TFunctional::T5:
+            // Batches of 64 zero-padded columns and their spectra
+            if (fft_threshold > 0 && n >= fft_threshold)
+                scratch = std::max(scratch, 8 * n * 64);
+            break;
+        case TFunctional::T6:
+        case TFunctional::T7:
+            // Weighted data, weights and permutation, and the key and
+            // position buffers the radix sort keeps around (measured), of
+            // the columns sorted at once
+            scratch = std::max(scratch, 9 * n * sort_columns);
+            break;
+        default:
+            break;
+        }
+    }
+    memory += threads * (n * n + scratch) * word;
+
+    // Full SVD of the aligned sinogram, which gets up to twice as high
+    if (orthonormal) {
+        size_t m = 2 * n;
+        memory += tfunctionals.empty()
+                      ? 0
+                      : (m * m + a_steps * a_steps + 3 * m * a_steps) * word;
+    }
+
+    // Circus functions and signatures, and the sort buffers of P2 which
+    // processes batches of 64 columns
+    memory += 2 * tfunctionals.size() * pfunctionals.size() * a_steps * word;
+    for (size_t p = 0; p < pfunctionals.size(); p++) {
+        if (pfunctionals[p].functional == PFunctional::P2) {
+            memory += threads * 6 * n * 64 * word;
+            break;
+        }
+    }
+
+    return memory;
 }
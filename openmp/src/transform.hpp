@@ -7,31 +7,107 @@
 #define _TRACETRANSFORM_TRANSFORM_
 
 // Standard library
-#include <vector> // for vector
+#include <cstddef> // for size_t
+#include <memory>  // for unique_ptr
+#include <vector>  // for vector
 
 // Eigen
 #include <Eigen/Dense>
 
 // Local
+#include "auxiliary.hpp"
 #include "sinogram.hpp"
 #include "circus.hpp"
+#include "tiles.hpp"
 
 
 //
 // Module definitions
 //
 
+// Pre-calculations for transforming images of a single size with a given set
+// of functionals, filled in by the first transform and reused by later ones
+// NOTE: a plan mustn't be used by several transforms at once
+struct TransformPlan {
+    std::unique_ptr<TPrecalculations> sinogram;
+    std::unique_ptr<PPrecalculations> circus;
+};
+
 class Transformer {
   public:
     Transformer(const Eigen::MatrixXf &image, const std::string &basename,
                 unsigned int angle_step, bool orthonormal);
 
-    void getTransform(const std::vector<TFunctionalWrapper> &tfunctionals,
-                      std::vector<PFunctionalWrapper> &pfunctionals,
-                      bool write_data = true) const;
+    // Transform an image in external memory, which only gets read while
+    // padding it
+    Transformer(const FloatImageView &image, const std::string &basename,
+                unsigned int angle_step, bool orthonormal);
+    Transformer(const GrayImageView &image, const std::string &basename,
+                unsigned int angle_step, bool orthonormal);
+
+    // Transform an image streamed from a tiled store, within the given
+    // memory budget (0 for no limit)
+    // NOTE: orthonormal P-functionals shrink the image to a size which fits
+    //       in memory, so only the stretched image gets transformed in-core
+    Transformer(const TiledImage &image, const std::string &basename,
+                unsigned int angle_step, bool orthonormal, size_t budget);
+
+    // Calculate the signatures (one column per combination of a T- and a
+    // P-functional), and write them to disk if requested
+    Eigen::MatrixXf
+    getTransform(const std::vector<TFunctionalWrapper> &tfunctionals,
+                 std::vector<PFunctionalWrapper> &pfunctionals,
+                 bool write_data = true, TransformPlan *plan = NULL) const;
+
+    // The stages of getTransform, for the sinograms to be stored and reused
+    // with other P-functionals: the sinogram per T-functional, and the
+    // signatures derived from them
+    std::vector<Eigen::MatrixXf>
+    calculateSinograms(const std::vector<TFunctionalWrapper> &tfunctionals,
+                       TransformPlan *plan = NULL) const;
+    Eigen::MatrixXf
+    calculateSignatures(std::vector<Eigen::MatrixXf> sinograms,
+                        const std::vector<TFunctionalWrapper> &tfunctionals,
+                        std::vector<PFunctionalWrapper> &pfunctionals,
+                        bool write_data = true,
+                        TransformPlan *plan = NULL) const;
+
+    // Calculate the sinograms of several images padded to the same size at
+    // once (e.g. the channels of a colour image), rotating them together
+    static std::vector<std::vector<Eigen::MatrixXf>>
+    calculateSinograms(const std::vector<const Transformer *> &transformers,
+                       const std::vector<TFunctionalWrapper> &tfunctionals,
+                       TransformPlan *plan = NULL);
+
+    // Size of the padded image an input image gets transformed as
+    static int paddedSize(size_t rows, size_t cols,
+                          unsigned int angle_stepsize, bool orthonormal);
+
+    // Estimate the peak heap usage (in bytes) of transforming an image with
+    // the given amount of threads, including the input image itself
+    static size_t
+    estimateMemory(size_t rows, size_t cols, unsigned int angle_stepsize,
+                   bool orthonormal,
+                   const std::vector<TFunctionalWrapper> &tfunctionals,
+                   const std::vector<PFunctionalWrapper> &pfunctionals,
+                   int threads);
 
   private:
+    // Pre-calculations of the T-functionals from a plan, renewed if they
+    // don't apply to images of the given size
+    static TPrecalculations *
+    sinogramPlan(TransformPlan *plan, int rows, int cols,
+                 const std::vector<TFunctionalWrapper> &tfunctionals);
+
+    // Stretch (if needed) and pad the input image
+    template <typename Image> void prepare(const Image &image);
+
+    // Size of the square orthonormal P-functionals stretch the image to
+    static size_t stretchedSize(unsigned int angle_stepsize);
+
     Eigen::MatrixXf _image;
+    const TiledImage *_tiles;
+    size_t _budget;
     std::string _basename;
     bool _orthonormal;
     unsigned int _angle_stepsize;